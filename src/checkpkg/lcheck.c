@@ -23,20 +23,24 @@ _______________________________________________________________________________
 
 */
 
+#include <stdint.h>
 #include <stdio.h>
+#include <unistd.h>
 #include <wfdb/wfdb.h>
 
 char *info, *pname, *prog_name();
 int n, nsig, i, j, framelen, errors = 0, istat, vflag = 0;
 char headerversion[40];
 char *libversion;
-char *p, *q, *defpath, *dbpath;
+char *p, *q, *defpath, *dbpath, *xerror;
 WFDB_Anninfo aiarray[2];
 WFDB_Annotation annot;
 WFDB_Calinfo cal;
 WFDB_Siginfo *si;
 WFDB_Sample *vector;
 void help(), list_untested();
+int check(char *record, char *orec);
+int liberrors(void);
 
 main(argc, argv)
 int argc;
@@ -175,6 +179,305 @@ char *argv[];
   /* Test I/O using the local record first. */
   check("100s", "100z");
 
+  /* *** isigsettime (multi-segment records) *** */
+  /* Read the multi-segment record "multi" from beginning to end, then seek
+     to frames in each of its segments, in no particular order, and check
+     that the frames read there are the same. */
+  {
+    static WFDB_Time tseek[] = { 44000L, 100L, 22000L, 30000L, 21599L,
+				 23400L, 0L };
+    WFDB_Siginfo msi[2];
+    WFDB_Sample *mv, v[2];
+    WFDB_Time t;
+
+    if (isigopen("multi", msi, 2) != 2) {
+      printf("Error: can't open record multi\n");
+      errors++;
+    }
+    else {
+      mv = calloc(45000L * 2, sizeof(WFDB_Sample));
+      for (t = 0L; t < 45000L && getframe(mv + 2 * t) == 2; t++)
+	;
+      for (i = 0; t == 45000L && i < 7; i++)
+	if (isigsettime(tseek[i]) != 0 || getframe(v) != 2 ||
+	    v[0] != mv[2 * tseek[i]] || v[1] != mv[2 * tseek[i] + 1])
+	  break;
+      if (t != 45000L) {
+	printf("Error: read %"WFDB_Pd_TIME" frames of record multi (should "
+	       "have been 45000)\n", t);
+	errors++;
+      }
+      else if (i < 7) {
+	printf("Error: isigsettime and getframe disagree at frame %"
+	       WFDB_Pd_TIME" of record multi\n", tseek[i]);
+	errors++;
+      }
+      else if (vflag)
+	printf("[OK]:  isigsettime and getframe agree in record multi\n");
+
+      /* *** setiprefetch *** */
+      /* Repeat the test with read-ahead, which applies only to files that
+	 are not mapped into memory, and with small buffers. */
+      wfdbquit();
+      j = setimmap(0);
+      setiprefetch(3);
+      setibsize(512);
+      if (t == 45000L && i == 7 && isigopen("multi", msi, 2) == 2) {
+	for (t = 0L; t < 45000L && getframe(v) == 2 &&
+	       v[0] == mv[2 * t] && v[1] == mv[2 * t + 1]; t++)
+	  ;
+	for (i = 0; t == 45000L && i < 7; i++)
+	  if (isigsettime(tseek[i]) != 0 || getframe(v) != 2 ||
+	      v[0] != mv[2 * tseek[i]] || v[1] != mv[2 * tseek[i] + 1])
+	    break;
+	if (t != 45000L || i < 7) {
+	  printf("Error: record multi read differently with read-ahead\n");
+	  errors++;
+	}
+	else if (vflag)
+	  printf("[OK]:  record multi read identically with read-ahead\n");
+      }
+      wfdbquit();
+      setiprefetch(0);
+      setibsize(0);
+      setimmap(j);
+
+      /* *** setsegprefetch *** */
+      /* Repeat the test, opening each segment in advance. */
+      setsegprefetch(1);
+      if (t == 45000L && i == 7 && isigopen("multi", msi, 2) == 2) {
+	for (t = 0L; t < 45000L && getframe(v) == 2 &&
+	       v[0] == mv[2 * t] && v[1] == mv[2 * t + 1]; t++)
+	  ;
+	for (i = 0; t == 45000L && i < 7; i++)
+	  if (isigsettime(tseek[i]) != 0 || getframe(v) != 2 ||
+	      v[0] != mv[2 * tseek[i]] || v[1] != mv[2 * tseek[i] + 1])
+	    break;
+	if (t != 45000L || i < 7) {
+	  printf("Error: record multi read differently with segment "
+		 "prefetch\n");
+	  errors++;
+	}
+	else if (vflag)
+	  printf("[OK]:  record multi read identically with segment "
+		 "prefetch\n");
+      }
+      wfdbquit();
+      setsegprefetch(0);
+
+      /* *** getframes (variable-layout records) *** */
+      /* Read a variable-layout record whose first segment is record 100s
+	 with its signals in the order given by the layout, and whose
+	 second segment lacks MLII and records V5 at half the gain. */
+      {
+	static char *hea[] = {
+	  "lcheckv.hea", "lcheckv/3 2 360 43200\nlcheckv_l 0\n"
+	    "lcheckv_a 21600\nlcheckv_b 21600\n",
+	  "lcheckv_l.hea", "lcheckv_l 2 360 0\n~ 0 200 11 1024 0 0 0 MLII\n"
+	    "~ 0 200 11 1024 0 0 0 V5\n",
+	  "lcheckv_a.hea", "lcheckv_a 2 360 21600\n"
+	    "100s.dat 212 200 11 1024 995 0 0 MLII\n"
+	    "100s.dat 212 200 11 1024 1011 0 0 V5\n",
+	  "lcheckv_b.hea", "lcheckv_b 2 360 21600\n"
+	    "100s.dat 212 200 11 1024 995 0 0 other\n"
+	    "100s.dat 212 100 11 1024 1011 0 0 V5\n" };
+	WFDB_Sample *lv;
+	FILE *hf;
+
+	for (i = 0; i < 8; i += 2)
+	  if ((hf = fopen(hea[i], "w"))) {
+	    fputs(hea[i+1], hf);
+	    fclose(hf);
+	  }
+	lv = calloc(43200L * 2, sizeof(WFDB_Sample));
+	if (t == 45000L && isigopen("lcheckv", msi, 2) == 2 &&
+	    getframes(lv, 43200L) == 43200L) {
+	  for (t = 0L; t < 21600L && lv[2*t] == mv[2*t] &&
+		 lv[2*t+1] == mv[2*t+1]; t++)
+	    ;
+	  for ( ; t < 43200L && lv[2*t] == WFDB_INVALID_SAMPLE &&
+		 lv[2*t+1] == (mv[2*t-43199] == WFDB_INVALID_SAMPLE ?
+			       WFDB_INVALID_SAMPLE : 2*mv[2*t-43199] - 1024);
+	       t++)
+	    ;
+	}
+	if (t != 43200L) {
+	  printf("Error: getframes misread record lcheckv\n");
+	  errors++;
+	}
+	else if (vflag)
+	  printf("[OK]:  getframes read variable-layout record lcheckv\n");
+	wfdbquit();
+	for (i = 0; i < 8; i += 2)
+	  remove(hea[i]);
+	free(lv);
+      }
+
+      /* Check that the header and signal file of a segment are those read
+	 and opened in advance:  read a record whose second segment's header
+	 and signal file are removed just before the end of its long first
+	 segment, once they have been prefetched (setsegprefetch waits for
+	 the prefetch to finish). */
+      {
+	static char *hea[] = {
+	  "lcheckp.hea", "lcheckp/2 1 360 101000\nlcheckp_1 100000\n"
+	    "lcheckp_2 1000\n",
+	  "lcheckp_1.hea", "lcheckp_1 1 360 100000\n"
+	    "lcheckp_1.dat 16 200 16 0 0 0 0 x\n",
+	  "lcheckp_2.hea", "lcheckp_2 1 360 1000\n"
+	    "lcheckp_2.dat 16 200 16 0 0 0 0 x\n" };
+	static char *dat[] = { "lcheckp_1.dat", "lcheckp_2.dat" };
+	WFDB_Sample *pv;
+	FILE *hf;
+	long w;
+
+	for (i = 0; i < 6; i += 2)
+	  if ((hf = fopen(hea[i], "w"))) {
+	    fputs(hea[i+1], hf);
+	    fclose(hf);
+	  }
+	for (i = 0; i < 2; i++)
+	  if ((hf = fopen(dat[i], "wb"))) {
+	    for (t = 0L; t < (i ? 1000L : 100000L); t++) {
+	      w = i ? 3000L + t : t % 2000L;
+	      putc((int)(w & 0xff), hf);
+	      putc((int)((w >> 8) & 0xff), hf);
+	    }
+	    fclose(hf);
+	  }
+	pv = calloc(101000L, sizeof(WFDB_Sample));
+	setsegprefetch(1);
+	t = 0L;
+	if (isigopen("lcheckp", msi, 1) == 1 &&
+	    getframes(pv, 99999L) == 99999L) {
+	  setsegprefetch(1);
+	  remove("lcheckp_2.hea");
+	  remove("lcheckp_2.dat");
+	  if (getframes(pv + 99999L, 1001L) == 1001L)
+	    for ( ; t < 101000L && pv[t] == (t < 100000L ? t % 2000L :
+					     3000L + t - 100000L); t++)
+	      ;
+	}
+	wfdbquit();
+	setsegprefetch(0);
+	if (t != 101000L) {
+	  printf("Error: record lcheckp was not read using the prefetched "
+		 "segment lcheckp_2\n");
+	  errors++;
+	}
+	else if (vflag)
+	  printf("[OK]:  record lcheckp read using the prefetched segment "
+		 "lcheckp_2\n");
+	for (i = 0; i < 6; i += 2)
+	  remove(hea[i]);
+	for (i = 0; i < 2; i++)
+	  remove(dat[i]);
+	free(pv);
+      }
+      free(mv);
+    }
+  }
+
+  /* *** sethcache *** */
+  /* Open a record four times with the header cache enabled.  The first time,
+     a copy of its header is appended to the cache file;  the second time,
+     the copy is used, so the cache file is unchanged;  the third time, after
+     the header has been changed, a new copy is appended;  and the fourth
+     time, after the cache has been enabled again (which drops the old copy
+     from the cache file), the new copy is used. */
+  {
+    static char *hh[] = {
+      "lcheckh 2 360 21600\n100s.dat 212 200 11 1024 995 0 0 MLII\n"
+	"100s.dat 212 200 11 1024 1011 0 0 V5\n",
+      "lcheckh 2 360 21600\n100s.dat 212 1000 11 1024 995 0 0 MLII\n"
+	"100s.dat 212 200 11 1024 1011 0 0 V5\n" };
+    static WFDB_Gain hg[] = { 200., 200., 1000., 1000. };
+    WFDB_Siginfo hsi[2];
+    long hl[4];
+    FILE *hf;
+
+    remove("lcheckh.hc");
+    sethcache("lcheckh.hc");
+    for (i = 0; i < 4; i++) {
+      if ((i == 0 || i == 2) && (hf = fopen("lcheckh.hea", "w"))) {
+	fputs(hh[i/2], hf);
+	fclose(hf);
+      }
+      if (i == 3)
+	sethcache("lcheckh.hc");
+      if (isigopen("lcheckh", hsi, 2) != 2 || hsi[0].gain != hg[i] ||
+	  (hf = fopen("lcheckh.hc", "rb")) == NULL)
+	break;
+      fseek(hf, 0L, SEEK_END);
+      hl[i] = ftell(hf);
+      fclose(hf);
+    }
+    wfdbquit();
+    sethcache(NULL);
+    if (i < 4 || hl[0] <= 0L || hl[1] != hl[0] || hl[2] <= hl[1] ||
+	hl[3] >= hl[2]) {
+      printf("Error: header cache misused the header of record lcheckh\n");
+      errors++;
+    }
+    else if (vflag)
+      printf("[OK]:  sethcache kept, used, replaced, and compacted a header\n");
+    remove("lcheckh.hea");
+    remove("lcheckh.hc");
+  }
+
+  /* *** getsignals (pipes) *** */
+  /* Read a record whose signal file is the standard input, connected to a
+     pipe, using getsignals with three decoding threads.  Since a pipe cannot
+     be read by offset, getsignals must read it serially.  This test is not
+     repeated using NETFILES, since wfdbquit closes the standard input. */
+  {
+    WFDB_Siginfo qsi[2];
+    WFDB_Signal qs[2];
+    WFDB_Sample *qv, *qb[2];
+    WFDB_Time t;
+    FILE *qf, *qp = NULL;
+    long w;
+
+    if ((qf = fopen("lcheckq.hea", "w"))) {
+      fputs("lcheckq 2 360 40000\n- 16 200 16 0 0 0 0 x\n"
+	    "- 16 200 16 0 0 0 0 y\n", qf);
+      fclose(qf);
+    }
+    if ((qf = fopen("lcheckq.dat", "wb"))) {
+      for (t = 0L; t < 80000L; t++) {
+	w = (t & 1) ? t % 1999L - 1000L : t % 3000L;
+	putc((int)(w & 0xff), qf);
+	putc((int)((w >> 8) & 0xff), qf);
+      }
+      fclose(qf);
+    }
+    qv = calloc(2 * 40000L, sizeof(WFDB_Sample));
+    qs[0] = 1; qs[1] = 0;
+    qb[0] = qv; qb[1] = qv + 40000L;
+    setithreads(3);
+    t = 0L;
+    if ((qp = popen("cat lcheckq.dat", "r")) && dup2(fileno(qp), 0) == 0 &&
+	isigopen("lcheckq", qsi, 2) == 2 &&
+	getsignals(0L, 40000L, qs, 2, qb) == 40000L)
+      for ( ; t < 40000L && qv[t] == (2*t + 1) % 1999L - 1000L &&
+	     qv[40000L + t] == (2*t) % 3000L; t++)
+	;
+    wfdbquit();
+    setithreads(1);
+    if (qp)
+      pclose(qp);
+    if (t != 40000L) {
+      printf("Error: getsignals misread record lcheckq from a pipe\n");
+      errors++;
+    }
+    else if (vflag)
+      printf("[OK]:  getsignals read 40000 frames from a pipe using three "
+	     "threads\n");
+    remove("lcheckq.hea");
+    remove("lcheckq.dat");
+    free(qv);
+  }
+
   /* Test I/O again using the remote record. */
   if (WFDB_NETFILES) {
     if (vflag)
@@ -194,21 +497,8 @@ char *argv[];
 
   /* If there were any errors detected by the WFDB library but not by this
      program, this test will pick them up. */
-  if (errors == 0) {
-    if ((p = wfdberror()) == NULL) {
-      printf("Error: wfdberror() did not return a version string\n");
-      p = "unknown version of the WFDB library";
-      errors++;
-    }
-    if (strcmp(libversion, p)) {
-      printf("Error: WFDB library error(s) not detected by %s\n",
-	      pname);
-      printf(" Last library error was: '%s'\n", p);
-      errors++;
-    }
-    else if (vflag)
-      printf("[OK]:  no WFDB library errors\n");
-  }
+  if (errors == 0 && liberrors() == 0 && vflag)
+    printf("[OK]:  no WFDB library errors\n");
 
   /* In this section, test functions that can only be checked by looking
      for library errors. */
@@ -240,6 +530,25 @@ int check(char *record, char *orec)
   WFDB_Date d;
   WFDB_Frequency f;
   WFDB_Time t, tt;
+  WFDB_Sample *fv, *bv;
+  long nb;
+  static int pfmt[3] = { 212, 310, 311 };
+  char prec[16], pfname[20], vfname[20];
+  WFDB_Siginfo psi[3];
+  const int16_t *view;
+  unsigned char *bits;
+  int16_t *sv;
+  float *fx;
+  int c, k;
+  FILE *fa, *fb;
+  struct WfdbRecord *rh;
+  WFDB_Siginfo *rsi;
+  WFDB_Annotation rann;
+  WFDB_Sample v1;
+  WFDB_Signal gs[2];
+  WFDB_Sample *gb[2];
+  double *px;
+  long hits, misses;
   double x;
 
   /* *** sampfreq *** */
@@ -611,6 +920,407 @@ int check(char *record, char *orec)
     }
   }
 
+  /* *** getframes *** */
+  /* Read the record frame by frame, then read it again in blocks, and check
+     that the results are identical. */
+  isigsettime(0L);
+  for (tt = 0L; getframe(vector) == nsig; tt++)
+    ;
+  fv = calloc(tt * framelen, sizeof(WFDB_Sample));
+  bv = calloc(tt * framelen, sizeof(WFDB_Sample));
+  isigsettime(0L);
+  for (t = 0L; t < tt && getframe(fv + t * framelen) == nsig; t++)
+    ;
+  isigsettime(0L);
+  for (t = 0L; t < tt; t += nb)
+    if ((nb = getframes(bv + t * framelen, tt-t < 1000L ? tt-t : 1000L)) <= 0)
+      break;
+  if (t != tt || getframes(vector, 1L) != -1) {
+    printf("Error: getframes read %"WFDB_Pd_TIME" frames (should have been %"
+	   WFDB_Pd_TIME")\n", t, tt);
+    errors++;
+  }
+  else if (memcmp(fv, bv, tt * framelen * sizeof(WFDB_Sample))) {
+    printf("Error: getframes and getframe returned different samples\n");
+    errors++;
+  }
+  else if (vflag)
+    printf("[OK]:  getframes read %"WFDB_Pd_TIME" frames\n", t);
+
+  /* *** setimmap *** */
+  /* Read the record again in blocks, with its local signal files mapped into
+     memory, and check that the frames are those read above without mapping.
+     Mapping is disabled by default. */
+  j = setimmap(1);
+  if (isigopen(record, si, nsig) != nsig) {
+    printf("Error: can't reopen record %s with memory mapping\n", record);
+    errors++;
+  }
+  else {
+    for (t = 0L; t < tt; t += nb)
+      if ((nb = getframes(bv + t * framelen, tt-t < 1000L ? tt-t : 1000L)) <= 0)
+	break;
+    if (t != tt || memcmp(fv, bv, tt * framelen * sizeof(WFDB_Sample))) {
+      printf("Error: getframes returned different samples with memory "
+	     "mapping\n");
+      errors++;
+    }
+    else if (vflag)
+      printf("[OK]:  getframes read %"WFDB_Pd_TIME" frames with memory "
+	     "mapping\n", t);
+  }
+  setimmap(j);
+
+  /* *** isigsettime (reading by offset) *** */
+  /* Reopen the record without memory mapping, seek to frames in no
+     particular order, and check that the frames read there are those read
+     above.  A local signal file that permits seeks is read by offset (using
+     wfdb_pread), so that a seek only sets the offset of the next block. */
+  if (isigopen(record, si, nsig) != nsig) {
+    printf("Error: can't reopen record %s\n", record);
+    errors++;
+  }
+  else {
+    WFDB_Time ts[6];
+
+    ts[0] = tt - 1L; ts[1] = 3L; ts[2] = tt / 2; ts[3] = tt / 2 - 1L;
+    ts[4] = 0L; ts[5] = tt / 3;
+    for (i = 0; i < 6; i++) {
+      nb = tt - ts[i] < 1000L ? tt - ts[i] : 1000L;
+      if (isigsettime(ts[i]) != 0 || getframes(bv, nb) != nb ||
+	  memcmp(bv, fv + ts[i] * framelen,
+		 nb * framelen * sizeof(WFDB_Sample)))
+	break;
+    }
+    if (i < 6) {
+      printf("Error: getframes misread frame %"WFDB_Pd_TIME" after a "
+	     "seek\n", ts[i]);
+      errors++;
+    }
+    else if (vflag)
+      printf("[OK]:  getframes read the record correctly after 6 seeks\n");
+  }
+
+  /* Describe the record's signal file as a format 16 file, and view part of
+     it using getsigview, which reads it by offset (as a range request, if
+     the file is remote);  the view must contain the frames that getframe
+     reads. */
+  if (nsig == 2 && si[0].group == si[1].group) {
+    char nfname[80];
+    FILE *hf;
+
+    p = strrchr(record, '/');
+    sprintf(nfname, "%.*s%.40s", p ? (int)(p - record + 1) : 0, record,
+	    si[0].fname);
+    if ((hf = fopen("lcheckn.hea", "w"))) {
+      fprintf(hf, "lcheckn 2 360\n%s 16 200 16 0 0 0 0 a\n"
+	      "%s 16 200 16 0 0 0 0 b\n", nfname, nfname);
+      fclose(hf);
+    }
+    nb = (isigopen("lcheckn", psi, 2) == 2 && isigsettime(1000L) == 0 &&
+	  getframes(bv, 8000L) == 8000L) ?
+      getsigview(0, 1000L, 9000L, &view, NULL) : -1L;
+    if (nb != 8000L) {
+      printf("Error: getsigview returned %ld for record lcheckn (should "
+	     "have been 8000)\n", nb);
+      errors++;
+    }
+    else {
+      for (t = 0L; t < 2 * 8000L && view[t] == bv[t]; t++)
+	;
+      if (t < 2 * 8000L) {
+	printf("Error: getsigview and getframes read record lcheckn "
+	       "differently\n");
+	errors++;
+      }
+      else if (vflag)
+	printf("[OK]:  getsigview read %ld frames of record lcheckn by "
+	       "offset\n", nb);
+    }
+    remove("lcheckn.hea");
+    if (isigopen(record, si, nsig) != nsig) {
+      printf("Error: can't reopen record %s\n", record);
+      errors++;
+    }
+  }
+
+  /* *** getsignals *** */
+  /* Read signals 1 and 0 (in that order) from frames 1000 through 1999 into
+     separate arrays, and check them against the frames read by getframe;
+     then check that getframe resumes at frame 2000. */
+  gs[0] = 1; gs[1] = 0;
+  gb[0] = bv; gb[1] = bv + 1000;
+  if ((nb = getsignals(1000L, 2000L, gs, 2, gb)) != 1000L) {
+    printf("Error: getsignals returned %ld (should have been 1000)\n", nb);
+    errors++;
+  }
+  else {
+    for (t = 0L; t < 1000L; t++)
+      if (gb[0][t] != fv[(t + 1000L) * framelen + 1] ||
+	  gb[1][t] != fv[(t + 1000L) * framelen])
+	break;
+    if (t < 1000L || getframe(vector) != nsig ||
+	memcmp(vector, fv + 2000L * framelen, framelen * sizeof(WFDB_Sample))){
+      printf("Error: getsignals and getframe returned different samples\n");
+      errors++;
+    }
+    else if (vflag)
+      printf("[OK]:  getsignals read %ld frames\n", nb);
+  }
+
+  /* Read signals 1 and 0 again, from frame 7 to the end, with three decoding
+     threads, which divide long ranges of local signal files among
+     themselves. */
+  setithreads(3);
+  gb[0] = bv; gb[1] = bv + tt;
+  if ((nb = getsignals(7L, tt, gs, 2, gb)) != tt - 7L) {
+    printf("Error: getsignals returned %ld using three threads (should have "
+	   "been %ld)\n", nb, (long)(tt - 7L));
+    errors++;
+  }
+  else {
+    for (t = 0L; t < tt - 7L; t++)
+      if (gb[0][t] != fv[(t + 7L) * framelen + 1] ||
+	  gb[1][t] != fv[(t + 7L) * framelen])
+	break;
+    if (t < tt - 7L) {
+      printf("Error: getsignals returned different samples using three "
+	     "threads\n");
+      errors++;
+    }
+    else if (vflag)
+      printf("[OK]:  getsignals read %ld frames using three threads\n", nb);
+  }
+  setithreads(1);
+
+  /* Read signal 1 alone, from frame 1 to the end;  only its samples are
+     decoded from the signal file. */
+  gb[0] = bv;
+  if ((nb = getsignals(1L, tt, gs, 1, gb)) != tt - 1L) {
+    printf("Error: getsignals returned %ld for one signal (should have been "
+	   "%ld)\n", nb, (long)(tt - 1L));
+    errors++;
+  }
+  else {
+    for (t = 0L; t < tt - 1L; t++)
+      if (gb[0][t] != fv[(t + 1L) * framelen + 1])
+	break;
+    if (t < tt - 1L) {
+      printf("Error: getsignals returned different samples for one signal\n");
+      errors++;
+    }
+    else if (vflag)
+      printf("[OK]:  getsignals read %ld frames of one signal\n", nb);
+  }
+
+  /* *** getphysframes *** */
+  /* Read the first 1000 frames in physical units, and check them against the
+     frames read by getframe, as converted by aduphys. */
+  isigsettime(0L);
+  px = calloc(1000L * framelen, sizeof(double));
+  if ((nb = getphysframes(px, 1000L)) != 1000L) {
+    printf("Error: getphysframes returned %ld (should have been 1000)\n", nb);
+    errors++;
+  }
+  else {
+    for (i = 0; i < 1000 * framelen; i++)
+      if (px[i] != aduphys(i % framelen, fv[i]))
+	break;
+    if (i < 1000 * framelen) {
+      printf("Error: getphysframes and aduphys returned different values\n");
+      errors++;
+    }
+    else if (vflag)
+      printf("[OK]:  getphysframes read %ld frames\n", nb);
+  }
+  free(px);
+
+  /* *** getframes16, getframesf *** */
+  /* Read the first 1000 frames again as 16-bit integers, then as floats, and
+     check them against the frames read by getframe. */
+  isigsettime(0L);
+  sv = calloc(1000L * framelen, sizeof(int16_t));
+  if ((nb = getframes16(sv, 1000L)) != 1000L) {
+    printf("Error: getframes16 returned %ld (should have been 1000)\n", nb);
+    errors++;
+  }
+  else {
+    for (i = 0; i < 1000 * framelen && sv[i] == fv[i]; i++)
+      ;
+    if (i < 1000 * framelen) {
+      printf("Error: getframes16 and getframe returned different samples\n");
+      errors++;
+    }
+    else if (vflag)
+      printf("[OK]:  getframes16 read %ld frames\n", nb);
+  }
+  free(sv);
+  isigsettime(0L);
+  fx = calloc(1000L * framelen, sizeof(float));
+  if ((nb = getframesf(fx, 1000L)) != 1000L) {
+    printf("Error: getframesf returned %ld (should have been 1000)\n", nb);
+    errors++;
+  }
+  else {
+    for (i = 0; i < 1000 * framelen; i++)
+      if (fv[i] == WFDB_INVALID_SAMPLE ? fx[i] == fx[i] : fx[i] != fv[i])
+	break;
+    if (i < 1000 * framelen) {
+      printf("Error: getframesf and getframe returned different samples\n");
+      errors++;
+    }
+    else if (vflag)
+      printf("[OK]:  getframesf read %ld frames\n", nb);
+  }
+  free(fx);
+
+  /* *** sample, setsampcache, getsampcache *** */
+  /* Read samples 0 through 4999 of signal 0 using sample, then read them
+     again in reverse order;  the second pass should be satisfied entirely
+     from the cache. */
+  setsampcache(8);
+  for (t = 0L; t < 5000L; t++)
+    if (sample(0, t) != fv[t * framelen])
+      break;
+  getsampcache(&hits, &misses);
+  if (t == 5000L)
+    for (t = 4999L; t >= 0L; t--)
+      if (sample(0, t) != fv[t * framelen])
+	break;
+  getsampcache(&hits, &nb);
+  if (t >= 0L) {
+    printf("Error: sample returned different samples at %s\n", mstimstr(t));
+    errors++;
+  }
+  else if (nb != misses) {
+    printf("Error: sample cache missed %ld times on the second pass\n",
+	   nb - misses);
+    errors++;
+  }
+  else if (vflag)
+    printf("[OK]:  sample cache satisfied 5000 repeated requests\n");
+
+  /* Request samples just past the end of the record, and far past it;  both
+     must be the last sample of the signal, marked as beyond the end. */
+  if (sample(0, tt) != fv[(tt - 1) * framelen] || sample_valid() != 0 ||
+      sample(0, tt + 100000L) != fv[(tt - 1) * framelen] ||
+      sample_valid() != 0) {
+    printf("Error: sample did not return the last sample past the end\n");
+    errors++;
+  }
+  else if (vflag)
+    printf("[OK]:  sample returned the last sample past the end\n");
+
+  /* *** getsignals (format 8) *** */
+  /* Copy the record in format 8, and read the copy using getframe, then
+     from the beginning again using getsignals, with one and then with three
+     decoding threads.  Format 8 samples are first differences, so getsignals
+     must begin again from the initial value of each signal. */
+  if (nsig <= 3 && framelen == nsig && isigopen(record, si, nsig) == nsig) {
+    long f;
+
+    for (i = 0; i < nsig; i++) {
+      psi[i] = si[i];
+      psi[i].fmt = 8;
+      psi[i].group = 0;
+      psi[i].fname = "lcheck8.dat";
+    }
+    osigfopen(psi, nsig);
+    for (t = 0L; t < tt && putvec(fv + t * nsig) == nsig; t++)
+      ;
+    newheader("lcheck8");
+    osigfopen(NULL, 0);
+    if (isigopen("lcheck8", psi, nsig) != nsig) {
+      printf("Error: can't read record lcheck8\n");
+      errors++;
+    }
+    else {
+      for (t = 0L; t < tt && getframe(fv + t * nsig) == nsig; t++)
+	;
+      gs[0] = 0; gs[1] = nsig - 1;
+      gb[0] = bv; gb[1] = bv + tt;
+      for (k = 1; k <= 3; k += 2) {
+	setithreads(k);
+	nb = getsignals(0L, tt, gs, 2, gb);
+	for (f = 0L; nb == tt && f < tt; f++)
+	  if (gb[0][f] != fv[f * nsig] || gb[1][f] != fv[f * nsig + nsig - 1])
+	    break;
+	if (t != tt || nb != tt || f < tt) {
+	  printf("Error: getsignals read format 8 samples incorrectly%s\n",
+		 k > 1 ? " using three threads" : "");
+	  errors++;
+	}
+	else if (vflag)
+	  printf("[OK]:  getsignals read %ld format 8 frames%s\n", nb,
+		 k > 1 ? " using three threads" : "");
+      }
+      setithreads(1);
+    }
+    remove("lcheck8.dat");
+    remove("lcheck8.hea");
+    isigopen(record, si, nsig);
+  }
+  free(fv);
+  free(bv);
+
+  /* *** wfdbnewrecord, isigopen_r, getvec_r, isigsettime_r, sample_r *** */
+  /* Open the record again using a record handle, then read it alternately
+     via the handle and via the default record.  The two must not interfere
+     with each other. */
+  isigsettime(0L);
+  rsi = calloc(nsig, sizeof(WFDB_Siginfo));
+  fv = calloc(framelen, sizeof(WFDB_Sample));
+  if ((rh = wfdbnewrecord()) == NULL ||
+      (istat = isigopen_r(rh, record, rsi, nsig)) != nsig) {
+    printf("Error: can't open record %s using a record handle\n", record);
+    errors++;
+  }
+  else {
+    for (t = 0L; getvec(vector) == nsig; t++) {
+      if (getvec_r(rh, fv) != nsig ||
+	  memcmp(vector, fv, framelen * sizeof(WFDB_Sample)))
+	break;
+      v1 = vector[1];
+    }
+    if (t != tt || getvec_r(rh, fv) != -1) {
+      printf("Error: record handle returned different samples at %s\n",
+	     mstimstr(t));
+      errors++;
+    }
+    else if (isigsettime_r(rh, 0L) != 0 ||
+	     sample_r(rh, 1, tt-1) != v1) {
+      printf("Error: sample_r returned %d (should have been %d)\n",
+	     sample_r(rh, 1, tt-1), v1);
+      errors++;
+    }
+    else if (vflag)
+      printf("[OK]:  record handle read %"WFDB_Pd_TIME" samples\n", t);
+
+    /* *** annopen_r, getann_r *** */
+    iannsettime(0L);
+    if (istat = annopen_r(rh, record, aiarray, 1)) {
+      printf("Error: annopen_r returned %d (should have been 0)\n", istat);
+      errors++;
+    }
+    else {
+      for (i = 0; (istat = getann(0, &annot)) == 0; i++)
+	if (getann_r(rh, 0, &rann) != 0 || rann.time != annot.time ||
+	    rann.anntyp != annot.anntyp)
+	  break;
+      if (istat != -1 || getann_r(rh, 0, &rann) != -1) {
+	printf("Error: record handle returned different annotations\n");
+	errors++;
+      }
+      else if (vflag)
+	printf("[OK]:  record handle read %d annotations\n", i);
+    }
+  }
+  wfdbfreerecord(rh);
+  for (i = 0; i < nsig; i++)
+    free(rsi[i].fname), free(rsi[i].desc), free(rsi[i].units);
+  free(rsi);
+  free(fv);
+
   /* Now return to the beginning of the record and copy it. */
   istat = isigsettime(t = 0L);
   if (istat) {
@@ -686,12 +1396,576 @@ int check(char *record, char *orec)
 	printf("[OK]:  %d info strings copied to record %s header\n", n, orec);
   }
 
+  /* *** getframes (bit-packed formats) *** */
+  /* Copy signal 0 (rescaled) into a single-signal record in each of the
+     bit-packed formats, then read each copy using getframe and again using
+     getframes.  The block decoders used by getframes must return exactly the
+     same samples as the sample-by-sample decoders used by getframe. */
+  for (k = 0; k < 3; k++) {
+    sprintf(prec, "lcheck%d", pfmt[k]);
+    sprintf(pfname, "%s.dat", prec);
+    isigopen(record, si, nsig);
+    si[0].fmt = pfmt[k];
+    si[0].fname = pfname;
+    osigfopen(si, 1);
+    while (getframe(vector) == nsig) {
+      vector[0] = (vector[0] - 1024) / 4;	/* fit into 10 bits */
+      if (putvec(vector) != 1)
+	break;
+    }
+    newheader(prec);
+    osigfopen(NULL, 0);
+    if (isigopen(prec, si, 1) != 1) {
+      printf("Error: can't read record %s\n", prec);
+      errors++;
+      continue;
+    }
+    fv = calloc(tt, sizeof(WFDB_Sample));
+    bv = calloc(tt, sizeof(WFDB_Sample));
+    for (t = 0L; t < tt && getframe(fv + t) == 1; t++)
+      ;
+    isigsettime(0L);
+    for (t = 0L; t < tt; t += nb)
+      if ((nb = getframes(bv + t, tt-t < 1000L ? tt-t : 1000L)) <= 0)
+	break;
+    if (t != tt || getframes(vector, 1L) != -1) {
+      printf("Error: getframes read %"WFDB_Pd_TIME" format %d frames "
+	     "(should have been %"WFDB_Pd_TIME")\n", t, pfmt[k], tt);
+      errors++;
+    }
+    else if (memcmp(fv, bv, tt * sizeof(WFDB_Sample))) {
+      printf("Error: getframes and getframe returned different format %d "
+	     "samples\n", pfmt[k]);
+      errors++;
+    }
+    else if (vflag)
+      printf("[OK]:  getframes and getframe agree for format %d\n", pfmt[k]);
+
+    /* *** putvecs, setoasync *** */
+    /* Write the same samples again using putvecs, with asynchronous output
+       and a small output buffer;  the signal file must be identical to the
+       one written using putvec. */
+    sprintf(vfname, "%sv.dat", prec);
+    si[0].fmt = pfmt[k];
+    si[0].fname = vfname;
+    setoasync(3);
+    setobsize(1024);
+    osigfopen(si, 1);
+    if ((nb = putvecs(fv, tt)) != tt) {
+      printf("Error: putvecs returned %ld (should have been %ld)\n",
+	     nb, (long)tt);
+      errors++;
+    }
+    osigfopen(NULL, 0);
+    setoasync(0);
+    setobsize(0);
+    c = 0;
+    if ((fa = fopen(pfname, "rb")) && (fb = fopen(vfname, "rb"))) {
+      while ((c = getc(fa)) == getc(fb) && c != EOF)
+	;
+      fclose(fb);
+    }
+    if (fa) fclose(fa);
+    if (c != EOF) {
+      printf("Error: putvecs and putvec wrote different format %d files\n",
+	     pfmt[k]);
+      errors++;
+    }
+    else if (vflag)
+      printf("[OK]:  putvecs and putvec agree for format %d\n", pfmt[k]);
+    remove(vfname);
+    free(fv);
+    free(bv);
+  }
+
+  /* *** frame decoders *** */
+  /* Write a record in each format, with each of several layouts (those for
+     which getframe has specialized frame decoders, and two for which it does
+     not), and read it back using getframe, without and then with WFDB_GVPAD.
+     The samples must be those written, except that in WFDB_GVPAD mode each
+     invalid sample is replaced by the previous valid sample of its signal.
+     Frames that span the end of the input buffer are read by the general
+     code in getskewedframe, and the others by the group's frame decoder. */
+  {
+    static int dfmt[] = { 8, 16, 61, 80, 160, 212, 310, 311, 24, 32 };
+    static int dnsig[] = { 1, 2, 3, 4, 8, 12, 16, 5, 3 };
+    static int dspf[] = { 1, 1, 1, 1, 1, 1, 1, 1, 2 };
+    WFDB_Siginfo dsi[16];
+    WFDB_Sample *dw, dv[32], last[16], w;
+    int f, l, pad, s, dlen, bad = 0, mode = getgvmode();
+
+    dw = calloc(600L * 32, sizeof(WFDB_Sample));
+    for (f = 0; f < 10; f++)
+      for (l = 0; l < 9; l++) {
+	dlen = dnsig[l] * dspf[l];
+	for (s = 0; s < dnsig[l]; s++) {
+	  dsi[s] = si[0];
+	  dsi[s].fname = "lcheckd.dat";
+	  dsi[s].fmt = dfmt[f];
+	  dsi[s].spf = dspf[l];
+	  dsi[s].group = 0;
+	  dsi[s].bsize = 0;
+	}
+	/* Format 8 cannot represent invalid samples. */
+	for (t = 0L; t < 600L * dlen; t++)
+	  dw[t] = (dfmt[f] != 8 && t >= dlen && t % 29 == 11) ?
+	    WFDB_INVALID_SAMPLE : (t / dlen + t % dlen) % 101 - 50;
+	osigfopen(dsi, dnsig[l]);
+	for (t = 0L; t < 600L && putvec(dw + t * dlen) == dnsig[l]; t++)
+	  ;
+	newheader("lcheckd");
+	osigfopen(NULL, 0);
+	if (isigopen("lcheckd", dsi, dnsig[l]) != dnsig[l]) {
+	  printf("Error: can't read format %d record lcheckd\n", dfmt[f]);
+	  errors++;
+	  bad++;
+	  continue;
+	}
+	for (pad = 0; pad < 2; pad++) {
+	  setgvmode(pad ? (mode | WFDB_GVPAD) : (mode & ~WFDB_GVPAD));
+	  isigsettime(0L);
+	  for (s = 0; s < dnsig[l]; s++)
+	    last[s] = dw[s * dspf[l]];
+	  for (t = 0L, i = dlen; t < 600L && i == dlen; t++) {
+	    if (getframe(dv) != dnsig[l])
+	      break;
+	    for (i = 0; i < dlen; i++) {
+	      w = dw[t * dlen + i];
+	      s = i / dspf[l];
+	      if (w != WFDB_INVALID_SAMPLE)
+		last[s] = w;
+	      else if (pad)
+		w = last[s];
+	      if (dv[i] != w)
+		break;
+	    }
+	  }
+	  if (t != 600L || i != dlen || getframe(dv) != -1) {
+	    printf("Error: getframe misread format %d frames of %d signals "
+		   "with %d samples per frame%s\n", dfmt[f], dnsig[l], dspf[l],
+		   pad ? " (WFDB_GVPAD mode)" : "");
+	    errors++;
+	    bad++;
+	  }
+	}
+      }
+    setgvmode(mode);
+    if (bad == 0 && vflag)
+      printf("[OK]:  getframe decoded 10 formats in 9 layouts\n");
+    free(dw);
+    remove("lcheckd.dat");
+    remove("lcheckd.hea");
+  }
+
+  /* *** setifreqmode, setifreq *** */
+  /* Write a record containing a ramp, a constant, and a signal that
+     alternates between -500 and 500, and read it using getvec in
+     WFDB_RESAMPLE_SINC mode at 500 Hz, and again at 100 Hz.  Away from the
+     ends of the record, the ramp must be reproduced at the output sampling
+     times, and at 100 Hz the alternating signal (at the input Nyquist
+     frequency) must be removed;  the constant must be reproduced exactly
+     throughout. */
+  {
+    static WFDB_Frequency rf[2] = { 500., 100. };
+    static long rm0[2] = { 40L, 25L }, rm1[2] = { 4900L, 970L };
+    WFDB_Frequency af = getafreq();
+    WFDB_Sample *rw, *rv;
+    double y;
+    long m;
+
+    rw = calloc(3 * 3600L, sizeof(WFDB_Sample));
+    rv = calloc(3 * 10000L, sizeof(WFDB_Sample));
+
+    for (i = 0; i < 3; i++) {
+      psi[i] = si[0];
+      psi[i].fmt = 16;
+      psi[i].spf = 1;
+      psi[i].group = 0;
+      psi[i].bsize = 0;
+      psi[i].fname = "lcheckr.dat";
+    }
+    for (t = 0L; t < 3600L; t++) {
+      rw[3 * t] = t;
+      rw[3 * t + 1] = 100;
+      rw[3 * t + 2] = (t & 1) ? 500 : -500;
+    }
+    osigfopen(psi, 3);
+    for (t = 0L; t < 3600L && putvec(rw + 3 * t) == 3; t++)
+      ;
+    newheader("lcheckr");
+    osigfopen(NULL, 0);
+    for (k = 0; k < 2; k++) {
+      if (isigopen("lcheckr", psi, 3) != 3 || (f = sampfreq(NULL)) <= 0. ||
+	  setifreqmode(WFDB_RESAMPLE_SINC) < 0 || setifreq(rf[k]) < 0) {
+	printf("Error: can't resample record lcheckr\n");
+	errors++;
+	break;
+      }
+      for (m = 0L; m < 10000L && getvec(rv + 3 * m) == 3; m++)
+	;
+      for (nb = 0L; nb < m && rv[3 * nb + 1] == 100; nb++) {
+	if (nb < rm0[k] || nb >= rm1[k])
+	  continue;
+	y = nb * f / rf[k] - rv[3 * nb];
+	if (y > 1. || y < -1. ||
+	    (k == 1 && (rv[3 * nb + 2] > 2 || rv[3 * nb + 2] < -2)))
+	  break;
+      }
+      if (m < rm1[k] || nb < m) {
+	printf("Error: getvec resampled record lcheckr incorrectly at %g "
+	       "Hz\n", rf[k]);
+	errors++;
+      }
+      else if (vflag)
+	printf("[OK]:  getvec resampled record lcheckr at %g Hz\n", rf[k]);
+    }
+    if ((f = sampfreq(NULL)) > 0.)
+      setifreq(f);	/* don't resample the records read below */
+    setifreqmode(WFDB_RESAMPLE_LINEAR);
+    setafreq(af);
+    free(rw);
+    free(rv);
+    remove("lcheckr.dat");
+    remove("lcheckr.hea");
+  }
+
+  /* *** setithreads *** */
+  /* Read the three bit-packed copies together, as a record with three signal
+     groups, using getframe and again using getframes with three decoding
+     threads, which must return the same samples. */
+  fv = calloc(3 * tt, sizeof(WFDB_Sample));
+  bv = calloc(3 * tt, sizeof(WFDB_Sample));
+  setithreads(3);
+  if (isigopen("lcheck212", psi, 1) != 1 ||
+      isigopen("+lcheck310", psi + 1, 1) != 1 ||
+      isigopen("+lcheck311", psi + 2, 1) != 1) {
+    printf("Error: can't read records lcheck212, lcheck310, and lcheck311\n");
+    errors++;
+  }
+  else {
+    for (t = 0L; t < tt && getframe(fv + 3 * t) == 3; t++)
+      ;
+    isigsettime(0L);
+    for (t = 0L; t < tt; t += nb)
+      if ((nb = getframes(bv + 3 * t, tt - t)) <= 0)
+	break;
+    if (t != tt || memcmp(fv, bv, 3 * tt * sizeof(WFDB_Sample))) {
+      printf("Error: getframes decoded three signal groups differently "
+	     "using three threads\n");
+      errors++;
+    }
+    else if (vflag)
+      printf("[OK]:  getframes decoded three signal groups in parallel\n");
+  }
+  free(fv);
+  free(bv);
+
+  /* *** format 1000 *** */
+  /* Copy the record into a compressed signal file, and read the copy using
+     getframe, and again after a seek into the middle of a block;  the samples
+     must be those of the original record. */
+  fv = calloc(tt * framelen, sizeof(WFDB_Sample));
+  bv = calloc(tt * framelen, sizeof(WFDB_Sample));
+  isigopen(record, si, nsig);
+  for (t = 0L; t < tt && getframe(fv + t * framelen) == nsig; t++)
+    ;
+  for (i = 0; i < nsig; i++) {
+    si[i].fmt = 1000;
+    si[i].group = 0;
+    si[i].fname = "lcheck1000.dat";
+  }
+  osigfopen(si, nsig);
+  for (t = 0L; t < tt && putvec(fv + t * framelen) == nsig; t++)
+    ;
+  newheader("lcheck1000");
+  osigfopen(NULL, 0);
+  if (isigopen("lcheck1000", si, nsig) != nsig) {
+    printf("Error: can't read record lcheck1000\n");
+    errors++;
+  }
+  else {
+    for (t = 0L; t < tt && getframe(bv + t * framelen) == nsig; t++)
+      ;
+    if (t != tt || getframe(vector) != -1 ||
+	memcmp(fv, bv, tt * framelen * sizeof(WFDB_Sample))) {
+      printf("Error: getframe read format 1000 samples incorrectly\n");
+      errors++;
+    }
+    else if (isigsettime(t = tt / 2 + 1) < 0 || getframe(vector) != nsig ||
+	     memcmp(vector, fv + t * framelen, framelen * sizeof(WFDB_Sample))) {
+      printf("Error: getframe read format 1000 samples incorrectly after a "
+	     "seek\n");
+      errors++;
+    }
+    else if (vflag)
+      printf("[OK]:  getframe read %"WFDB_Pd_TIME" format 1000 frames\n", tt);
+  }
+
+  /* Write a signal whose small samples are interrupted by large jumps (whose
+     residuals are escaped and stored in 40 bits) and by invalid samples, in
+     a block and a few more frames, then read it using getframes, and again
+     after a seek into its short last block. */
+  {
+    static char xhea[] = "lcheckx 2 360\n"
+      "lcheckz.dat 16 200 16 0 0 0 0 a\n"
+      "lcheckz.dat 1000 200 16 0 0 0 0 b\n";
+    WFDB_Siginfo zsi[2];
+    WFDB_Sample *zv, *zb;
+    long zn = 4101L;
+    FILE *hf;
+
+    zv = calloc(zn, sizeof(WFDB_Sample));
+    zb = calloc(zn, sizeof(WFDB_Sample));
+    for (t = 0L; t < zn; t++)
+      zv[t] = (t % 1000L == 999L) ? WFDB_INVALID_SAMPLE :
+	(t % 500L == 250L) ? ((t & 1) ? -2000000000 : 2000000000) :
+	(WFDB_Sample)(t % 7L) - 3;
+    zsi[0] = si[0];
+    zsi[0].fmt = 1000;
+    zsi[0].group = 0;
+    zsi[0].spf = 1;
+    zsi[0].fname = "lcheckz.dat";
+    zsi[0].desc = "z";
+    osigfopen(zsi, 1);
+    for (t = 0L; t < zn && putvec(zv + t) == 1; t++)
+      ;
+    newheader("lcheckz");
+    osigfopen(NULL, 0);
+    nb = (isigopen("lcheckz", zsi, 1) == 1) ? getframes(zb, zn) : -1L;
+    if (nb != zn || getframe(vector) != -1 ||
+	memcmp(zv, zb, zn * sizeof(WFDB_Sample))) {
+      printf("Error: getframes read escaped and invalid format 1000 samples "
+	     "incorrectly\n");
+      errors++;
+    }
+    else if (isigsettime(t = zn - 3L) < 0 || getframe(vector) != 1 ||
+	     vector[0] != zv[t]) {
+      printf("Error: getframe read the short last format 1000 block "
+	     "incorrectly after a seek\n");
+      errors++;
+    }
+    else if (vflag)
+      printf("[OK]:  getframes read escaped and invalid format 1000 "
+	     "samples\n");
+
+    /* A record with a signal file that contains signals in format 1000 and
+       in other formats cannot be read, whichever signal comes first.  The
+       error is expected, so any earlier errors not detected by this program
+       are reported now. */
+    if ((hf = fopen("lcheckx.hea", "w"))) {
+      fputs(xhea, hf);
+      fclose(hf);
+    }
+    liberrors();
+    wfdbquiet();
+    n = isigopen("lcheckx", zsi, 2);
+    wfdbverbose();
+    if (n >= 0) {
+      printf("Error: isigopen returned %d for record lcheckx (should have "
+	     "been negative)\n", n);
+      errors++;
+    }
+    else {
+      p = wfdberror();
+      xerror = realloc(xerror, strlen(p) + 1);
+      strcpy(xerror, p);
+      if (vflag)
+	printf("[OK]:  isigopen rejected a group that mixes format 1000 with "
+	       "others\n");
+    }
+    remove("lcheckx.hea");
+    remove("lcheckz.hea");
+    remove("lcheckz.dat");
+    free(zv);
+    free(zb);
+  }
+
+  /* *** getsigview *** */
+  /* Copy the record into a format 16 signal file, and view all of its frames
+     using getsigview, with and without memory mapping;  the views must
+     contain the samples of the original record, and mark the invalid ones. */
+  for (i = 0; i < nsig; i++) {
+    si[i].fmt = 16;
+    si[i].fname = "lcheck16.dat";
+  }
+  osigfopen(si, nsig);
+  putvecs(fv, tt);
+  newheader("lcheck16");
+  osigfopen(NULL, 0);
+  bits = calloc((tt * framelen + 7) / 8, 1);
+  for (k = 1; k >= 0; k--) {
+    j = setimmap(k);
+    nb = (isigopen("lcheck16", si, nsig) == nsig) ?
+      getsigview(0, 0L, tt, &view, bits) : -1L;
+    if (nb != tt) {
+      printf("Error: getsigview returned %ld (should have been %ld)\n", nb,
+	     (long)tt);
+      errors++;
+    }
+    else {
+      for (t = 0L; t < tt * framelen; t++)
+	if (view[t] != fv[t] || ((bits[t / 8] >> (t % 8)) & 1) !=
+	    (fv[t] != WFDB_INVALID_SAMPLE))
+	  break;
+      if (t < tt * framelen) {
+	printf("Error: getsigview returned different samples%s\n",
+	       k ? "" : " without memory mapping");
+	errors++;
+      }
+      else if (vflag)
+	printf("[OK]:  getsigview viewed %ld frames%s\n", nb,
+	       k ? "" : " without memory mapping");
+    }
+    setimmap(j);
+  }
+  free(bits);
+  /* View the last 10 frames again, asking for many more;  only the frames
+     that remain are viewed, and read without memory mapping. */
+  nb = (isigopen("lcheck16", si, nsig) == nsig) ?
+    getsigview(0, tt - 10L, (WFDB_Time)1 << 40, &view, NULL) : -1L;
+  for (t = 0L; nb == 10L && t < 10L * framelen; t++)
+    if (view[t] != fv[(tt - 10L) * framelen + t])
+      break;
+  if (nb != 10L || t < 10L * framelen) {
+    printf("Error: getsigview returned %ld frames past the end (should have "
+	   "been 10)\n", nb);
+    errors++;
+  }
+  else if (vflag)
+    printf("[OK]:  getsigview viewed only the last 10 frames\n");
+
+  /* *** skewed signals *** */
+  /* Copy the record, giving its second signal a skew of 3 frames, and read
+     the copy using getframes;  that signal's samples must be those of the
+     original record 3 frames later, and the last 3 frames must be missing. */
+  if (nsig > 1) {
+    for (i = 0; i < nsig; i++)
+      si[i].fname = "lchecks.dat";
+    osigfopen(si, nsig);
+    wfdbsetskew(1, 3);
+    putvecs(fv, tt);
+    newheader("lchecks");
+    osigfopen(NULL, 0);
+    memset(bv, 0, tt * framelen * sizeof(WFDB_Sample));
+    nb = (isigopen("lchecks", si, nsig) == nsig) ? getframes(bv, tt) : -1L;
+    for (t = 0L; nb == tt - 3 && t < nb * framelen; t++) {
+      k = t % framelen - si[0].spf;
+      if (bv[t] != fv[(k >= 0 && k < si[1].spf) ? t + 3 * framelen : t])
+	break;
+    }
+    if (nb != tt - 3 || t < nb * framelen) {
+      printf("Error: getframes read skewed signals incorrectly\n");
+      errors++;
+    }
+    else if (vflag)
+      printf("[OK]:  getframes read %ld deskewed frames\n", nb);
+  }
+
+  /* *** getstreams, getvecs *** */
+  /* Copy the first two signals of the record, taking two frames at a time,
+     so that the first signal of the copy has two samples per frame.  Read
+     the copy using getstreams, which must return each signal at its own
+     rate, and again using getvecs in WFDB_LOWRES mode, which must return the
+     mean of each pair of samples of the first signal. */
+  if (nsig > 1) {
+    long nm = tt / 2;
+    WFDB_Sample *mv = calloc(nm * 3, sizeof(WFDB_Sample)), *mb[2], a, b;
+
+    for (t = 0L; t < 2 * nm; t++) {
+      mv[t / 2 * 3 + t % 2] = fv[t * framelen];
+      if (t % 2 == 0)
+	mv[t / 2 * 3 + 2] = fv[t * framelen + si[0].spf];
+    }
+    for (i = 0; i < 2; i++) {
+      si[i].fmt = 16;
+      si[i].spf = 2 - i;
+      si[i].fname = "lcheckm.dat";
+    }
+    osigfopen(si, 2);
+    putvecs(mv, nm);
+    newheader("lcheckm");
+    osigfopen(NULL, 0);
+    mb[0] = bv;
+    mb[1] = bv + 2 * nm;
+    nb = (isigopen("lcheckm", si, 2) == 2) ? getstreams(mb, nm) : -1L;
+    for (t = 0L; nb == nm && t < nm; t++)
+      if (mb[0][2 * t] != mv[t * 3] || mb[0][2 * t + 1] != mv[t * 3 + 1] ||
+	  mb[1][t] != mv[t * 3 + 2])
+	break;
+    if (nb != nm || t < nm) {
+      printf("Error: getstreams read signals incorrectly\n");
+      errors++;
+    }
+    else if (vflag)
+      printf("[OK]:  getstreams read %ld frames\n", nb);
+    k = getgvmode();
+    setgvmode(WFDB_LOWRES);
+    nb = (isigsettime(0L) == 0) ? getvecs(bv, nm) : -1L;
+    for (t = 0L; nb == nm && t < nm; t++) {
+      a = mv[t * 3];
+      b = mv[t * 3 + 1];
+      if (a == WFDB_INVALID_SAMPLE || b == WFDB_INVALID_SAMPLE)
+	a = WFDB_INVALID_SAMPLE;
+      else if ((c = a + b + 1) >= 0)
+	a = c / 2;
+      else
+	a = -((1 - c) / 2);
+      if (bv[2 * t] != a || bv[2 * t + 1] != mv[t * 3 + 2])
+	break;
+    }
+    if (nb != nm || t < nm) {
+      printf("Error: getvecs averaged samples incorrectly\n");
+      errors++;
+    }
+    else if (vflag)
+      printf("[OK]:  getvecs read %ld averaged vectors\n", nb);
+    setgvmode(k);
+    free(mv);
+  }
+  free(fv);
+  free(bv);
+
   wfdbquit();
+  remove("lchecks.dat");
+  remove("lchecks.hea");
+  remove("lcheckm.dat");
+  remove("lcheckm.hea");
+  remove("lcheck1000.dat");
+  remove("lcheck1000.hea");
+  remove("lcheck16.dat");
+  remove("lcheck16.hea");
+  setithreads(1);
+  for (k = 0; k < 3; k++) {
+    sprintf(pfname, "lcheck%d.dat", pfmt[k]);
+    remove(pfname);
+    sprintf(pfname, "lcheck%d.hea", pfmt[k]);
+    remove(pfname);
+  }
   setecgstr(1, "N");
   setannstr(-1, "N");
   setanndesc(-1, "Normal beat");
 }
 
+/* liberrors reports any errors detected by the WFDB library but not by this
+   program, and returns the number of errors reported.  The last library error
+   is not reported if it was caused deliberately (see xerror). */
+int liberrors(void)
+{
+  int e = errors;
+
+  if ((p = wfdberror()) == NULL) {
+    printf("Error: wfdberror() did not return a version string\n");
+    p = "unknown version of the WFDB library";
+    errors++;
+  }
+  if (strcmp(libversion, p) && (xerror == NULL || strcmp(xerror, p))) {
+    printf("Error: WFDB library error(s) not detected by %s\n", pname);
+    printf(" Last library error was: '%s'\n", p);
+    errors++;
+  }
+  return (errors - e);
+}
+
 char *prog_name(s)
 char *s;
 {
@@ -743,7 +2017,6 @@ void list_untested()
     printf("setheader\n");
     printf("setmsheader\n");
     printf("wfdbgetskew\n");
-    printf("wfdbsetskew\n");
     printf("wfdbgetstart\n");
     printf("wfdbsetstart\n");
     printf("getcfreq\n");
@@ -757,6 +2030,12 @@ void list_untested()
     printf("setobsize\n");
     printf("wfdbfile\n");
     printf("wfdbflush\n");
-    printf("setifreq\n");
     printf("getifreq\n");
+    printf("aduphysv\n");
+    printf("aduphysvf\n");
+    printf("physaduv\n");
+    printf("physaduvf\n");
+    printf("getphysframesf\n");
+    printf("getvecs16\n");
+    printf("getvecsf\n");
 }
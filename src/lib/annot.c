@@ -53,6 +53,8 @@ This file also contains definitions of the following WFDB library functions:
  getiaorigfreq [10.6]	(returns time resolution of original annotation file)
  iannclose [9.1]	(closes an input annotation file)
  oannclose [9.1]	(closes an output annotation file)
+ annopen_r [20.0]	(annopen for a specified record handle)
+ getann_r [20.0]	(getann for a specified record handle)
 
  These functions are intended primarily for the use by WFDB wrappers:
 
@@ -76,6 +78,9 @@ These functions, also defined here, are intended only for the use of WFDB
 library functions defined elsewhere:
  wfdb_anclose		(closes all annotation files)
  wfdb_oaflush		(flushes output annotations)
+ wfdb_newannstate [20.0] (allocates annotator state for a record handle)
+ wfdb_freeannstate [20.0] (frees annotator state allocated by wfdb_newannstate)
+ wfdb_setannstate [20.0] (selects the calling thread's annotator state)
 
 Beginning with version 5.3, the functions in this file read and write
 annotation translation table modifications as `modification labels' (`NOTE'
@@ -99,8 +104,11 @@ may be attached to the same signal provided that their num fields are unique.
 
 #include <limits.h>
 
+#include <mutex>
+
 #include "ecgcodes.h"
 #include "ecgmap.h"
+#include "signal.hh"
 #include "wfdbio.hh"
 
 /* Annotation word format */
@@ -129,10 +137,16 @@ may be attached to the same signal provided that their num fields are unique.
 #define AUXLEN 6     /* length of AHA aux field */
 #define EOAF 0377    /* padding for end of AHA annotation files */
 
-/* Shared local data */
-static unsigned maxiann; /* max allowed number of input annotators */
-static unsigned niaf;    /* number of open input annotators */
-static struct iadata {
+/* Shared local data
+
+   The state of the annotation functions belongs to a WfdbAnnotState object.
+   Each record handle (see wfdbnewrecord in signal.c) owns one of these, and
+   the functions in this file operate on the one selected by wfdb_setannstate
+   for the calling thread (by default, the one used by the default record).
+   The fields of the current state are referred to below by their historical
+   names (iad, niaf, ...), which are defined as macros following the
+   definition of WfdbAnnotState. */
+struct iadata {
   WFDB_FILE *file;      /* file pointer for input annotation file */
   WFDB_Anninfo info;    /* input annotator information */
   WFDB_Annotation ann;  /* next annotation to be returned by getann */
@@ -154,11 +168,9 @@ static struct iadata {
                                       returned by getann */
   WFDB_Time prev_time;             /* sample number of the last annotation
                                       returned by getann */
-} * *iad;
+};
 
-static unsigned maxoann; /* max allowed number of output annotators */
-static unsigned noaf;    /* number of open output annotators */
-static struct oadata {
+struct oadata {
   WFDB_FILE *file;      /* file pointer for output annotation file */
   WFDB_Anninfo info;    /* output annotator information */
   WFDB_Annotation ann;  /* most recent annotation written by putann */
@@ -169,11 +181,35 @@ static struct oadata {
                            putann are not in the canonical (time, num,
                            chan) order */
   char table_written;   /* if >0, table has been written */
-} * *oad;
-static WFDB_Frequency oafreq; /* time resolution in ticks/sec for newly-
-                                 created output annotators */
-static int annclose_error;    /* if <0, error occurred while closing
-                                 annotation files */
+};
+
+struct WfdbAnnotState {
+  unsigned maxiann;      /* max allowed number of input annotators */
+  unsigned niaf;         /* number of open input annotators */
+  struct iadata **iad;
+  unsigned maxoann;      /* max allowed number of output annotators */
+  unsigned noaf;         /* number of open output annotators */
+  struct oadata **oad;
+  WFDB_Frequency oafreq; /* time resolution in ticks/sec for newly-
+                            created output annotators */
+  int annclose_error;    /* if <0, error occurred while closing
+                            annotation files */
+};
+
+static WfdbAnnotState default_annstate;
+static thread_local WfdbAnnotState *acur = &default_annstate;
+
+/* Each of the following names refers to the field of the same name in the
+   current annotation state.  They are undefined before the functions that
+   create and select annotation states, near the end of this file. */
+#define maxiann (acur->maxiann)
+#define niaf (acur->niaf)
+#define iad (acur->iad)
+#define maxoann (acur->maxoann)
+#define noaf (acur->noaf)
+#define oad (acur->oad)
+#define oafreq (acur->oafreq)
+#define annclose_error (acur->annclose_error)
 
 typedef unsigned long long unsigned_time;
 
@@ -202,6 +238,16 @@ static WFDB_Time round_to_time(double x) {
   }
 }
 
+/* The mnemonic and description tables used by annstr, strann, and anndesc,
+   and the record of which entries have been modified (see setannstr), are
+   shared by all record handles (so a change made while one handle is selected
+   applies to all of them, including the tables that put_ann_table writes for
+   each handle's output annotators).  They are guarded by anntabmutex, so that
+   annopen_r may be called for different handles concurrently.  Replaced strings
+   are never freed, so the pointers returned by annstr and anndesc remain
+   valid. */
+static std::recursive_mutex anntabmutex;
+
 static int get_ann_table(WFDB_Annotator i) {
   char *p1, *p2;
   int a;
@@ -254,6 +300,7 @@ static int put_ann_table(WFDB_Annotator i) {
   int a, flag = 0, n;
   char buf[256], *str = NULL;
   WFDB_Annotation annot;
+  std::lock_guard<std::recursive_mutex> lock(anntabmutex);
 
   annot.time = 0L;
   annot.anntyp = NOTE;
@@ -557,6 +604,23 @@ int getann(WFDB_Annotator n, WFDB_Annotation *annot) {
   return (0);
 }
 
+/* annopen_r, getann_r: annopen and getann for record handle r (see
+   wfdbnewrecord in signal.c).  annopen_r may be called concurrently for
+   different handles;  the annotation type tables that it reads from the
+   annotation files are shared (see anntabmutex). */
+int annopen_r(WfdbRecord *r, char *record, const WFDB_Anninfo *aiarray,
+              unsigned int nann) {
+  WfdbRecordScope scope(r);
+
+  return (annopen(record, aiarray, nann));
+}
+
+int getann_r(WfdbRecord *r, WFDB_Annotator n, WFDB_Annotation *annot) {
+  WfdbRecordScope scope(r);
+
+  return (getann(n, annot));
+}
+
 /* ungetann: push back an annotation into an input stream */
 int ungetann(WFDB_Annotator n, const WFDB_Annotation *annot) {
   if (n >= niaf || iad[n] == NULL) {
@@ -777,7 +841,7 @@ static char *cstring[ACMAX + 1] = {
 
 /* ecgstr: convert an anntyp value to a mnemonic string */
 char *ecgstr(int code) {
-  static char buf[14];
+  static thread_local char buf[14];
 
   if (0 <= code && code <= ACMAX)
     return (cstring[code]);
@@ -828,7 +892,8 @@ static char *astring[ACMAX + 1] = {
 };
 
 char *annstr(int code) {
-  static char buf[14];
+  static thread_local char buf[14];
+  std::lock_guard<std::recursive_mutex> lock(anntabmutex);
 
   if (0 <= code && code <= ACMAX)
     return (astring[code]);
@@ -840,6 +905,7 @@ char *annstr(int code) {
 
 int strann(const char *str) {
   int code;
+  std::lock_guard<std::recursive_mutex> lock(anntabmutex);
 
   if (str == NULL) str = "";
   for (code = 1; code <= ACMAX; code++)
@@ -849,6 +915,7 @@ int strann(const char *str) {
 
 int setannstr(int code, const char *string) {
   int mflag = 0;
+  std::lock_guard<std::recursive_mutex> lock(anntabmutex);
 
   if (code > 0)
     mflag = 1;
@@ -921,6 +988,8 @@ static char *tstring[ACMAX + 1] = {/* descriptive strings for each code */
                                    (char *)NULL};
 
 char *anndesc(int code) {
+  std::lock_guard<std::recursive_mutex> lock(anntabmutex);
+
   if (0 <= code && code <= ACMAX)
     return (tstring[code]);
   else
@@ -929,6 +998,7 @@ char *anndesc(int code) {
 
 int setanndesc(int code, const char *string) {
   int mflag = 0;
+  std::lock_guard<std::recursive_mutex> lock(anntabmutex);
 
   if (code > 0)
     mflag = 1;
@@ -1132,3 +1202,43 @@ void wfdb_anclose() {
   for (an = niaf; an != 0; an--) iannclose(an - 1);
   for (an = noaf; an != 0; an--) oannclose(an - 1);
 }
+
+/* Undefine the names of fields of the current annotation state (see acur). */
+#undef maxiann
+#undef niaf
+#undef iad
+#undef maxoann
+#undef noaf
+#undef oad
+#undef oafreq
+#undef annclose_error
+
+/* wfdb_newannstate, wfdb_freeannstate, and wfdb_setannstate are used by the
+   record handle functions in signal.c.  wfdb_freeannstate does not close any
+   annotation files (wfdb_anclose should be used first, with the state
+   selected).  wfdb_setannstate(NULL) selects the default state, and returns
+   the previously selected state. */
+WfdbAnnotState *wfdb_newannstate() {
+  WfdbAnnotState *as;
+
+  SUALLOC(as, 1, sizeof(WfdbAnnotState));
+  return (as);
+}
+
+void wfdb_freeannstate(WfdbAnnotState *as) {
+  unsigned m;
+
+  if (as == NULL || as == &default_annstate) return;
+  for (m = 0; m < as->maxiann; m++) SFREE(as->iad[m]);
+  SFREE(as->iad);
+  for (m = 0; m < as->maxoann; m++) SFREE(as->oad[m]);
+  SFREE(as->oad);
+  SFREE(as);
+}
+
+WfdbAnnotState *wfdb_setannstate(WfdbAnnotState *as) {
+  WfdbAnnotState *prev = acur;
+
+  acur = as ? as : &default_annstate;
+  return (prev);
+}
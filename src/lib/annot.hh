@@ -5,9 +5,16 @@
 
 void wfdb_anclose();
 void wfdb_oaflush();
+struct WfdbAnnotState;
+WfdbAnnotState *wfdb_newannstate();
+void wfdb_freeannstate(WfdbAnnotState *as);
+WfdbAnnotState *wfdb_setannstate(WfdbAnnotState *as);
 
 int annopen(char *record, const WFDB_Anninfo *aiarray, unsigned int nann);
 int getann(WFDB_Annotator a, WFDB_Annotation *annot);
+int annopen_r(struct WfdbRecord *r, char *record, const WFDB_Anninfo *aiarray,
+              unsigned int nann);
+int getann_r(struct WfdbRecord *r, WFDB_Annotator a, WFDB_Annotation *annot);
 int ungetann(WFDB_Annotator a, const WFDB_Annotation *annot);
 int putann(WFDB_Annotator a, const WFDB_Annotation *annot);
 int iannsettime(WFDB_Time t);
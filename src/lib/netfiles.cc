@@ -6,6 +6,7 @@
 #include <stdlib.h>
 
 #include <map>
+#include <mutex>
 #include <string>
 #include <tuple>
 
@@ -23,6 +24,10 @@ static long page_size = kNfPageSize; /* bytes per range request (0: disable
 static int www_done_init = 0;        /* TRUE once libcurl is initialized */
 
 static CURL *curl_ua = NULL;
+static std::mutex curl_mutex; /* held while curl_ua is in use (see nf_pread) */
+static std::mutex redirect_mutex; /* held while the redirect_url and
+                                     redirect_time of any Netfile are in use
+                                     (see nf_get_url_range_chunk) */
 static char curl_error_buf[CURL_ERROR_SIZE];
 
 // Key: domain. Value: <username, password>
@@ -131,6 +136,7 @@ Chunk *curl_chunk_new(long len) {
   c->start_pos = 0;
   c->end_pos = 0;
   c->total_size = 0;
+  c->code = 0;
   c->url = NULL;
   return c;
 }
@@ -145,6 +151,7 @@ void curl_chunk_delete(Chunk *c) {
 }
 
 Chunk *www_get_url_chunk(const char *url) {
+  std::lock_guard<std::mutex> lock(curl_mutex);
   Chunk *chunk = NULL;
 
   chunk = curl_chunk_new(1024);
@@ -190,23 +197,29 @@ void nf_delete(Netfile *nf) {
 }
 
 Chunk *nf_get_url_range_chunk(Netfile *nf, long startb, long len) {
-  char *url;
+  std::string url;
   Chunk *chunk;
   unsigned int request_time;
 
   /* If a previous request for this file was recently redirected,
      use the previous (redirected) URL; otherwise, use the original
      URL.  (If the system clock moves backwards, the cache is
-     assumed to be out-of-date.) */
-  request_time = www_time();
-  if (request_time - nf->redirect_time > kRedirectCacheTime) {
-    SFREE(nf->redirect_url);
+     assumed to be out-of-date.)  The URL is copied, since another
+     thread (see nf_pread) may replace nf->redirect_url during the
+     request. */
+  {
+    std::lock_guard<std::mutex> lock(redirect_mutex);
+    request_time = www_time();
+    if (request_time - nf->redirect_time > kRedirectCacheTime) {
+      SFREE(nf->redirect_url);
+    }
+    url = (nf->redirect_url ? nf->redirect_url : nf->url);
   }
-  url = (nf->redirect_url ? nf->redirect_url : nf->url);
 
-  chunk = www_get_url_range_chunk(url, startb, len);
+  chunk = www_get_url_range_chunk(url.c_str(), startb, len);
 
   if (chunk && chunk->url) {
+    std::lock_guard<std::mutex> lock(redirect_mutex);
     /* don't update redirect_time if we didn't hit nf->url */
     if (!nf->redirect_url) nf->redirect_time = request_time;
     SSTRCPY(nf->redirect_url, chunk->url);
@@ -370,6 +383,50 @@ long nf_get_range(Netfile *nf, long startb, long len, char *rbuf) {
   return (len);
 }
 
+/* nf_pread reads up to len bytes of nf, beginning at startb, into rbuf, and
+   returns the number of bytes read (less than len only at the end of the file),
+   or -1 in case of error.  Unlike nf_get_range, it neither uses nor updates
+   nf's position or cache, so that it may be used by several threads at once;
+   each call that is not satisfied from a file held entirely in memory makes
+   its own range request (via the redirection cache, like nf_get_range) while
+   curl_mutex is held.  The response must contain exactly the requested bytes:
+   an HTTP server must send them as partial content (206), with a Content-Range
+   that covers exactly the requested range, and a server that ignores the range
+   or returns a different one produces an error.  Other protocols (such as
+   file://) apply the range without reporting it, so for them only the size of
+   the response is checked. */
+long nf_pread(Netfile *nf, long startb, long len, char *rbuf) {
+  Chunk *chunk;
+
+  if (nf == NULL || startb < 0L || len < 0L || rbuf == NULL) return (-1L);
+  if (startb >= nf->cont_len) return (0L);
+  if (len > nf->cont_len - startb) len = nf->cont_len - startb;
+  if (len == 0L) return (0L);
+
+  if (nf->mode != NetfileMode::kChunkMode) { /* full file is in memory */
+    memcpy(rbuf, nf->data + startb, len);
+    return (len);
+  }
+  if ((chunk = nf_get_url_range_chunk(nf, startb, len)) == NULL) {
+    wfdb_error("nf_pread: couldn't read %ld bytes of %s starting at %ld\n",
+               len, nf->url, startb);
+    return (-1L);
+  }
+  if (chunk->size != len ||
+      (chunk->code != 0 &&
+       (chunk->code != 206 || chunk->start_pos != (unsigned long)startb ||
+        chunk->end_pos != (unsigned long)(startb + len - 1)))) {
+    wfdb_error("nf_pread: requested bytes %ld-%ld of %s, received %ld bytes "
+               "(%lu-%lu)\n", startb, startb + len - 1, nf->url,
+               (long)chunk->size, chunk->start_pos, chunk->end_pos);
+    curl_chunk_delete(chunk);
+    return (-1L);
+  }
+  memcpy(rbuf, chunk->data, len);
+  curl_chunk_delete(chunk);
+  return (len);
+}
+
 /* nf_feof returns true after reading past the end of a file but before
    repositioning the pos in the file. */
 int nf_feof(Netfile *nf) { return ((nf->err == NF_EOF_ERR) ? 1 : 0); }
@@ -541,6 +598,7 @@ int www_perform_request(CURL *c) {
 }
 
 long www_get_cont_len(const char *url) {
+  std::lock_guard<std::mutex> lock(curl_mutex);
   double length;
 
   length = 0;
@@ -616,6 +674,7 @@ void curl_chunk_putb(Chunk *chunk, char *data, size_t len) {
 }
 
 Chunk *www_get_url_range_chunk(const char *url, long startb, long len) {
+  std::lock_guard<std::mutex> lock(curl_mutex);
   Chunk *chunk = NULL, *extra_chunk = NULL;
   char range_req_str[6 * sizeof(long) + 2];
   const char *url2 = NULL;
@@ -651,6 +710,9 @@ Chunk *www_get_url_range_chunk(const char *url, long startb, long len) {
       curl_chunk_delete(chunk);
       return (NULL);
     }
+    if (strncmp(url, "http", 4) ||
+        curl_easy_getinfo(curl_ua, CURLINFO_RESPONSE_CODE, &chunk->code))
+      chunk->code = 0;
     if (!chunk->data) {
       curl_chunk_delete(chunk);
       chunk = NULL;
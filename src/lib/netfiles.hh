@@ -29,6 +29,7 @@ struct Chunk {
   unsigned long start_pos;
   unsigned long end_pos;
   unsigned long total_size;
+  long code; /* HTTP response code (0 for other protocols) */
   char *data;
   char *url;
 };
@@ -81,6 +82,8 @@ void nf_delete(Netfile *nf);
 Netfile *nf_new(const char *url);
 // get a block of data from a netfile
 long nf_get_range(Netfile *nf, long startb, long len, char *rbuf);
+// get a block of data from a netfile without moving its position; thread-safe
+long nf_pread(Netfile *nf, long startb, long len, char *rbuf);
 // Emulates feof, for netfiles
 int nf_feof(Netfile *nf);
 // TRUE if Netfile pointer points to EOF
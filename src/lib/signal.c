@@ -42,10 +42,94 @@ visible outside of this file:
  isigclose	(closes input signals)
  osigclose	(closes output signals)
  isgsetframe	(skips to a specified frame number in a specified signal group)
+ rsamp		(reads a sample of a given format from a full input buffer)
+ isgframe	(decodes a frame of a signal group of a given layout)
+ isgpick	(finds the isgframe version for a signal group)
+ isgselect	(chooses a frame decoder for each input signal group)
  getskewedframe	(reads an input frame, without skew correction)
+ isgunit	(determines the size of a byte-aligned run of frames in a group)
+ isgframes	(counts the frames that can be decoded from a group's buffer)
+ unpack212	(decodes a run of format 212 samples)
+ unpack310	(decodes a run of format 310 samples)
+ unpack311	(decodes a run of format 311 samples)
+ isgunpack	(decodes a run of buffered samples from a signal group)
+ isgdecode	(decodes buffered frames of a signal group into a frame array)
+ fastframes	(reads buffered frames from all input signal groups)
+ isgraw		(reads an undecoded sample from a signal group)
+ isgrange	(reads a range of frames of selected signals in a signal group)
  meansamp       (calculates mean of an array of samples)
  rgetvec        (reads a sample from each input signal without resampling)
  openosig       (opens output signals)
+ physk		(converts a block of ADC units to physical units)
+ aduk		(converts a block of physical units to ADC units)
+ calpattern	(fills in gain and baseline tables for physk and aduk)
+ sbfree		(releases blocks cached by sample())
+ hgets		(reads a line of a header file or a copy of it)
+ segtextfree	(releases copies of segment headers)
+ segfind	(finds the segment containing a given sample)
+ rsreset	(empties the resampling filter's input history)
+ rsinit		(computes the resampling filter)
+ rspush		(appends input samples to the resampling filter's history)
+ rsdot		(computes the resampling filter's inner product)
+ rsgetvec	(reads a resampled sample from each signal)
+ hsave		(keeps the copy of a header made by readheader)
+ hcstamp	(gets the status of a header file for the header cache)
+ hcachekey	(finds the key for a header in the header cache)
+ hcwrite	(appends an entry to the header cache file)
+ hcacheset	(enables or disables the header cache)
+ hcacheget	(gets a copy of a header from the header cache)
+ hcacheput	(adds a copy of a header to the header cache)
+ oinvalid	(gets the value written in place of an invalid sample)
+ owrite		(writes a sample to an output signal group)
+ opack		(writes a block of samples to an output signal group)
+ owmain		(writes output buffers queued by oblock)
+ oblock		(writes a full output buffer)
+ owait		(waits until all queued output buffers have been written)
+ owstop		(stops the asynchronous output thread)
+ oerror		(checks for output errors)
+ irmain		(reads ahead in an input signal file)
+ iblock		(refills an input buffer)
+ irstart	(starts reading ahead in an input signal file)
+ irpause	(stops reading ahead before a seek)
+ irstop		(stops reading ahead and releases the read-ahead buffers)
+ isgconvert	(converts unpacked frames of a signal group into samples)
+ pworker	(does the jobs given to a decoding thread)
+ prun		(divides a job among the decoding threads)
+ preport	(reports the errors collected during a job)
+ pdgroup	(decodes the frames of one signal group for pdecode)
+ pdmerge	(assembles a run of frames for pdecode)
+ pdecode	(decodes buffered frames of all input signal groups in parallel)
+ prchunk	(decodes a chunk of a range of frames for isgprange)
+ prfix		(completes a chunk of a range of frames for isgprange)
+ isgprange	(reads a range of frames of a signal group in parallel)
+ czload		(gets a little-endian number from a compressed signal file)
+ czstore	(sets a little-endian number for a compressed signal file)
+ czencode	(compresses a block of frames)
+ czdecode	(decompresses a block of frames)
+ czopen		(reads the index of a compressed input signal file)
+ czblock	(decodes the next block of a compressed input signal file)
+ czseek		(skips to a specified frame in a compressed input signal file)
+ czwrite	(compresses and writes a block of frames)
+ czput		(collects samples to be written to a compressed signal file)
+ czclose	(writes the last block and index of a compressed signal file)
+ isggather	(decodes selected samples of buffered frames of a signal group)
+ isgcols	(lists the samples of a signal group that have been requested)
+ tsamp		(converts a sample to a 16-bit integer or a float)
+ typedframes	(reads frames or vectors as 16-bit integers or floats)
+ isconvert	(converts unpacked frames of a signal into samples)
+ iscount	(accounts for frames of a signal that have been read)
+ isgdeskew	(decodes buffered frames of a signal group into place for dsframes)
+ dsframes	(reads blocks of frames of a record with skewed signals)
+ lowresframes	(averages frames into sample vectors for getvecs)
+ sfmain		(reads the header and opens the files of the next segment)
+ sfstop		(discards a segment prefetch)
+ sfstart	(starts prefetching the next segment)
+ sftake		(uses the header read by a segment prefetch)
+ sfopen		(uses a signal file opened by a segment prefetch)
+ smsamp		(converts a sample of a variable-layout segment)
+ smplan		(finds runs of signals that sigmap can map in bulk)
+ smapply	(maps frames of a variable-layout segment into the layout)
+ smframes	(reads blocks of frames of a variable-layout record)
 
 This file also contains low-level I/O routines for signals in various formats;
 typically, the input routine for format N signals is named rN(), and the output
@@ -62,13 +146,26 @@ This file also contains definitions of the following WFDB library functions:
  getgvmode [10.5.3](returns getvec operating mode)
  setifreq [10.2.6](sets the getvec sampling frequency)
  getifreq [10.2.6](returns the getvec sampling frequency)
+ setifreqmode [20.0](selects the getvec resampling method)
  getvec		(reads a (possibly resampled) sample from each input signal)
  getframe [9.0]	(reads an input frame)
+ getframes [20.0](reads a block of input frames)
+ getvecs [20.0]	(reads a block of (possibly resampled) samples from each signal)
+ getsignals [20.0](reads a range of samples of selected signals, by signal)
+ getstreams [20.0](reads frames of all signals, by signal, at their own rates)
+ getsigview [20.0](gets a view of a range of undecoded format 16 frames)
  putvec		(writes a sample to each output signal)
+ putvecs [20.0]	(writes a block of frames to the output signals)
  isigsettime	(skips to a specified time in each signal)
  isgsettime	(skips to a specified time in a specified signal group)
  tnextvec [10.4.13] (skips to next valid sample of a specified signal)
  setibsize [5.0](sets the default buffer size for getvec)
+ setimmap [20.0](enables or disables memory-mapped input)
+ setoasync [20.0](enables or disables asynchronous output)
+ setiprefetch [20.0](enables or disables read-ahead for input signals)
+ setsegprefetch [20.0](enables or disables prefetching of record segments)
+ setithreads [20.0](sets the number of threads used to decode input signals)
+ sethcache [20.0](enables or disables the header cache)
  setobsize [5.0](sets the default buffer size for putvec)
  newheader	(creates a new header file)
  setheader [5.0](creates or rewrites a header file given signal specifications)
@@ -98,8 +195,27 @@ This file also contains definitions of the following WFDB library functions:
  muvadu		(converts microvolts to ADC units)
  aduphys [6.0]	(converts ADC units to physical units)
  physadu [6.0]	(converts physical units to ADC units)
+ aduphysv [20.0](converts a block of ADC units to physical units)
+ aduphysvf [20.0](converts a block of ADC units to physical units, as floats)
+ physaduv [20.0](converts a block of physical units to ADC units)
+ physaduvf [20.0](converts a block of physical units (floats) to ADC units)
+ getphysframes [20.0](reads a block of frames in physical units)
+ getphysframesf [20.0](reads a block of frames in physical units, as floats)
+ getframes16 [20.0](reads a block of frames as 16-bit integers)
+ getframesf [20.0](reads a block of frames as floats)
+ getvecs16 [20.0](reads a block of sample vectors as 16-bit integers)
+ getvecsf [20.0](reads a block of sample vectors as floats)
  sample [10.3.0](get a sample from a given signal at a given time)
  sample_valid [10.3.0](verify that last value returned by sample was valid)
+ setsampcache [20.0](sets the number of blocks cached by sample)
+ getsampcache [20.0](gets sample cache statistics)
+ wfdbnewrecord [20.0](creates a record handle)
+ wfdbfreerecord [20.0](closes and frees a record handle)
+ wfdbsetrecord [20.0](selects the calling thread's current record handle)
+ isigopen_r [20.0](isigopen for a specified record handle)
+ getvec_r [20.0](getvec for a specified record handle)
+ isigsettime_r [20.0](isigsettime for a specified record handle)
+ sample_r [20.0](sample for a specified record handle)
 
 (Numbers in brackets in the list above indicate the first version of the WFDB
 library that included the corresponding function.  Functions not so marked
@@ -119,6 +235,12 @@ attempting to compile r16() and w16().  To avoid this problem, define the
 symbol BROKEN_CC when compiling this module, in order to obtain the alternate
 versions, which are implemented as functions.
 
+The block decoders for bit-packed formats (unpack212, etc.) use SSE2 or AVX2
+instructions if the compiler targets a processor that supports them (for
+example, with gcc, if this module is compiled with -mavx2 or -march=native).
+To obtain the portable versions only, define the symbol NOSIMD when compiling
+this module.
+
 The function setbasetime() uses the C library functions localtime() and time(),
 and definitions from <time.h>.  If these are not available, either find a
 replacement or define the symbol NOTIME when compiling this module;  taking the
@@ -177,171 +299,505 @@ void example(void)
 
 #include <errno.h>
 #include <limits.h>
+#include <math.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <new>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#if !defined(NOSIMD) && (defined(__AVX2__) || defined(__SSE2__))
+#include <immintrin.h>
+#endif
 
+#include "annot.hh"
 #include "wfdbio.hh"
 
 #ifndef NOTIME
 #include <time.h>
 #endif
 
-/* Shared local data */
+/* Shared local data
 
-/* These variables are set by readheader, and contain information about the
-   signals described in the most recently opened header file.
-*/
-static unsigned maxhsig;   /* # of hsdata structures pointed to by hsd */
-static WFDB_FILE *hheader; /* file pointer for header file */
-static struct hsdata {
+   All of the state associated with the records that are currently open
+   (header, input signal, output signal, and info string data) belongs to a
+   WfdbRecord object.  The functions in this file operate on the calling
+   thread's current record, which is the default record unless another has
+   been selected using wfdbsetrecord.  The fields of the current record are
+   referred to below by their historical names (hsd, isd, nisig, ...), which
+   are defined as macros following the definition of WfdbRecord. */
+
+/* Data about the signals described in the most recently opened header file. */
+struct hsdata {
   WFDB_Siginfo info; /* info about signal from header */
   long start;        /* signal file byte offset to sample 0 */
   int skew;          /* intersignal skew (in frames) */
-} * *hsd;
-
-/* Variables in this group are also set by readheader, but may be reset (by,
-   e.g., setsampfreq, setbasetime, ...).  These are used by strtim, timstr,
-   etc., for converting among sample intervals, counter values, elapsed times,
-   and absolute times and dates; they are recorded when writing header files
-   using newheader, setheader, and setmsheader.  Changing these variables has
-   no effect on the data read by getframe (or getvec) or on the data written by
-   putvec (although changes will affect what is written to output header files
-   by setheader, etc.).  An application such as xform can use independent
-   sampling frequencies and different base times or dates for input and output
-   signals, but only one set of these parameters is available at any given time
-   for use by the strtim, timstr, etc., conversion functions.
-*/
-static WFDB_Frequency ffreq; /* frame rate (frames/second) */
-static WFDB_Frequency ifreq; /* samples/second/signal returned by getvec */
-static WFDB_Frequency sfreq; /* samples/second/signal read by getvec */
-static WFDB_Frequency cfreq; /* counter frequency (ticks/second) */
-static int spfmax;           /* max number of samples per frame */
-static long btime;           /* base time (milliseconds since midnight) */
-static WFDB_Date bdate;      /* base date (Julian date) */
-static WFDB_Time nsamples;   /* duration of signals (in samples) */
-static double bcount;        /* base count (counter value at sample 0) */
-static long prolog_bytes;    /* length of prolog, as told to wfdbsetstart
-                                (used only by setheader, if output signal
-                                file(s) are not open) */
-
-/* The next set of variables contains information about multi-segment records.
-   The first two of them ('segments' and 'in_msrec') are used primarily as
-   flags to indicate if a record contains multiple segments.  Unless 'in_msrec'
-   is set already, readheader sets 'segments' to the number of segments
-   indicated in the header file it has most recently read (0 for a
-   single-segment record).  If it reads a header file for a multi-segment
-   record, readheader also sets the variables 'msbtime', 'msbdate', and
-   'msnsamples'; allocates and fills 'segarray'; and sets 'segp' and 'segend'.
-   Note that readheader's actions are not restricted to records opened for
-   input.
-
-   If isigopen finds that 'segments' is non-zero, it sets 'in_msrec' and then
-   invokes readheader again to obtain signal information from the header file
-   for the first segment, which must be a single-segment record (readheader
-   refuses to open a header file for a multi-segment record if 'in_msrec' is
-   set).
-
-   When creating a header file for a multi-segment record using setmsheader,
-   the variables 'msbtime', 'msbdate', and 'msnsamples' are filled in by
-   setmsheader based on btime and bdate for the first segment, and on the
-   sum of the 'nsamp' fields for all segments.  */
-static int segments;         /* number of segments found by readheader() */
-static int in_msrec;         /* current input record is: 0: a single-segment
-                                record; 1: a multi-segment record */
-static long msbtime;         /* base time for multi-segment record */
-static WFDB_Date msbdate;    /* base date for multi-segment record */
-static WFDB_Time msnsamples; /* duration of multi-segment record */
-static WFDB_Seginfo *segarray, *segp, *segend;
-/* beginning, current segment, end pointers */
-static struct WFDB_seginfo_L *segarray_L;
-
-/* These variables relate to open input signals. */
-static unsigned maxisig;   /* max number of input signals */
-static unsigned maxigroup; /* max number of input signal groups */
-static unsigned nisig;     /* number of open input signals */
-static unsigned nigroup;   /* number of open input signal groups */
-static unsigned ispfmax;   /* max number of samples of any open signal
-                              per input frame */
-static struct isdata {     /* unique for each input signal */
-  WFDB_Siginfo info;       /* input signal information */
-  WFDB_Sample samp;        /* most recent sample read */
-  int skew;                /* intersignal skew (in frames) */
-  int gvindex;             /* current high-resolution sample number */
-  int gvcount;             /* counter for updating gvindex */
-} * *isd;
-static struct igdata { /* shared by all signals in a group (file) */
-  int data;            /* raw data read by r*() */
-  int datb;            /* more raw data used for bit-packed formats */
-  WFDB_FILE *fp;       /* file pointer for an input signal group */
-  long start;          /* signal file byte offset to sample 0 */
-  int bsize;           /* if non-zero, all reads from the input file
-                          are in multiples of bsize bytes */
-  char *buf;           /* pointer to input buffer */
-  char *bp;            /* pointer to next location in buf[] */
-  char *be;            /* pointer to input buffer endpoint */
-  char count;          /* input counter for bit-packed signal */
-  char seek;           /* 0: do not seek on file, 1: seeks permitted */
-  int stat;            /* signal file status flag */
-} * *igd;
-static WFDB_Sample *tvector; /* getvec workspace */
-static WFDB_Sample *uvector; /* isgsettime workspace */
-static WFDB_Sample *vvector; /* tnextvec workspace */
-static int tuvlen;           /* lengths of tvector and uvector in samples */
-static WFDB_Time istime;     /* time of next input sample */
-static int ibsize;           /* default input buffer size */
-static unsigned skewmax;     /* max skew (frames) between any 2 signals */
-static WFDB_Sample *dsbuf;   /* deskewing buffer */
-static int dsbi;             /* index to oldest sample in dsbuf (if < 0,
-                                dsbuf does not contain valid data) */
-static unsigned dsblen;      /* capacity of dsbuf, in samples */
-static unsigned framelen;    /* total number of samples per frame */
-static int gvmode = DEFWFDBGVMODE; /* getvec mode */
-static int gvc;                    /* getvec sample-within-frame counter */
-static int isedf;                /* if non-zero, record is stored as EDF/EDF+ */
-static WFDB_Sample *sbuf = NULL; /* buffer used by sample() */
-static int sample_vflag;         /* if non-zero, last value returned by sample()
-                                    was valid */
-
-/* These variables relate to output signals. */
-static unsigned maxosig;   /* max number of output signals */
-static unsigned maxogroup; /* max number of output signal groups */
-static unsigned nosig;     /* number of open output signals */
-static unsigned nogroup;   /* number of open output signal groups */
-static WFDB_FILE *oheader; /* file pointer for output header file */
-static WFDB_FILE *outinfo; /* file pointer for output info file */
-static struct osdata {     /* unique for each output signal */
-  WFDB_Siginfo info;       /* output signal information */
-  WFDB_Sample samp;        /* most recent sample written */
-  int skew;                /* skew to be written by setheader() */
-} * *osd;
-static struct ogdata { /* shared by all signals in a group (file) */
-  int data;            /* raw data to be written by w*() */
-  int datb;            /* more raw data used for bit-packed formats */
-  WFDB_FILE *fp;       /* file pointer for output signal */
-  long start;          /* byte offset to be written by setheader() */
-  int bsize;           /* if non-zero, all writes to the output file
-                          are in multiples of bsize bytes */
-  char *buf;           /* pointer to output buffer */
-  char *bp;            /* pointer to next location in buf[]; */
-  char *be;            /* pointer to output buffer endpoint */
-  char count;          /* output counter for bit-packed signal */
-  signed char seek;    /* 1: seek works, -1: seek doesn't work,
-                          0: unknown */
-  char force_flush;    /* flush even if seek doesn't work */
-  char nrewind;        /* number of bytes to seek backwards
-                          after flushing */
-} * *ogd;
-static WFDB_Time ostime; /* time of next output sample */
-static int obsize;       /* default output buffer size */
-
-/* These variables relate to info strings. */
-static char **pinfo; /* array of info string pointers */
-static int nimax;    /* number of info string pointers allocated */
-static int ninfo;    /* number of info strings read */
+};
+
+/* Data about open input signals. */
+struct isdata {         /* unique for each input signal */
+  WFDB_Siginfo info;    /* input signal information */
+  WFDB_Sample samp;     /* most recent sample read */
+  int skew;             /* intersignal skew (in frames) */
+  int gvindex;          /* current high-resolution sample number */
+  int gvcount;          /* counter for updating gvindex */
+};
+struct igdata {         /* shared by all signals in a group (file) */
+  int data;             /* raw data read by r*() */
+  int datb;             /* more raw data used for bit-packed formats */
+  WFDB_FILE *fp;        /* file pointer for an input signal group */
+  long start;           /* signal file byte offset to sample 0 */
+  int bsize;            /* if non-zero, all reads from the input file
+                           are in multiples of bsize bytes */
+  char *buf;            /* pointer to input buffer */
+  int buflen;           /* allocated length of buf */
+  char *bp;             /* pointer to next location in buf[] */
+  char *be;             /* pointer to input buffer endpoint */
+  char count;           /* input counter for bit-packed signal */
+  char seek;            /* 0: do not seek on file, 1: seeks permitted */
+  int stat;             /* signal file status flag */
+  int fmt;              /* format of the signals in the group */
+  WFDB_Signal sig0;     /* first input signal in the group */
+  unsigned nsig;        /* number of input signals in the group */
+  unsigned spf;         /* total samples per frame for the group */
+  unsigned fpos;        /* index of the group's first sample in a frame */
+  unsigned ubytes;      /* length (in bytes) of the shortest byte-aligned
+                           run of frames (0 for null signals) */
+  unsigned uframes;     /* number of frames in such a run */
+  int (*decode)(struct igdata *ig, WFDB_Sample *vector);
+                        /* frame decoder for the group (see isgselect) */
+  unsigned fbytes;      /* most bytes that decode can consume per frame */
+  struct ireader *ir;   /* read-ahead thread (see iblock), or NULL */
+  int64_t rpos;         /* file offset of the next block to be read by iblock
+                           using wfdb_pread, or -1 if iblock reads from the
+                           current file position */
+  struct czdata *cz;    /* index of a compressed signal file, or NULL */
+};
+
+/* Data about open output signals. */
+struct osdata {         /* unique for each output signal */
+  WFDB_Siginfo info;    /* output signal information */
+  WFDB_Sample samp;     /* most recent sample written */
+  int skew;             /* skew to be written by setheader() */
+};
+#define IRMAXBUF 8      /* max buffers per input group (see setiprefetch) */
+#define OWMAXBUF 8      /* max buffers per output group (see setoasync) */
+#define IDMAXTHR 64     /* max input decoding threads (see setithreads) */
+#define CZFMT 1000      /* compressed format (see czopen) */
+struct ogdata {         /* shared by all signals in a group (file) */
+  int data;             /* raw data to be written by w*() */
+  int datb;             /* more raw data used for bit-packed formats */
+  WFDB_FILE *fp;        /* file pointer for output signal */
+  long start;           /* byte offset to be written by setheader() */
+  int bsize;            /* if non-zero, all writes to the output file
+                           are in multiples of bsize bytes */
+  char *buf;            /* pointer to output buffer */
+  char *bp;             /* pointer to next location in buf[]; */
+  char *be;             /* pointer to output buffer endpoint */
+  char count;           /* output counter for bit-packed signal */
+  signed char seek;     /* 1: seek works, -1: seek doesn't work,
+                           0: unknown */
+  char force_flush;     /* flush even if seek doesn't work */
+  char nrewind;         /* number of bytes to seek backwards
+                           after flushing */
+  int nobuf;            /* number of spare buffers (0 unless asynchronous) */
+  int nofree;           /* number of spare buffers not waiting in a queue */
+  char *ofree[OWMAXBUF]; /* spare buffers not waiting in a queue */
+  struct czdata *cz;    /* samples and index of a compressed signal file,
+                           or NULL */
+};
+
+/* Data used by sigmap (see "Code for handling variable-layout multi-segment
+   records", below). */
+struct sigmapinfo {
+  char *desc;
+  double gain, scale, offset;
+  WFDB_Sample sample_offset;
+  WFDB_Sample baseline;
+  int index;
+  int spf;
+};
+
+/* A run of samples in each frame to be mapped by smapply:  n samples
+   beginning with sample number out of the output frame are copied from the
+   input frame beginning with sample number in (SMCOPY), or are missing from
+   the current segment (SMFILL), or are each converted separately (SMSCALE). */
+struct smrun {
+  int op;  /* SMCOPY, SMFILL, or SMSCALE */
+  int out; /* first sample of the run in the output frame */
+  int in;  /* first sample of the run in the input frame (SMCOPY only) */
+  int n;   /* number of samples in the run */
+};
+
+#define SMCOPY 0
+#define SMFILL 1
+#define SMSCALE 2
+
+/* Data for a block of sample vectors cached by sample(). */
+struct sblock {
+  WFDB_Time t0;       /* time of the first vector in the block (< 0: unused) */
+  long n;             /* number of vectors in the block (fewer than SBLEN
+                         only if the block contains the end of the record) */
+  unsigned long used; /* value of sbclock when the block was last used */
+  WFDB_Sample *v;     /* the vectors themselves */
+};
+
+struct WfdbRecord {
+  /* These variables are set by readheader, and contain information about
+     the signals described in the most recently opened header file. */
+  unsigned maxhsig;   /* # of hsdata structures pointed to by hsd */
+  WFDB_FILE *hheader; /* file pointer for header file */
+  struct hsdata **hsd;
+
+  /* Variables in this group are also set by readheader, but may be reset
+     (by, e.g., setsampfreq, setbasetime, ...).  These are used by strtim,
+     timstr, etc., for converting among sample intervals, counter values,
+     elapsed times, and absolute times and dates; they are recorded when
+     writing header files using newheader, setheader, and setmsheader.
+     Changing these variables has no effect on the data read by getframe (or
+     getvec) or on the data written by putvec (although changes will affect
+     what is written to output header files by setheader, etc.).  An
+     application such as xform can use independent sampling frequencies and
+     different base times or dates for input and output signals, but only one
+     set of these parameters is available at any given time for use by the
+     strtim, timstr, etc., conversion functions. */
+  WFDB_Frequency ffreq; /* frame rate (frames/second) */
+  WFDB_Frequency ifreq; /* samples/second/signal returned by getvec */
+  WFDB_Frequency sfreq; /* samples/second/signal read by getvec */
+  WFDB_Frequency cfreq; /* counter frequency (ticks/second) */
+  int spfmax;           /* max number of samples per frame */
+  long btime;           /* base time (milliseconds since midnight) */
+  WFDB_Date bdate;      /* base date (Julian date) */
+  WFDB_Time nsamples;   /* duration of signals (in samples) */
+  double bcount;        /* base count (counter value at sample 0) */
+  long prolog_bytes;    /* length of prolog, as told to wfdbsetstart
+                           (used only by setheader, if output signal
+                           file(s) are not open) */
+
+  /* The next set of variables contains information about multi-segment
+     records.  The first two of them ('segments' and 'in_msrec') are used
+     primarily as flags to indicate if a record contains multiple segments.
+     Unless 'in_msrec' is set already, readheader sets 'segments' to the
+     number of segments indicated in the header file it has most recently
+     read (0 for a single-segment record).  If it reads a header file for a
+     multi-segment record, readheader also sets the variables 'msbtime',
+     'msbdate', and 'msnsamples'; allocates and fills 'segarray'; and sets
+     'segp' and 'segend'.  Note that readheader's actions are not restricted
+     to records opened for input.
+
+     If isigopen finds that 'segments' is non-zero, it sets 'in_msrec' and
+     then invokes readheader again to obtain signal information from the
+     header file for the first segment, which must be a single-segment record
+     (readheader refuses to open a header file for a multi-segment record if
+     'in_msrec' is set).
+
+     When creating a header file for a multi-segment record using
+     setmsheader, the variables 'msbtime', 'msbdate', and 'msnsamples' are
+     filled in by setmsheader based on btime and bdate for the first
+     segment, and on the sum of the 'nsamp' fields for all segments.  */
+  int segments;         /* number of segments found by readheader() */
+  int in_msrec;         /* current input record is: 0: a single-segment
+                           record; 1: a multi-segment record */
+  long msbtime;         /* base time for multi-segment record */
+  WFDB_Date msbdate;    /* base date for multi-segment record */
+  WFDB_Time msnsamples; /* duration of multi-segment record */
+  WFDB_Seginfo *segarray, *segp, *segend;
+  /* beginning, current segment, end pointers */
+  char **segtext;       /* copies of segment headers (see hgets) */
+  int nsegtext;         /* number of entries in segtext */
+  long segtextlen;      /* total length of segtext contents */
+  struct sfetch *segfetch; /* prefetch of the next segment (see sfstart) */
+  const char *htext;    /* next line of the header copy being read */
+  char *hcap;           /* header text read so far, to be copied */
+  long hcaplen;         /* length of hcap contents (< 0: not copying) */
+  long hcapsize;        /* allocated length of hcap */
+  struct WFDB_seginfo_L *segarray_L;
+
+  /* These variables relate to open input signals. */
+  unsigned maxisig;       /* max number of input signals */
+  unsigned maxigroup;     /* max number of input signal groups */
+  unsigned nisig;         /* number of open input signals */
+  unsigned nigroup;       /* number of open input signal groups */
+  unsigned ispfmax;       /* max number of samples of any open signal
+                             per input frame */
+  struct isdata **isd;
+  struct igdata **igd;
+  WFDB_Sample *tvector;   /* getvec workspace */
+  WFDB_Sample *uvector;   /* isgsettime workspace */
+  WFDB_Sample *vvector;   /* tnextvec workspace */
+  int tuvlen;             /* lengths of tvector and uvector in samples */
+  WFDB_Sample *blkbuf;    /* getframes workspace */
+  long blkbuflen;         /* length of blkbuf in samples */
+  WFDB_Sample *rngbuf;    /* getsignals workspace */
+  long rngbuflen;         /* length of rngbuf in samples */
+  WFDB_Sample *pdbuf;     /* pdecode workspace */
+  long pdbuflen;          /* length of pdbuf in samples */
+  int16_t *viewbuf;       /* getsigview workspace */
+  long viewbuflen;        /* length of viewbuf in samples */
+  WFDB_Sample *vecbuf;    /* getvecs workspace */
+  long vecbuflen;         /* length of vecbuf in samples */
+  WFDB_Time istime;       /* time of next input sample */
+  unsigned skewmax;       /* max skew (frames) between any 2 signals */
+  WFDB_Sample *dsbuf;     /* deskewing buffer */
+  int dsbi;               /* index to oldest sample in dsbuf (if < 0,
+                             dsbuf does not contain valid data) */
+  unsigned dsblen;        /* capacity of dsbuf, in samples */
+  unsigned framelen;      /* total number of samples per frame */
+  int gvmode = DEFWFDBGVMODE; /* getvec mode */
+  int gvc;                /* getvec sample-within-frame counter */
+  int rgvfstat;           /* value returned by the last getframe in rgetvec */
+  int isedf;              /* if non-zero, record is stored as EDF/EDF+ */
+  struct sblock *sbuf;   /* blocks cached by sample() */
+  int nsblock;            /* number of entries in sbuf */
+  unsigned long sbclock;  /* number of blocks used by sample() so far */
+  WFDB_Time sbtime;       /* time of the next vector getvec would read for
+                             sample() (< 0: unknown) */
+  WFDB_Time sbistime;     /* value of istime when sbtime was set */
+  long sbhits, sbmisses;  /* sample() cache statistics */
+  int sample_vflag;       /* if non-zero, last value returned by sample()
+                             was valid */
+
+  /* These variables are used by setifreq and getvec for resampling. */
+  long mticks, nticks, mnticks;
+  int rgvstat;
+  WFDB_Time rgvtime, gvtime;
+  WFDB_Sample *gv0, *gv1;
+
+  /* These variables are used by getvec for windowed-sinc resampling (see
+     "Polyphase resampling", below). */
+  int rsmode;             /* WFDB_RESAMPLE_LINEAR or WFDB_RESAMPLE_SINC */
+  int rstaps;             /* filter length, in input samples */
+  int rsnph;              /* number of filter phases */
+  double *rstab;          /* filter coefficients (rsnph * rstaps) */
+  double *rshist;         /* input history (2 * rstaps per signal) */
+  int rshi;               /* index of the oldest input in rshist */
+  long rsphase;           /* position of the next output between inputs,
+                             in units of 1/nticks input interval */
+  WFDB_Time rsbase;       /* input preceding the next output */
+  WFDB_Time rsn;          /* newest input in rshist (< rsbase - rstaps/2:
+                             rshist has not been filled) */
+  WFDB_Time rslast;       /* last input read successfully (-1: unknown) */
+
+  /* These variables are used by sigmap. */
+  int need_sigmap, maxvsig, nvsig, tspf, vspfmax;
+  struct isdata **vsd;
+  WFDB_Sample *ovec;
+  struct sigmapinfo *smi;
+  struct smrun *smruns; /* gather plan for the current segment (see smplan) */
+  int nsmruns;          /* number of entries in smruns */
+  WFDB_Sample *smbuf;   /* smframes workspace */
+  long smbuflen;        /* length of smbuf, in samples */
+
+  /* These variables relate to output signals. */
+  unsigned maxosig;     /* max number of output signals */
+  unsigned maxogroup;   /* max number of output signal groups */
+  unsigned nosig;       /* number of open output signals */
+  unsigned nogroup;     /* number of open output signal groups */
+  WFDB_FILE *oheader;   /* file pointer for output header file */
+  WFDB_FILE *outinfo;   /* file pointer for output info file */
+  struct osdata **osd;
+  struct ogdata **ogd;
+  WFDB_Time ostime;     /* time of next output sample */
+  WFDB_Sample *pvbuf;   /* putvecs workspace */
+  long pvbuflen;        /* length of pvbuf in samples */
+  struct owriter *owr;  /* asynchronous output thread (see oblock) */
+
+  /* These variables relate to info strings. */
+  char **pinfo; /* array of info string pointers */
+  int nimax;    /* number of info string pointers allocated */
+  int ninfo;    /* number of info strings read */
+  int pinfoi;   /* index of the next info string to be returned */
+
+  /* State of the annotation functions (see annot.c); NULL for the default
+     record, which uses annot.c's default state. */
+  struct WfdbAnnotState *ann;
+};
+
+static WfdbRecord default_record;
+static thread_local WfdbRecord *cur = &default_record;
+
+/* Each of the following names refers to the field of the same name in the
+   current record.  They are undefined at the end of this file. */
+#define maxhsig (cur->maxhsig)
+#define hheader (cur->hheader)
+#define hsd (cur->hsd)
+#define ffreq (cur->ffreq)
+#define ifreq (cur->ifreq)
+#define sfreq (cur->sfreq)
+#define cfreq (cur->cfreq)
+#define spfmax (cur->spfmax)
+#define btime (cur->btime)
+#define bdate (cur->bdate)
+#define nsamples (cur->nsamples)
+#define bcount (cur->bcount)
+#define prolog_bytes (cur->prolog_bytes)
+#define segments (cur->segments)
+#define in_msrec (cur->in_msrec)
+#define msbtime (cur->msbtime)
+#define msbdate (cur->msbdate)
+#define msnsamples (cur->msnsamples)
+#define segarray (cur->segarray)
+#define segp (cur->segp)
+#define segend (cur->segend)
+#define segtext (cur->segtext)
+#define nsegtext (cur->nsegtext)
+#define segtextlen (cur->segtextlen)
+#define segfetch (cur->segfetch)
+#define htext (cur->htext)
+#define hcap (cur->hcap)
+#define hcaplen (cur->hcaplen)
+#define hcapsize (cur->hcapsize)
+#define segarray_L (cur->segarray_L)
+#define maxisig (cur->maxisig)
+#define maxigroup (cur->maxigroup)
+#define nisig (cur->nisig)
+#define nigroup (cur->nigroup)
+#define ispfmax (cur->ispfmax)
+#define isd (cur->isd)
+#define igd (cur->igd)
+#define tvector (cur->tvector)
+#define uvector (cur->uvector)
+#define vvector (cur->vvector)
+#define tuvlen (cur->tuvlen)
+#define blkbuf (cur->blkbuf)
+#define blkbuflen (cur->blkbuflen)
+#define rngbuf (cur->rngbuf)
+#define rngbuflen (cur->rngbuflen)
+#define pdbuf (cur->pdbuf)
+#define pdbuflen (cur->pdbuflen)
+#define viewbuf (cur->viewbuf)
+#define viewbuflen (cur->viewbuflen)
+#define vecbuf (cur->vecbuf)
+#define vecbuflen (cur->vecbuflen)
+#define istime (cur->istime)
+#define skewmax (cur->skewmax)
+#define dsbuf (cur->dsbuf)
+#define dsbi (cur->dsbi)
+#define dsblen (cur->dsblen)
+#define framelen (cur->framelen)
+#define gvmode (cur->gvmode)
+#define gvc (cur->gvc)
+#define rgvfstat (cur->rgvfstat)
+#define isedf (cur->isedf)
+#define sbuf (cur->sbuf)
+#define nsblock (cur->nsblock)
+#define sbclock (cur->sbclock)
+#define sbtime (cur->sbtime)
+#define sbistime (cur->sbistime)
+#define sbhits (cur->sbhits)
+#define sbmisses (cur->sbmisses)
+#define sample_vflag (cur->sample_vflag)
+#define mticks (cur->mticks)
+#define nticks (cur->nticks)
+#define mnticks (cur->mnticks)
+#define rgvstat (cur->rgvstat)
+#define rgvtime (cur->rgvtime)
+#define gvtime (cur->gvtime)
+#define gv0 (cur->gv0)
+#define gv1 (cur->gv1)
+#define rsmode (cur->rsmode)
+#define rstaps (cur->rstaps)
+#define rsnph (cur->rsnph)
+#define rstab (cur->rstab)
+#define rshist (cur->rshist)
+#define rshi (cur->rshi)
+#define rsphase (cur->rsphase)
+#define rsbase (cur->rsbase)
+#define rsn (cur->rsn)
+#define rslast (cur->rslast)
+#define need_sigmap (cur->need_sigmap)
+#define maxvsig (cur->maxvsig)
+#define nvsig (cur->nvsig)
+#define tspf (cur->tspf)
+#define vspfmax (cur->vspfmax)
+#define vsd (cur->vsd)
+#define ovec (cur->ovec)
+#define smi (cur->smi)
+#define smruns (cur->smruns)
+#define nsmruns (cur->nsmruns)
+#define smbuf (cur->smbuf)
+#define smbuflen (cur->smbuflen)
+#define maxosig (cur->maxosig)
+#define maxogroup (cur->maxogroup)
+#define nosig (cur->nosig)
+#define nogroup (cur->nogroup)
+#define oheader (cur->oheader)
+#define outinfo (cur->outinfo)
+#define osd (cur->osd)
+#define ogd (cur->ogd)
+#define ostime (cur->ostime)
+#define pvbuf (cur->pvbuf)
+#define pvbuflen (cur->pvbuflen)
+#define owr (cur->owr)
+#define pinfo (cur->pinfo)
+#define nimax (cur->nimax)
+#define ninfo (cur->ninfo)
+#define pinfoi (cur->pinfoi)
+
+/* These settings apply to all records.  Since records may be opened and read
+   in several threads at once, they are atomic;  those that have not been made
+   by the application are given their defaults once only (see sdefaults). */
+static std::atomic<int> ibsize;     /* default input buffer size */
+static std::atomic<int> obsize;     /* default output buffer size */
+static std::atomic<int> immap{-1}; /* if non-zero, map local signal files into
+                                      memory (if < 0, not yet initialized) */
+static std::atomic<int> nsbmax{-1}; /* number of blocks to be cached by
+                                       sample() (if < 0, not yet
+                                       initialized) */
+static std::atomic<int> onbuf{-1}; /* number of buffers per output signal
+                                      group (if < 2, output is synchronous;
+                                      if < 0, not yet initialized) */
+static std::atomic<int> inbuf{-1}; /* number of buffers per input signal group
+                                      (if < 2, there is no read-ahead;  if < 0,
+                                      not yet initialized) */
+static std::atomic<int> ithreads{-1}; /* number of threads used by getframes to
+                                         decode input signal groups (if < 0,
+                                         not yet initialized) */
+static std::atomic<int> isegfetch{-1}; /* if non-zero, open the next segment of
+                                          a multi-segment record in advance
+                                          (if < 0, not yet initialized) */
+static std::once_flag sdefault_once; /* see sdefaults */
 
 /* Local functions (not accessible outside this file). */
 
 static char *ftimstr(WFDB_Time t, WFDB_Frequency f);
 static char *fmstimstr(WFDB_Time t, WFDB_Frequency f);
 static WFDB_Time fstrtim(const char *string, WFDB_Frequency f);
+static void sbfree(void);
+static char *hgets(char *buf, int size);
+static char *hfield(char *line, const char *sep, char **lp);
+static void segtextfree(void);
+static WFDB_Seginfo *segfind(WFDB_Time t);
+static void sfstop(void);
+static void smplan(void);
+static void hsave(const char *record, int seg, const std::string &path,
+                  const struct stat *st);
+struct hcentry;
+static void hcstamp(const struct stat *st, long long *stamp);
+static std::string hcachekey(const char *record);
+static void hcwrite(FILE *f, const std::string &key, const hcentry &e);
+static int hcacheset(const char *file);
+static long hcacheget(const char *record);
+static void hcacheput(const char *record, const std::string &path,
+                      const struct stat *st, const char *text, long n);
+static void rsinit(void);
+static void rsreset(void);
+static int rsgetvec(WFDB_Sample *vector);
+static int oblock(struct ogdata *g);
+static int iblock(struct igdata *g);
+static void irpause(struct igdata *ig);
+static void irstop(struct igdata *ig);
+static void owait(void);
+static void owstop(void);
+static void sdefaults(void);
+
+/* The characters that separate the fields of a header line (see hfield). */
+static const char hsep[] = " \t\n\r";
 
 /* Allocate workspace for up to n input signals. */
 static int allocisig(unsigned int n) {
@@ -453,24 +909,15 @@ static int copysi(WFDB_Siginfo *to, const WFDB_Siginfo *from) {
    number that follows indicates the length of the gap in sample intervals.
  */
 
-static int need_sigmap, maxvsig, nvsig, tspf, vspfmax;
-static struct isdata **vsd;
-static WFDB_Sample *ovec;
-
-static struct sigmapinfo {
-  char *desc;
-  double gain, scale, offset;
-  WFDB_Sample sample_offset;
-  WFDB_Sample baseline;
-  int index;
-  int spf;
-} * smi;
-
 static void sigmap_cleanup(void) {
   int i;
 
   need_sigmap = nvsig = tspf = vspfmax = 0;
   SFREE(ovec);
+  SFREE(smruns);
+  nsmruns = 0;
+  SFREE(smbuf);
+  smbuflen = 0;
   if (smi) {
     for (i = 0; i < tspf; i += smi[i].spf) SFREE(smi[i].desc);
     SFREE(smi);
@@ -557,8 +1004,10 @@ static int sigmap_init(int first_segment) {
     }
     ispfmax = vspfmax;
 
-    if (isd[0]->info.fmt == 0 && nisig == 1)
+    if (isd[0]->info.fmt == 0 && nisig == 1) {
+      smplan();
       return (0); /* the current segment is a null record */
+    }
 
     for (i = j = 0; i < nisig; j += isd[i++]->info.spf)
       for (s = 0; s < tspf; s += smi[s].spf)
@@ -630,6 +1079,7 @@ static int sigmap_init(int first_segment) {
                  segp->recname);
       return (-1);
     }
+    smplan();
   }
 
   else if (in_msrec && !first_segment && framelen == 0) {
@@ -661,45 +1111,97 @@ static int sigmap_init(int first_segment) {
   return (0);
 }
 
-static int sigmap(WFDB_Sample *vector, const WFDB_Sample *ivec) {
-  int i;
+/* smsamp converts input sample x as specified by smi[i]. */
+static inline WFDB_Sample smsamp(WFDB_Sample x, int i) {
   double v;
 
-  for (i = 0; i < tspf; i++) {
-    if (ivec[smi[i].index] == WFDB_INVALID_SAMPLE)
-      vector[i] = WFDB_INVALID_SAMPLE;
-    else {
-      /* Scale the input sample and round it to the nearest
-         integer.  Halfway cases are always rounded up (10.5 is
-         rounded to 11, but -10.5 is rounded to -10.)  Note that
-         smi[i].offset already includes an extra 0.5, so we
-         simply need to calculate the floor of v. */
-      v = ivec[smi[i].index] * smi[i].scale + smi[i].offset;
-      if (smi[i].sample_offset) {
-        /* Fast case: if we can guarantee that v is always
-           positive and the following calculation cannot
-           overflow, we can avoid additional floating-point
-           operations. */
-        vector[i] = (WFDB_Sample)v + smi[i].sample_offset;
-      } else {
-        /* Slow case: we need to check bounds and handle
-           negative values. */
-        if (v >= 0) {
-          if (v <= WFDB_SAMPLE_MAX)
-            vector[i] = (WFDB_Sample)v;
-          else
-            vector[i] = WFDB_SAMPLE_MAX;
-        } else {
-          if (v >= WFDB_SAMPLE_MIN) {
-            vector[i] = (WFDB_Sample)v;
-            if (vector[i] > v) vector[i]--;
-          } else {
-            vector[i] = WFDB_SAMPLE_MIN;
-          }
-        }
-      }
+  if (x == WFDB_INVALID_SAMPLE) return (WFDB_INVALID_SAMPLE);
+  /* Scale the input sample and round it to the nearest
+     integer.  Halfway cases are always rounded up (10.5 is
+     rounded to 11, but -10.5 is rounded to -10.)  Note that
+     smi[i].offset already includes an extra 0.5, so we
+     simply need to calculate the floor of v. */
+  v = x * smi[i].scale + smi[i].offset;
+  if (smi[i].sample_offset) {
+    /* Fast case: if we can guarantee that v is always
+       positive and the following calculation cannot
+       overflow, we can avoid additional floating-point
+       operations. */
+    return ((WFDB_Sample)v + smi[i].sample_offset);
+  }
+  /* Slow case: we need to check bounds and handle
+     negative values. */
+  if (v >= 0)
+    return (v <= WFDB_SAMPLE_MAX ? (WFDB_Sample)v : WFDB_SAMPLE_MAX);
+  if (v >= WFDB_SAMPLE_MIN) {
+    x = (WFDB_Sample)v;
+    if (x > v) x--;
+    return (x);
+  }
+  return (WFDB_SAMPLE_MIN);
+}
+
+/* smplan divides the frames of the current segment into runs of samples
+   that smapply can copy, fill, or convert together, after sigmap_init has
+   set up the input side of the map.  A sample that is converted with a scale
+   of 1 and no change of baseline is copied, and a sample of a signal that is
+   missing from the segment is filled with WFDB_INVALID_SAMPLE. */
+static void smplan(void) {
+  int i, j, op;
+
+  SREALLOC(smruns, tspf, sizeof(struct smrun));
+  for (i = nsmruns = 0; i < tspf; i += smruns[nsmruns++].n) {
+    for (j = i; j < tspf; j++) {
+      if (smi[j].scale == 0.0 && smi[j].offset == 0.0 &&
+          smi[j].sample_offset == WFDB_INVALID_SAMPLE)
+        op = SMFILL;
+      else if (smi[j].scale == 1.0 &&
+               smi[j].offset + smi[j].sample_offset == 0.5)
+        op = SMCOPY;
+      else
+        op = SMSCALE;
+      if (j == i)
+        smruns[nsmruns].op = op;
+      else if (op != smruns[nsmruns].op ||
+               (op == SMCOPY && smi[j].index != smi[i].index + j - i))
+        break;
     }
+    smruns[nsmruns].out = i;
+    smruns[nsmruns].in = smi[i].index;
+    smruns[nsmruns].n = j - i;
   }
+}
+
+/* smapply maps n input frames from ivec (successive frames of which are
+   framelen samples apart) into vector (in which they are tspf samples apart),
+   following the plan made by smplan. */
+static void smapply(WFDB_Sample *vector, const WFDB_Sample *ivec, long n) {
+  int i, r;
+  long f;
+  struct smrun *p;
+  WFDB_Sample *vp;
+
+  for (f = 0; f < n; f++, vector += tspf, ivec += framelen)
+    for (r = 0; r < nsmruns; r++) {
+      p = &smruns[r];
+      vp = vector + p->out;
+      switch (p->op) {
+        case SMCOPY:
+          memcpy(vp, ivec + p->in, p->n * sizeof(WFDB_Sample));
+          break;
+        case SMFILL:
+          for (i = 0; i < p->n; i++) vp[i] = WFDB_INVALID_SAMPLE;
+          break;
+        default:
+          for (i = 0; i < p->n; i++)
+            vp[i] = smsamp(ivec[smi[p->out + i].index], p->out + i);
+          break;
+      }
+    }
+}
+
+static int sigmap(WFDB_Sample *vector, const WFDB_Sample *ivec) {
+  smapply(vector, ivec, 1);
   return (tspf);
 }
 
@@ -870,19 +1372,26 @@ static int edfparse(WFDB_FILE *ifile) {
   return (nsig);
 }
 
+#define SEGTEXTMAX 16777216L /* maximum total length of segment header copies */
+
 static int readheader(const char *record) {
-  char linebuf[256], *p, *q;
+  char linebuf[256], *lp, *p, *q;
   WFDB_Frequency f;
   WFDB_Signal s;
   WFDB_Time ns;
   unsigned int i, nsig;
-  static char sep[] = " \t\n\r";
+  int hseg = -1;
+  long hlen = -2L;
+  std::string hpath;
+  struct stat hst;
 
   /* If another input header file was opened, close it. */
   if (hheader) {
     (void)wfdb_fclose(hheader);
     hheader = NULL;
   }
+  htext = NULL;
+  hcaplen = -1L;
 
   spfmax = 1;
   sfreq = ffreq;
@@ -906,7 +1415,25 @@ static int readheader(const char *record) {
      file name. */
   q = (char *)record + strlen(record) - 1;
   while (q > record && *q != '.' && *q != '/' && *q != ':' && *q != '\\') q--;
-  if (*q == '.') {
+
+  /* If this is a segment of a multi-segment record, and its header has been
+     read before, read the copy kept in memory.  Otherwise, if possible, save
+     a copy of the header as it is read.  Failing that, use the header cache
+     if it has a current copy (see sethcache). */
+  if (in_msrec && segp && strcmp(record, segp->recname) == 0 && *q != '.') {
+    i = segp - segarray;
+    if (i < nsegtext && segtext[i])
+      htext = segtext[i];
+    else if (segtextlen < SEGTEXTMAX)
+      hseg = i;
+  }
+  if (htext == NULL && *q != '.' && (hlen = hcacheget(record)) >= 0L) {
+    htext = hcap;
+    hcaplen = hlen;
+  }
+  if (htext)
+    ; /* nothing to open */
+  else if (*q == '.') {
     if ((hheader = wfdb_open(NULL, record, WFDB_READ)) == NULL) {
       wfdb_error("init: can't open %s\n", record);
       return (-1);
@@ -920,8 +1447,15 @@ static int readheader(const char *record) {
     return (-1);
   }
 
+  /* If the header cache is enabled, note which file is being read, so that
+     a copy of it can be added to the cache. */
+  else if (hlen == -1L && hheader->type == FileType::kLocal &&
+           (p = wfdbfile(NULL, NULL)) && stat(p, &hst) == 0)
+    hpath = p;
+  if (hcaplen < 0L && (hseg >= 0 || !hpath.empty())) hcaplen = 0L;
+
   /* Read the first line and check for a magic string. */
-  if (wfdb_fgets(linebuf, 256, hheader) == NULL) {
+  if (hgets(linebuf, 256) == NULL) {
     wfdb_error("init: record %s header is empty\n", record);
     return (-2);
   }
@@ -945,8 +1479,8 @@ static int readheader(const char *record) {
 
   /* Get the first token (the record name) from the first non-empty,
      non-comment line. */
-  while ((p = strtok(linebuf, sep)) == NULL || *p == '#') {
-    if (wfdb_fgets(linebuf, 256, hheader) == NULL) {
+  while ((p = hfield(linebuf, hsep, &lp)) == NULL || *p == '#') {
+    if (hgets(linebuf, 256) == NULL) {
       wfdb_error("init: can't find record name in record %s header\n", record);
       return (-2);
     }
@@ -970,7 +1504,7 @@ static int readheader(const char *record) {
      if not, the header file may have been renamed in error or its contents
      may be corrupted.  The requirement for a match is waived for remote
      files since the user may not be able to make any corrections to them. */
-  if (hheader->type == FileType::kLocal && hheader->fp != stdin &&
+  if (hheader && hheader->type == FileType::kLocal && hheader->fp != stdin &&
       strncmp(p, record, strlen(p)) != 0) {
     /* If there is a mismatch, check to see if the record argument includes
        a directory separator (whether valid or not for this OS);  if so,
@@ -992,7 +1526,7 @@ static int readheader(const char *record) {
      another token from the line which contains the record name.  (Old-style
      headers have only one token on the first line, but new-style headers
      have two or more.) */
-  if ((p = strtok((char *)NULL, sep)) == NULL) {
+  if ((p = hfield(NULL, hsep, &lp)) == NULL) {
     /* The file appears to be an old-style header file. */
     wfdb_error("init: obsolete format in record %s header\n", record);
     return (-2);
@@ -1003,7 +1537,7 @@ static int readheader(const char *record) {
   nsig = (unsigned)strtol(p, NULL, 10);
 
   /* Determine the frame rate, if present and not set already. */
-  if (p = strtok((char *)NULL, sep)) {
+  if (p = hfield(NULL, hsep, &lp)) {
     if ((f = (WFDB_Frequency)strtod(p, NULL)) <= (WFDB_Frequency)0.) {
       wfdb_error("init: sampling frequency in record %s header is incorrect\n",
                  record);
@@ -1039,7 +1573,7 @@ static int readheader(const char *record) {
 
   /* Determine the number of samples per signal, if present and not
      set already. */
-  if (p = strtok((char *)NULL, sep)) {
+  if (p = hfield(NULL, hsep, &lp)) {
     if ((ns = strtotime(p, NULL, 10)) < 0L) {
       wfdb_error("init: number of samples in record %s header is incorrect\n",
                  record);
@@ -1058,7 +1592,7 @@ static int readheader(const char *record) {
     ns = (WFDB_Time)0L;
 
   /* Determine the base time and date, if present and not set already. */
-  if ((p = strtok((char *)NULL, "\n\r")) != NULL && btime == 0L &&
+  if ((p = hfield(NULL, "\n\r", &lp)) != NULL && btime == 0L &&
       setbasetime(p) < 0)
     return (-2); /* error message will come from setbasetime */
 
@@ -1070,18 +1604,19 @@ static int readheader(const char *record) {
     /* Read the names and lengths of the segment records. */
     SALLOC(segarray, segments, sizeof(WFDB_Seginfo));
     SFREE(segarray_L);
+    segtextfree();
     segp = segarray;
     for (i = 0, ns = (WFDB_Time)0L; i < segments; i++, segp++) {
       /* Get next segment spec, skip empty lines and comments. */
       do {
-        if (wfdb_fgets(linebuf, 256, hheader) == NULL) {
+        if (hgets(linebuf, 256) == NULL) {
           wfdb_error("init: unexpected EOF in header file for record %s\n",
                      record);
           SFREE(segarray);
           segments = 0;
           return (-2);
         }
-      } while ((p = strtok(linebuf, sep)) == NULL || *p == '#');
+      } while ((p = hfield(linebuf, hsep, &lp)) == NULL || *p == '#');
       if (*p == '+') {
         wfdb_error("init: `%s' is not a valid segment name in record %s\n", p,
                    record);
@@ -1097,7 +1632,7 @@ static int readheader(const char *record) {
         return (-2);
       }
       (void)strcpy(segp->recname, p);
-      if ((p = strtok((char *)NULL, sep)) == NULL ||
+      if ((p = hfield(NULL, hsep, &lp)) == NULL ||
           (segp->nsamp = strtotime(p, NULL, 10)) < 0L) {
         wfdb_error(
             "init: length must be specified for segment %s in record %s\n",
@@ -1123,6 +1658,7 @@ static int readheader(const char *record) {
           "(%" WFDB_Pd_TIME ")\n",
           ns);
     }
+    if (hcaplen >= 0L) hsave(record, hseg, hpath, &hst);
     return (0);
   }
 
@@ -1148,12 +1684,12 @@ static int readheader(const char *record) {
     /* Get the first token (the signal file name) from the next
        non-empty, non-comment line. */
     do {
-      if (wfdb_fgets(linebuf, 256, hheader) == NULL) {
+      if (hgets(linebuf, 256) == NULL) {
         wfdb_error("init: unexpected EOF in header file for record %s\n",
                    record);
         return (-2);
       }
-    } while ((p = strtok(linebuf, sep)) == NULL || *p == '#');
+    } while ((p = hfield(linebuf, hsep, &lp)) == NULL || *p == '#');
 
     /* Determine the signal group number.  The group number for signal
        0 is zero.  For subsequent signals, if the file name does not
@@ -1175,7 +1711,7 @@ static int readheader(const char *record) {
     }
 
     /* Determine the signal format. */
-    if ((p = strtok((char *)NULL, sep)) == NULL ||
+    if ((p = hfield(NULL, hsep, &lp)) == NULL ||
         !isfmt(hs->info.fmt = strtol(p, NULL, 10))) {
       wfdb_error("init: illegal format for signal %d, record %s\n", s, record);
       return (-2);
@@ -1198,7 +1734,7 @@ static int readheader(const char *record) {
 
     /* Determine the gain in ADC units per physical unit.  This number
        may be zero or missing;  if so, the signal is uncalibrated. */
-    if (p = strtok((char *)NULL, sep))
+    if (p = hfield(NULL, hsep, &lp))
       hs->info.gain = (WFDB_Gain)strtod(p, NULL);
     else
       hs->info.gain = (WFDB_Gain)0.;
@@ -1225,7 +1761,7 @@ static int readheader(const char *record) {
     /* Determine the ADC resolution in bits.  If this number is
        missing and cannot be inferred from the format, the default
        value (from wfdb.h) is filled in. */
-    if (p = strtok((char *)NULL, sep))
+    if (p = hfield(NULL, hsep, &lp))
       i = (unsigned)strtol(p, NULL, 10);
     else
       switch (hs->info.fmt) {
@@ -1252,18 +1788,18 @@ static int readheader(const char *record) {
 
     /* Determine the ADC zero (assumed to be zero if missing). */
     hs->info.adczero =
-        (p = strtok((char *)NULL, sep)) ? strtol(p, NULL, 10) : 0;
+        (p = hfield(NULL, hsep, &lp)) ? strtol(p, NULL, 10) : 0;
 
     /* Set the baseline to adczero if no baseline field was found. */
     if (nobaseline) hs->info.baseline = hs->info.adczero;
 
     /* Determine the initial value (assumed to be equal to the ADC
        zero if missing). */
-    hs->info.initval = (p = strtok((char *)NULL, sep)) ? strtol(p, NULL, 10)
+    hs->info.initval = (p = hfield(NULL, hsep, &lp)) ? strtol(p, NULL, 10)
                                                        : hs->info.adczero;
 
     /* Determine the checksum (assumed to be zero if missing). */
-    if (p = strtok((char *)NULL, sep)) {
+    if (p = hfield(NULL, hsep, &lp)) {
       hs->info.cksum = strtol(p, NULL, 10);
       hs->info.nsamp = (ns > LONG_MAX ? 0 : ns);
     } else {
@@ -1272,7 +1808,7 @@ static int readheader(const char *record) {
     }
 
     /* Determine the block size (assumed to be zero if missing). */
-    hs->info.bsize = (p = strtok((char *)NULL, sep)) ? strtol(p, NULL, 10) : 0;
+    hs->info.bsize = (p = hfield(NULL, hsep, &lp)) ? strtol(p, NULL, 10) : 0;
 
     /* Check that formats and block sizes match for signals belonging
        to the same group. */
@@ -1286,15 +1822,290 @@ static int readheader(const char *record) {
     /* Get the signal description.  If missing, a description of
        the form "record xx, signal n" is filled in. */
     SALLOC(hs->info.desc, 1, WFDB_MAXDSL + 1);
-    if (p = strtok((char *)NULL, "\n\r"))
+    if (p = hfield(NULL, "\n\r", &lp))
       (void)strncpy(hs->info.desc, p, WFDB_MAXDSL);
     else
       (void)sprintf(hs->info.desc, "record %s, signal %d", record, s);
   }
+
+  /* Keep a copy of the header, if one was made. */
+  if (hcaplen >= 0L) hsave(record, hseg, hpath, &hst);
   setgvmode(gvmode); /* Reset sfreq if appropriate. */
   return (s);        /* return number of available signals */
 }
 
+/* hgets reads a line of up to size-1 characters of the header being read by
+   readheader into buf, as wfdb_fgets would, either from the header file
+   (hheader) or from a copy of it kept in memory (htext).  While a header file
+   is being read, the lines are also appended to hcap (if hcaplen >= 0), so
+   that the copy can be saved by hsave. */
+static char *hgets(char *buf, int size) {
+  char *p;
+  long n;
+
+  if (htext) {
+    if (*htext == '\0') return (NULL);
+    for (p = buf; p < buf + size - 1 && *htext;)
+      if ((*p++ = *htext++) == '\n') break;
+    *p = '\0';
+    return (buf);
+  }
+  if ((p = wfdb_fgets(buf, size, hheader)) && hcaplen >= 0L) {
+    n = strlen(buf);
+    if (hcaplen + n + 1 > hcapsize) {
+      hcapsize = 2 * (hcaplen + n + 1);
+      SREALLOC(hcap, hcapsize, 1);
+    }
+    memcpy(hcap + hcaplen, buf, n + 1);
+    hcaplen += n;
+  }
+  return (p);
+}
+
+/* hfield returns the next field of a header line, as strtok_r would:  the
+   first field of line, or (if line is NULL) the field that follows the one
+   returned last (as recorded in *lp).  The fields are separated by any of the
+   characters in sep (usually hsep), and the one returned is terminated by a
+   null in place of the separator that follows it.  readheader and sfmain split
+   header lines only in this way;  unlike strtok, hfield can be used by more
+   than one thread at once. */
+static char *hfield(char *line, const char *sep, char **lp) {
+  char *p = line ? line : *lp, *q;
+
+  p += strspn(p, sep);
+  if (*p == '\0') {
+    *lp = p;
+    return (NULL);
+  }
+  q = p + strcspn(p, sep);
+  if (*q) *q++ = '\0';
+  *lp = q;
+  return (p);
+}
+
+/* segtextfree releases the copies of segment headers made by readheader. */
+static void segtextfree(void) {
+  for (; nsegtext > 0; nsegtext--) SFREE(segtext[nsegtext - 1]);
+  SFREE(segtext);
+  segtextlen = 0L;
+}
+
+/* hsave keeps the copy of the header just read by readheader (in hcap), in
+   segtext if it is the header of segment seg (if seg >= 0), and in the header
+   cache if it was read from the file named by path (if path is not empty),
+   whose size and modification time are given by st. */
+static void hsave(const char *record, int seg, const std::string &path,
+                  const struct stat *st) {
+  if (seg >= 0) {
+    if (nsegtext < segments) {
+      SREALLOC(segtext, segments, sizeof(char *));
+      while (nsegtext < segments) segtext[nsegtext++] = NULL;
+    }
+    SALLOC(segtext[seg], hcaplen + 1, 1);
+    memcpy(segtext[seg], hcap, hcaplen + 1);
+    segtextlen += hcaplen;
+  }
+  if (!path.empty()) hcacheput(record, path, st, hcap, hcaplen);
+  hcaplen = -1L;
+}
+
+/* Header cache
+
+If it is enabled (see sethcache), readheader keeps a copy of each local header
+file that it reads in a table shared by all record handles.  Each copy is found
+using the record name and the WFDB path that was searched for the header, and
+it is used in place of the header file only if that file has not changed since
+the copy was made (that is, if it still has the same size, i-node number, and
+modification and status change times, to the nanosecond where the file system
+records them).  The copies may also be appended to a cache file, from which
+they are loaded when the cache is next enabled, so that a program that scans a
+database can skip searching for and reading most of its headers when it is run
+again.
+
+Since a copy is used without searching the WFDB path, a header file that is
+created for the same record, in a directory that precedes the copy's directory
+in the WFDB path, is not seen until the copy is invalidated (by a change to the
+file that it was made from), or until the cache file is removed. */
+
+struct hcentry {
+  std::string path;    /* name of the header file */
+  long long stamp[6];  /* its status when it was read (see hcstamp) */
+  std::string text;    /* its contents */
+};
+
+#define HCMAGIC "#wfdb-hcache 2\n" /* first line of a cache file */
+
+static std::mutex hcmutex; /* guards the other hc... variables */
+static std::unordered_map<std::string, hcentry> *hctable; /* NULL: disabled */
+static std::string hcfile; /* name of the cache file, if any */
+static int hcinit;         /* 0 until the cache has been enabled or disabled */
+
+/* hcstamp fills in stamp with the size, i-node number, and modification and
+   status change times (in seconds and nanoseconds) of a file, from st. */
+static void hcstamp(const struct stat *st, long long *stamp) {
+  stamp[0] = st->st_size;
+  stamp[1] = st->st_ino;
+#ifdef __APPLE__
+  stamp[2] = st->st_mtimespec.tv_sec;
+  stamp[3] = st->st_mtimespec.tv_nsec;
+  stamp[4] = st->st_ctimespec.tv_sec;
+  stamp[5] = st->st_ctimespec.tv_nsec;
+#else
+  stamp[2] = st->st_mtim.tv_sec;
+  stamp[3] = st->st_mtim.tv_nsec;
+  stamp[4] = st->st_ctim.tv_sec;
+  stamp[5] = st->st_ctim.tv_nsec;
+#endif
+}
+
+/* hcachekey returns the key for the header of record in the header cache, or
+   an empty string if the header should not be cached (because it is read from
+   the standard input, or because the WFDB path depends on the record name). */
+static std::string hcachekey(const char *record) {
+  const std::string &path = getwfdb();
+
+  if (strcmp(record, "-") == 0 || path.find('%') != std::string::npos)
+    return (std::string());
+  return (std::string(record) + '\n' + path);
+}
+
+/* hcwrite appends the entry (e) for key to the cache file f. */
+static void hcwrite(FILE *f, const std::string &key, const hcentry &e) {
+  fprintf(f, "%zu %zu %lld %lld %lld %lld %lld %lld %zu\n", key.size(),
+          e.path.size(), e.stamp[0], e.stamp[1], e.stamp[2], e.stamp[3],
+          e.stamp[4], e.stamp[5], e.text.size());
+  fwrite(key.data(), 1, key.size(), f);
+  fwrite(e.path.data(), 1, e.path.size(), f);
+  fwrite(e.text.data(), 1, e.text.size(), f);
+}
+
+/* hcacheset enables the header cache, using the named cache file if file is
+   not empty, or disables it if file is NULL.  Since hcacheput only appends to
+   the cache file, a file that holds copies that have been replaced by later
+   ones (or that was left incomplete, or written by an earlier version of this
+   function) is rewritten with only the current copies when it is loaded.  The
+   caller must hold hcmutex. */
+static int hcacheset(const char *file) {
+  FILE *f;
+  char line[sizeof(HCMAGIC)];
+  size_t kl, pl, tl;
+  long long *st;
+  long ne = 0L;
+  int compact = 0, status = 0;
+
+  hcinit = 1;
+  delete hctable;
+  hctable = NULL;
+  hcfile.clear();
+  if (file == NULL) return (0);
+  hctable = new (std::nothrow) std::unordered_map<std::string, hcentry>;
+  if (hctable == NULL) {
+    wfdb_error("sethcache: insufficient memory\n");
+    return (-1);
+  }
+  if (*file == '\0') return (0);
+  hcfile = file;
+  if ((f = fopen(file, "rb")) == NULL)
+    return (0); /* if the file does not exist yet, it is created later */
+  line[0] = '\0';
+  if (fgets(line, sizeof(line), f) && strcmp(line, HCMAGIC) == 0) {
+    for (;;) {
+      std::string key;
+      hcentry e;
+
+      st = e.stamp;
+      if (fscanf(f, "%zu %zu %lld %lld %lld %lld %lld %lld %zu", &kl, &pl,
+                 &st[0], &st[1], &st[2], &st[3], &st[4], &st[5], &tl) != 9 ||
+          getc(f) != '\n' || tl > SEGTEXTMAX) {
+        compact |= !feof(f); /* drop anything that could not be read */
+        break;
+      }
+      key.resize(kl);
+      e.path.resize(pl);
+      e.text.resize(tl);
+      if (fread(&key[0], 1, kl, f) != kl || fread(&e.path[0], 1, pl, f) != pl ||
+          fread(&e.text[0], 1, tl, f) != tl) {
+        compact = 1;
+        break;
+      }
+      (*hctable)[key] = std::move(e); /* later copies replace earlier ones */
+      ne++;
+    }
+  } else if (strncmp(line, HCMAGIC, 13) == 0) /* written by an old version */
+    compact = 1;
+  else if (ftell(f) > 0L) { /* not empty, and not a cache file */
+    wfdb_error("sethcache: %s is not a header cache file\n", file);
+    hcfile.clear();
+    status = -1;
+  }
+  fclose(f);
+
+  /* Rewrite the cache file if necessary.  The new file replaces the old one
+     only when it is complete, so that another program reading the cache file
+     at the same time sees one or the other. */
+  if (compact || ne > (long)hctable->size()) {
+    std::string tmp = hcfile + ".tmp";
+
+    if ((f = fopen(tmp.c_str(), "wb"))) {
+      fputs(HCMAGIC, f);
+      for (const auto &e : *hctable) hcwrite(f, e.first, e.second);
+      if (fclose(f) != 0 || rename(tmp.c_str(), hcfile.c_str()) != 0)
+        remove(tmp.c_str());
+    }
+  }
+  return (status);
+}
+
+/* hcacheget copies the cached text of the header of record into hcap and
+   returns its length, if the cache has a current copy of it.  Otherwise, it
+   returns -1 if a copy should be added to the cache (by hsave), or -2 if
+   not. */
+static long hcacheget(const char *record) {
+  std::string key = hcachekey(record);
+  std::lock_guard<std::mutex> lock(hcmutex);
+  struct stat st;
+  long long stamp[6];
+  long n;
+
+  if (!hcinit) (void)hcacheset(getenv("WFDBHCACHE"));
+  if (hctable == NULL || key.empty()) return (-2L);
+  auto e = hctable->find(key);
+  if (e == hctable->end() || stat(e->second.path.c_str(), &st) != 0)
+    return (-1L);
+  hcstamp(&st, stamp);
+  if (memcmp(stamp, e->second.stamp, sizeof(stamp)) != 0) return (-1L);
+  n = e->second.text.size();
+  if (n + 1 > hcapsize) {
+    hcapsize = n + 1;
+    SREALLOC(hcap, hcapsize, 1);
+  }
+  memcpy(hcap, e->second.text.c_str(), n + 1);
+  return (n);
+}
+
+/* hcacheput adds a copy (text, of length n) of the header of record, read from
+   the file named by path, to the header cache, and appends it to the cache
+   file if there is one. */
+static void hcacheput(const char *record, const std::string &path,
+                      const struct stat *st, const char *text, long n) {
+  std::string key = hcachekey(record);
+  std::lock_guard<std::mutex> lock(hcmutex);
+  hcentry e;
+  FILE *f;
+
+  if (hctable == NULL || key.empty()) return;
+  e.path = path;
+  hcstamp(st, e.stamp);
+  e.text.assign(text, n);
+  if (!hcfile.empty() && (f = fopen(hcfile.c_str(), "ab"))) {
+    fseek(f, 0L, SEEK_END);
+    if (ftell(f) == 0L) fputs(HCMAGIC, f);
+    hcwrite(f, key, e);
+    fclose(f);
+  }
+  (*hctable)[key] = std::move(e);
+}
+
 static void hsdfree(void) {
   struct hsdata *hs;
 
@@ -1312,36 +2123,72 @@ static void hsdfree(void) {
 }
 
 static void isigclose(void) {
+  char *buf;
+  int buflen;
+  unsigned i;
   struct isdata *is;
   struct igdata *ig;
 
-  if (sbuf && !in_msrec) {
-    SFREE(sbuf);
-    sample_vflag = 0;
-  }
-  if (isd) {
-    while (maxisig)
-      if (is = isd[--maxisig]) {
+  if (sbuf && !in_msrec) sbfree();
+  if (!in_msrec) sfstop();
+
+  /* When isigopen switches from one segment of a multi-segment record to
+     another, the input signal and group structures are cleared but not
+     freed, and the groups' input buffers are kept, for reuse by isigopen.
+     Nothing else carries over to the next segment:  isigopen fills in the
+     structures from that segment's header, allocates more of them if it has
+     more signals or groups, and replaces any buffer that is too small, and
+     sigmap_init rejects a segment whose layout does not match the record's
+     (see isigopen and sigmap_init). */
+  if (in_msrec) {
+    for (i = 0; i < maxisig; i++)
+      if (is = isd[i]) {
         SFREE(is->info.fname);
         SFREE(is->info.units);
         SFREE(is->info.desc);
-        SFREE(is);
+        memset(is, 0, sizeof(struct isdata));
       }
-    SFREE(isd);
-  }
-  maxisig = nisig = 0;
-  framelen = 0;
-
-  if (igd) {
-    while (maxigroup)
-      if (ig = igd[--maxigroup]) {
+    for (i = 0; i < maxigroup; i++)
+      if (ig = igd[i]) {
+        irstop(ig);
+        delete ig->cz;
         if (ig->fp) (void)wfdb_fclose(ig->fp);
-        SFREE(ig->buf);
-        SFREE(ig);
+        buf = ig->buf;
+        buflen = ig->buflen;
+        memset(ig, 0, sizeof(struct igdata));
+        ig->buf = buf;
+        ig->buflen = buflen;
       }
-    SFREE(igd);
+  } else {
+    if (isd) {
+      while (maxisig)
+        if (is = isd[--maxisig]) {
+          SFREE(is->info.fname);
+          SFREE(is->info.units);
+          SFREE(is->info.desc);
+          SFREE(is);
+        }
+      SFREE(isd);
+    }
+    if (igd) {
+      while (maxigroup)
+        if (ig = igd[--maxigroup]) {
+          irstop(ig);
+          delete ig->cz;
+          if (ig->fp) (void)wfdb_fclose(ig->fp);
+          SFREE(ig->buf);
+          SFREE(ig);
+        }
+      SFREE(igd);
+    }
+    maxisig = maxigroup = 0;
+    /* The next record opened is deskewed only if it has skewed signals. */
+    SFREE(dsbuf);
+    dsbi = -1;
+    skewmax = 0;
   }
-  maxigroup = nigroup = 0;
+  nisig = nigroup = 0;
+  framelen = 0;
 
   istime = 0L;
   gvc = ispfmax = 1;
@@ -1401,11 +2248,16 @@ static int osigclose(void) {
           }
         }
         SFREE(og->buf);
+        for (; og->nobuf > 0; og->nobuf--) SFREE(og->ofree[og->nobuf - 1]);
+        delete og->cz;
         SFREE(og);
       }
     SFREE(ogd);
   }
   maxogroup = nogroup = 0;
+  owstop();
+  SFREE(pvbuf);
+  pvbuflen = 0L;
 
   ostime = 0L;
   if (oheader) {
@@ -1427,21 +2279,16 @@ static int osigclose(void) {
 signal group pointer).  The output routines get two arguments (the value to be
 written and the signal group pointer). */
 
-static int _l;  /* macro temporary storage for low byte of word */
-static int _lw; /* macro temporary storage for low 16 bits of int */
-static int _n;  /* macro temporary storage for byte count */
+/* Macro temporary storage (per thread, since several records may be read
+   concurrently): */
+static thread_local int _l;  /* low byte of word */
+static thread_local int _lw; /* low 16 bits of int */
+static thread_local int _n;  /* byte count */
 
-#define r8(G)                                                            \
-  ((G->bp < G->be) ? *(G->bp++)                                          \
-                   : ((_n = (G->bsize > 0) ? G->bsize : ibsize),         \
-                      (G->stat = _n = wfdb_fread(G->buf, 1, _n, G->fp)), \
-                      (G->be = (G->bp = G->buf) + _n), *(G->bp++)))
+#define r8(G) ((G->bp < G->be) ? *(G->bp++) : (iblock(G), *(G->bp++)))
 
-#define w8(V, G)                                                        \
-  (((*(G->bp++) = (char)V)),                                            \
-   (_l = (G->bp != G->be) ? 0                                           \
-                          : ((_n = (G->bsize > 0) ? G->bsize : obsize), \
-                             wfdb_fwrite((G->bp = G->buf), 1, _n, G->fp))))
+#define w8(V, G) \
+  (((*(G->bp++) = (char)V)), (_l = (G->bp != G->be) ? 0 : oblock(G)))
 
 /* If a short integer is not 16 bits, it may be necessary to redefine r16() and
 r61() in order to obtain proper sign extension. */
@@ -1658,134 +2505,1106 @@ static void f311(struct ogdata *g) {
   }
 }
 
-static int isgsetframe(WFDB_Group g, WFDB_Time t) {
-  int i, trem = 0;
-  long nb, tt;
-  struct igdata *ig;
-  WFDB_Signal s;
-  unsigned int b, d = 1, n, nn, j;
-
-  /* Do nothing if there is no more than one input signal group and
-     the input pointer is correct already. */
-  if (nigroup < 2 && istime == t && gvc == ispfmax && igd[g]->start == 0)
-    return (0);
-
-  /* Find the first signal that belongs to group g. */
-  for (s = 0; s < nisig && g != isd[s]->info.group; s++)
-    ;
-  if (s == nisig) {
-    wfdb_error("isgsettime: incorrect signal group number %d\n", g);
-    return (-2);
+/* oinvalid returns the value that is written in place of WFDB_INVALID_SAMPLE
+   to an output signal in format fmt (the lowest value that can be written in
+   that format). */
+static WFDB_Sample oinvalid(int fmt) {
+  switch (fmt) {
+    case 0:
+    case 8:
+    case 16:
+    case 61:
+    case 160:
+    default:
+      return (-1 << 15);
+    case 80:
+      return (-1 << 7);
+    case 212:
+      return (-1 << 11);
+    case 310:
+    case 311:
+      return (-1 << 9);
+    case 24:
+      return (-1 << 23);
+    case 32:
+    case CZFMT:
+      return (-1 << 31);
   }
+}
 
-  /* Mark the contents of the deskewing buffer (if any) as invalid. */
-  dsbi = -1;
-
-  /* If the current record contains multiple segments, locate the segment
-     containing the desired sample. */
-  if (in_msrec) {
-    WFDB_Seginfo *tseg = segp;
-    WFDB_Group h;
-
-    if (t >= msnsamples) {
-      wfdb_error("isigsettime: improper seek on signal group %d\n", g);
-      return (-1);
-    }
-    while (t < tseg->samp0) tseg--;
-    while (t >= tseg->samp0 + tseg->nsamp && tseg < segend) tseg++;
-    if (segp != tseg) {
-      segp = tseg;
-      if (isigopen(segp->recname, NULL, (int)nvsig) <= 0) {
-        wfdb_error("isigsettime: can't open segment %s\n", segp->recname);
-        return (-1);
-      }
-      /* Following isigopen(), nigroup may have changed and
-         group numbers may not make any sense anymore.  However,
-         isigsettime() will still call isgsettime() once for
-         each non-zero group (if the previous segment had
-         multiple groups) and then once for group zero.
-
-         Calling isgsetframe() multiple times for a non-zero
-         group is mostly harmless, but seeking on group 0 should
-         only be done once.  Thus, when we jump to a new
-         segment, implicitly seek on all non-zero groups
-         (regardless of g), but only seek on group 0 if g is 0.
-
-         (Note that isgsettime() is not and has never been fully
-         functional for multi-segment records, because it cannot
-         read signals from two different segments at once.) */
-      for (h = 1; h < nigroup; h++)
-        if (i = isgsetframe(h, t)) return (i);
-      if (g == 0)
-        return (isgsetframe(0, t));
-      else
-        return (0);
-    }
-    t -= segp->samp0;
+/* owrite writes v (a first difference, for format 8) to output signal group
+   g, which is in format fmt. */
+static void owrite(WFDB_Sample v, int fmt, struct ogdata *g) {
+  switch (fmt) {
+    case 0:
+      break;
+    case 8:
+    default:
+      w8(v, g);
+      break;
+    case 16:
+      w16(v, g);
+      break;
+    case 61:
+      w61(v, g);
+      break;
+    case 80:
+      w80(v, g);
+      break;
+    case 160:
+      w160(v, g);
+      break;
+    case 212:
+      w212(v, g);
+      break;
+    case 310:
+      w310(v, g);
+      break;
+    case 311:
+      w311(v, g);
+      break;
+    case 24:
+      w24(v, g);
+      break;
+    case 32:
+    case CZFMT:
+      w32(v, g);
+      break;
   }
+}
 
-  ig = igd[g];
-  /* Determine the number of samples per frame for signals in the group. */
-  for (n = nn = 0; s + n < nisig && isd[s + n]->info.group == g; n++)
-    nn += isd[s + n]->info.spf;
-  /* Determine the number of bytes per sample interval in the file. */
-  switch (isd[s]->info.fmt) {
+/* opack writes n samples from v, as owrite would, to output signal group g,
+   which is in format fmt.  Whole units (single samples, or the pairs and
+   triplets that formats 212, 310, and 311 pack into 3 or 4 bytes) are packed
+   directly into the group's buffer, which is written when it is full;  only
+   units that would straddle the end of the buffer, or that were begun by
+   putvec, are written using owrite. */
+static void opack(struct ogdata *g, int fmt, const WFDB_Sample *v, long n) {
+  int ub, us; /* bytes and samples per unit */
+  long k, m;
+  unsigned char *p;
+  unsigned long w;
+
+  switch (fmt) {
     case 0:
-      if (t < nsamples) {
-        gvc = ispfmax;
-        if (s == 0) istime = (in_msrec) ? t + segp->samp0 : t;
-        isd[s]->info.nsamp = nsamples - t;
-        ig->stat = 1;
-        return (0);
-      } else {
-        if (s == 0) istime = (in_msrec) ? msnsamples : nsamples;
-        isd[s]->info.nsamp = 0L;
-        return (-1);
-      }
+      return;
     case 8:
     case 80:
     default:
-      b = nn;
+      ub = us = 1;
       break;
     case 16:
     case 61:
     case 160:
-      if (nn > UINT_MAX / 2) {
-        wfdb_error("isigsettime: overflow in signal group %d\n", g);
-        return (-1);
-      }
-      b = 2 * nn;
+      ub = 2;
+      us = 1;
+      break;
+    case 24:
+      ub = 3;
+      us = 1;
+      break;
+    case 32:
+    case CZFMT:
+      ub = 4;
+      us = 1;
       break;
     case 212:
-      if (nn > UINT_MAX / 3) {
-        wfdb_error("isigsettime: overflow in signal group %d\n", g);
-        return (-1);
-      }
-      /* Reset the input counter. */
-      ig->count = 0;
-      /* If the desired sample does not lie on a byte boundary, seek to
-         the previous sample and then read ahead. */
-      if ((nn & 1) && (t & 1)) {
-        if (in_msrec) t += segp->samp0; /* restore absolute time */
-        if (i = isgsetframe(g, t - 1)) return (i);
-        for (j = 0; j < nn; j++) (void)r212(ig);
-        istime++;
-        for (n = 0; s + n < nisig && isd[s + n]->info.group == g; n++)
-          isd[s + n]->info.nsamp = (WFDB_Time)0L;
-        return (0);
-      }
-      b = 3 * nn;
-      d = 2;
+      ub = 3;
+      us = 2;
       break;
     case 310:
-      if (nn > UINT_MAX / 4) {
-        wfdb_error("isigsettime: overflow in signal group %d\n", g);
-        return (-1);
-      }
-      /* Reset the input counter. */
-      ig->count = 0;
-      /* If the desired sample does not lie on a byte boundary, seek to
-         the closest previous sample that does, then read ahead. */
+    case 311:
+      ub = 4;
+      us = 3;
+      break;
+  }
+
+  /* Complete any unit begun by putvec. */
+  for (; n > 0 && g->count != 0; n--) owrite(*v++, fmt, g);
+
+  while (n >= us) {
+    if ((m = (g->be - g->bp) / ub) > n / us) m = n / us;
+    if (m == 0) { /* the next unit straddles the end of the buffer */
+      for (k = 0; k < us; k++) owrite(*v++, fmt, g);
+      n -= us;
+      continue;
+    }
+    p = (unsigned char *)g->bp;
+    k = 0;
+    switch (fmt) {
+      case 8:
+      default:
+        for (; k < m; k++) *p++ = v[k];
+        break;
+      case 80:
+        for (; k < m; k++) *p++ = (v[k] & 0xff) + (1 << 7);
+        break;
+      case 16:
+#if !defined(NOSIMD) && defined(__SSE2__)
+        /* Truncate 8 samples to 16 bits and store them (little-endian). */
+        for (; k + 8 <= m; k += 8, p += 16) {
+          __m128i a = _mm_loadu_si128((const __m128i *)(v + k));
+          __m128i b = _mm_loadu_si128((const __m128i *)(v + k + 4));
+
+          a = _mm_srai_epi32(_mm_slli_epi32(a, 16), 16);
+          b = _mm_srai_epi32(_mm_slli_epi32(b, 16), 16);
+          _mm_storeu_si128((__m128i *)p, _mm_packs_epi32(a, b));
+        }
+#endif
+        for (; k < m; k++) {
+          *p++ = v[k];
+          *p++ = v[k] >> 8;
+        }
+        break;
+      case 61:
+        for (; k < m; k++) {
+          *p++ = v[k] >> 8;
+          *p++ = v[k];
+        }
+        break;
+      case 160:
+        for (; k < m; k++) {
+          w = (v[k] & 0xffff) + (1 << 15);
+          *p++ = w;
+          *p++ = w >> 8;
+        }
+        break;
+      case 24:
+        for (; k < m; k++) {
+          *p++ = v[k];
+          *p++ = v[k] >> 8;
+          *p++ = v[k] >> 16;
+        }
+        break;
+      case 32:
+      case CZFMT:
+        for (; k < m; k++) {
+          *p++ = v[k];
+          *p++ = v[k] >> 8;
+          *p++ = v[k] >> 16;
+          *p++ = v[k] >> 24;
+        }
+        break;
+      case 212:
+#if !defined(NOSIMD) && defined(__SSE2__)
+        /* Pack 4 pairs into 12 bytes.  Each pair (a, b), truncated to 16
+           bits, makes a 32-bit word that is rearranged into the 3 bytes to be
+           written;  pairs of these are then joined within 64-bit lanes.  Each
+           store writes two bytes beyond the 6 it is meant to, so at least one
+           more pair must follow. */
+        for (; k + 5 <= m; k += 4, p += 12) {
+          const __m128i m24 = _mm_set_epi32(0, 0xffffff, 0, 0xffffff);
+          __m128i a = _mm_loadu_si128((const __m128i *)(v + 2 * k));
+          __m128i b = _mm_loadu_si128((const __m128i *)(v + 2 * k + 4));
+
+          a = _mm_srai_epi32(_mm_slli_epi32(a, 16), 16);
+          b = _mm_srai_epi32(_mm_slli_epi32(b, 16), 16);
+          a = _mm_packs_epi32(a, b); /* 32-bit lanes: a | b << 16 */
+          a = _mm_or_si128(
+              _mm_and_si128(a, _mm_set1_epi32(0x00ff0fff)),
+              _mm_and_si128(_mm_srli_epi32(a, 12), _mm_set1_epi32(0xf000)));
+          a = _mm_or_si128(_mm_and_si128(a, m24),
+                           _mm_andnot_si128(m24, _mm_srli_epi64(a, 8)));
+          _mm_storel_epi64((__m128i *)p, a);
+          _mm_storel_epi64((__m128i *)(p + 6), _mm_unpackhi_epi64(a, a));
+        }
+#endif
+        for (; k < m; k++) {
+          w = (v[2 * k] & 0xfff) | ((v[2 * k + 1] << 4) & 0xf000);
+          *p++ = w;
+          *p++ = w >> 8;
+          *p++ = v[2 * k + 1];
+        }
+        break;
+      case 310:
+        for (; k < m; k++) {
+          w = ((v[3 * k] << 1) & 0x7fe) | ((v[3 * k + 2] << 11) & 0xf800) |
+              (((v[3 * k + 1] << 1) & 0x7fe) << 16) |
+              ((unsigned long)((v[3 * k + 2] << 6) & 0xf800) << 16);
+          *p++ = w;
+          *p++ = w >> 8;
+          *p++ = w >> 16;
+          *p++ = w >> 24;
+        }
+        break;
+      case 311:
+        for (; k < m; k++) {
+          w = (v[3 * k] & 0x3ff) | ((v[3 * k + 1] & 0x3ff) << 10) |
+              ((unsigned long)(v[3 * k + 2] & 0x3ff) << 20);
+          *p++ = w;
+          *p++ = w >> 8;
+          *p++ = w >> 16;
+          *p++ = w >> 24;
+        }
+        break;
+    }
+    g->bp += m * ub;
+    v += m * us;
+    n -= m * us;
+    if (g->bp == g->be) (void)oblock(g);
+  }
+
+  /* Begin the last unit, if it is incomplete. */
+  while (n-- > 0) owrite(*v++, fmt, g);
+}
+
+/* Compressed signal files
+
+A signal file in format 1000 (CZFMT) contains all of the samples of a signal
+group, losslessly compressed in blocks of CZFRAMES frames (fewer in the last
+block), followed by an index that allows any block to be found directly:
+    the offset of each block (8 bytes each)
+    frames per block, samples per frame (4 bytes each)
+    number of blocks, number of frames (8 bytes each)
+    "WFDB1000"
+All numbers are little-endian.  Each block begins at a byte boundary, and
+contains the samples of each column (sample number within the frame) in turn.
+Each column is coded as a 2-bit predictor order p (0, 1, or 2, chosen to make
+the sum of the magnitudes of the prediction residuals as small as possible), a
+5-bit Rice parameter k, the first p samples (32 bits each), and the residuals
+of the remaining samples.  Each residual is mapped to an unsigned value u (0,
+-1, 1, -2, ... become 0, 1, 2, 3, ...), which is written as u >> k in unary
+(that many 1 bits followed by a 0 bit) and the k low-order bits of u, or, if u
+>> k is CZESCAPE or more, as CZESCAPE 1 bits followed by u in 40 bits.  Bits
+are written most significant first.
+
+The index of an input group in this format is read when the group is opened
+(see czopen).  iblock decodes one block at a time into the group's buffer as
+format 32 samples (see czblock), so that the group is read as if it were in
+format 32, and isgsetframe decodes the block containing the desired frame (see
+czseek).  An output group collects the samples written into its buffer and
+writes each block when it is complete (see czput), and osigclose writes the
+last block and the index (see czclose).  Output to compressed files is always
+synchronous. */
+
+#define CZFRAMES 4096 /* frames per block */
+#define CZESCAPE 16   /* length of the prefix of an escaped residual */
+#define CZTRAILER 32  /* length of the end of the index */
+
+struct czdata {
+  unsigned nn;                      /* samples per frame */
+  unsigned bframes;                 /* frames per block */
+  int64_t nframes;                  /* frames in (or written to) the file */
+  std::vector<int64_t> index;       /* offset of each block, followed (for
+                                       input) by that of the index */
+  size_t next;                      /* next block to be decoded */
+  std::vector<unsigned char> bytes; /* an encoded block */
+  std::vector<WFDB_Sample> raw;     /* samples not yet encoded */
+  int64_t pos;                      /* offset of the next block written, or
+                                       -1 if not yet known */
+};
+
+struct czbits {
+  std::vector<unsigned char> *out; /* output (for put) */
+  const unsigned char *p, *e;      /* input (for get) */
+  uint64_t acc;                    /* bits not yet written or read */
+  int n;                           /* number of such bits */
+  int err;                         /* 1 if get ran past e */
+  void put(uint64_t v, int bits) {
+    acc = (acc << bits) | (v & ((uint64_t)1 << bits) - 1);
+    for (n += bits; n >= 8; n -= 8) out->push_back(acc >> (n - 8));
+  }
+  uint64_t get(int bits) {
+    for (; n < bits; n += 8) acc = (acc << 8) | (p < e ? *p++ : (err = 1, 0));
+    n -= bits;
+    return ((acc >> n) & ((uint64_t)1 << bits) - 1);
+  }
+};
+
+/* czload and czstore get and set an n-byte little-endian number at p. */
+static int64_t czload(const unsigned char *p, int n) {
+  uint64_t v = 0;
+
+  while (n-- > 0) v = (v << 8) | p[n];
+  return ((int64_t)v);
+}
+
+static void czstore(unsigned char *p, int64_t v, int n) {
+  for (; n > 0; n--, v >>= 8) *p++ = v;
+}
+
+/* czencode encodes m frames of nn samples each from x into out. */
+static void czencode(const WFDB_Sample *x, long m, unsigned nn,
+                     std::vector<unsigned char> &out) {
+  struct czbits w = {&out, NULL, NULL, 0, 0, 0};
+  unsigned c;
+  int k, p;
+  long j;
+  int64_t e, r, sum[3];
+  uint64_t q, u;
+
+  out.clear();
+  for (c = 0; c < nn; c++, x++) {
+    /* Choose the predictor order and the Rice parameter. */
+    sum[0] = sum[1] = sum[2] = 0;
+    for (j = 2; j < m; j++) {
+      e = x[j * nn];
+      sum[0] += llabs(e);
+      sum[1] += llabs(e - x[(j - 1) * nn]);
+      sum[2] += llabs(e - 2 * (int64_t)x[(j - 1) * nn] + x[(j - 2) * nn]);
+    }
+    p = (sum[1] < sum[0]) ? 1 : 0;
+    if (sum[2] < sum[p]) p = 2;
+    for (k = 0; k < 31 && ((int64_t)(m > 2 ? m - 2 : 1) << (k + 1)) <= sum[p];
+         k++)
+      ;
+    if (p > m) p = m;
+    w.put(p, 2);
+    w.put(k, 5);
+
+    for (j = 0; j < p; j++) w.put((uint32_t)x[j * nn], 32);
+    for (; j < m; j++) {
+      r = x[j * nn];
+      if (p == 1)
+        r -= x[(j - 1) * nn];
+      else if (p == 2)
+        r -= 2 * (int64_t)x[(j - 1) * nn] - x[(j - 2) * nn];
+      u = ((uint64_t)r << 1) ^ (uint64_t)(r >> 63);
+      if ((q = u >> k) < CZESCAPE) {
+        w.put((((uint64_t)1 << q) - 1) << 1, q + 1);
+        w.put(u, k);
+      } else {
+        w.put(((uint64_t)1 << CZESCAPE) - 1, CZESCAPE);
+        w.put(u, 40);
+      }
+    }
+  }
+  if (w.n > 0) w.put(0, 8 - w.n);
+}
+
+/* czdecode decodes m frames of nn samples each from the len bytes at p into
+   buf, as format 32 samples.  It returns 0, or -1 if the data are invalid. */
+static int czdecode(const unsigned char *p, size_t len, long m, unsigned nn,
+                    char *buf) {
+  struct czbits rd = {NULL, p, p + len, 0, 0, 0};
+  unsigned c, o, q;
+  int k;
+  long j;
+  int64_t r, x1, x2;
+  uint64_t u;
+  WFDB_Sample v;
+  unsigned char *d;
+
+  for (c = 0; c < nn; c++) {
+    o = rd.get(2);
+    k = rd.get(5);
+    if (o > 2) return (-1);
+    x1 = x2 = 0;
+    for (j = 0, d = (unsigned char *)buf + 4 * c; j < m; j++, d += 4 * nn) {
+      if (j < o)
+        v = (WFDB_Sample)(uint32_t)rd.get(32);
+      else {
+        for (q = 0; q < CZESCAPE && rd.get(1); q++)
+          ;
+        u = (q < CZESCAPE) ? ((uint64_t)q << k) | rd.get(k) : rd.get(40);
+        r = (int64_t)(u >> 1) ^ -(int64_t)(u & 1);
+        v = (WFDB_Sample)(uint32_t)(r + (o == 0   ? 0
+                                         : o == 1 ? x1
+                                                  : 2 * x1 - x2));
+      }
+      x2 = x1;
+      x1 = v;
+      d[0] = v;
+      d[1] = v >> 8;
+      d[2] = v >> 16;
+      d[3] = v >> 24;
+    }
+    if (rd.err) return (-1);
+  }
+  return (0);
+}
+
+/* czopen reads the index of the compressed signal file of input group ig,
+   which has nn samples per frame.  It returns 0, or -1 if the index is
+   missing or invalid. */
+static int czopen(struct igdata *ig, unsigned nn) {
+  unsigned char t[CZTRAILER];
+  struct czdata *z;
+  int64_t end, i, nb;
+
+  if (wfdb_fseek(ig->fp, 0L, SEEK_END) || (end = wfdb_ftell(ig->fp)) < 0 ||
+      end < CZTRAILER ||
+      wfdb_pread(ig->fp, t, CZTRAILER, end - CZTRAILER) != CZTRAILER ||
+      memcmp(t + 24, "WFDB1000", 8) != 0)
+    return (-1);
+  if ((z = new (std::nothrow) struct czdata) == NULL) return (-1);
+  z->bframes = czload(t, 4);
+  z->nn = czload(t + 4, 4);
+  nb = czload(t + 8, 8);
+  z->nframes = czload(t + 16, 8);
+  z->next = 0;
+  z->pos = -1;
+  end -= CZTRAILER;
+  if (z->nn != nn || nn == 0 || z->bframes == 0 ||
+      z->bframes > INT_MAX / 4 / nn || z->nframes < 0 || nb < 0 ||
+      nb > end / 8 || nb != (z->nframes + z->bframes - 1) / z->bframes) {
+    delete z;
+    return (-1);
+  }
+  end -= 8 * nb;
+  z->bytes.resize(8 * nb);
+  z->index.resize(nb + 1);
+  z->index[nb] = end;
+  if (nb > 0 && wfdb_pread(ig->fp, z->bytes.data(), 8 * nb, end) != 8 * nb) {
+    delete z;
+    return (-1);
+  }
+  for (i = nb - 1; i >= 0; i--)
+    if ((z->index[i] = czload(&z->bytes[8 * i], 8)) < 0 ||
+        z->index[i] > z->index[i + 1]) {
+      delete z;
+      return (-1);
+    }
+  ig->cz = z;
+  return (0);
+}
+
+/* czblock decodes the next block of the compressed signal file of input group
+   g into g's buffer, and sets g->stat to the number of bytes obtained. */
+static int czblock(struct igdata *g) {
+  struct czdata *z = g->cz;
+  long len, m, n = 0;
+
+  if (z->next + 1 < z->index.size()) {
+    if ((m = z->nframes - (int64_t)z->next * z->bframes) > z->bframes)
+      m = z->bframes;
+    n = m * z->nn * 4;
+    if (g->buflen < n) {
+      SREALLOC(g->buf, n, 1);
+      g->buflen = n;
+    }
+    len = z->index[z->next + 1] - z->index[z->next];
+    z->bytes.resize(len);
+    if (wfdb_pread(g->fp, z->bytes.data(), len, z->index[z->next]) != len ||
+        czdecode(z->bytes.data(), len, m, z->nn, g->buf) < 0) {
+      wfdb_error("getvec: error in block %ld of a compressed signal file\n",
+                 (long)z->next);
+      z->next = z->index.size() - 1;
+      n = 0;
+    } else
+      z->next++;
+  }
+  g->be = (g->bp = g->buf) + n;
+  return (g->stat = n);
+}
+
+/* czseek positions input group ig, which has a compressed signal file, at
+   frame t.  It returns 0, or -1 if there is no such frame. */
+static int czseek(struct igdata *ig, WFDB_Time t) {
+  struct czdata *z = ig->cz;
+  size_t b;
+
+  if (t < 0 || t > z->nframes) return (-1);
+  b = t / z->bframes;
+  /* Decode the block unless it is in the buffer already. */
+  if (z->next != b + 1 || ig->be == ig->buf) {
+    z->next = b;
+    if (czblock(ig) <= 0 && t < z->nframes) return (-1);
+  }
+  ig->bp = ig->buf + (t - (WFDB_Time)b * z->bframes) * z->nn * 4;
+  ig->stat = 1;
+  return (0);
+}
+
+/* czwrite encodes m frames from x, and writes them to the compressed signal
+   file of output group g as the next block. */
+static int czwrite(struct ogdata *g, const WFDB_Sample *x, long m) {
+  struct czdata *z = g->cz;
+
+  czencode(x, m, z->nn, z->bytes);
+  if (z->pos < 0 && (z->pos = wfdb_ftell(g->fp)) < 0) z->pos = 0;
+  z->index.push_back(z->pos);
+  z->pos += z->bytes.size();
+  z->nframes += m;
+  if (wfdb_fwrite(z->bytes.data(), 1, z->bytes.size(), g->fp) !=
+      z->bytes.size())
+    return (-1);
+  return (0);
+}
+
+/* czput moves the samples in the buffer of output group g, which has a
+   compressed signal file, into g->cz, and writes each block that is
+   complete. */
+static int czput(struct ogdata *g) {
+  struct czdata *z = g->cz;
+  const unsigned char *p = (const unsigned char *)g->buf;
+  size_t f = 0, n;
+  int stat = 0;
+
+  for (; p + 4 <= (const unsigned char *)g->bp; p += 4)
+    z->raw.push_back((int)(p[0] | p[1] << 8 | p[2] << 16 |
+                           (unsigned)p[3] << 24));
+  /* Keep any incomplete sample at the beginning of the buffer. */
+  n = (const unsigned char *)g->bp - p;
+  memmove(g->buf, p, n);
+  g->bp = g->buf + n;
+  for (; z->raw.size() - f >= (size_t)z->bframes * z->nn;
+       f += (size_t)z->bframes * z->nn)
+    if (czwrite(g, z->raw.data() + f, z->bframes)) stat = -1;
+  z->raw.erase(z->raw.begin(), z->raw.begin() + f);
+  return (stat);
+}
+
+/* czclose writes the remaining samples of output group g, which has a
+   compressed signal file, followed by the index. */
+static int czclose(struct ogdata *g) {
+  struct czdata *z = g->cz;
+  size_t i, nb;
+  int stat = czput(g);
+
+  if (z->raw.size() >= z->nn &&
+      czwrite(g, z->raw.data(), z->raw.size() / z->nn))
+    stat = -1;
+  z->raw.clear();
+  nb = z->index.size();
+  z->bytes.resize(8 * nb + CZTRAILER);
+  for (i = 0; i < nb; i++) czstore(&z->bytes[8 * i], z->index[i], 8);
+  czstore(&z->bytes[8 * nb], z->bframes, 4);
+  czstore(&z->bytes[8 * nb + 4], z->nn, 4);
+  czstore(&z->bytes[8 * nb + 8], nb, 8);
+  czstore(&z->bytes[8 * nb + 16], z->nframes, 8);
+  memcpy(&z->bytes[8 * nb + 24], "WFDB1000", 8);
+  if (wfdb_fwrite(z->bytes.data(), 1, z->bytes.size(), g->fp) !=
+      z->bytes.size())
+    stat = -1;
+  return (stat);
+}
+
+/* Asynchronous output
+
+If asynchronous output has been selected using setoasync, output signal groups
+are given spare buffers when they are opened, and the record gets a writer
+thread (see owmain) when the first such group is opened.  When a group's buffer
+is full, oblock passes it to the writer thread and continues in a spare buffer,
+waiting only if all of the group's spare buffers are waiting to be written.
+Anything else that writes to, seeks in, or closes the output signal files
+(wfdb_osflush, osigclose, wfdbputprolog) first calls owait, which waits until
+the writer thread has finished with all of the buffers passed to it. */
+
+struct owblock {
+  struct ogdata *og; /* group to which buf belongs */
+  char *buf;         /* data to be written */
+  long n;            /* number of bytes to be written */
+};
+
+struct owriter {
+  std::thread thread;
+  std::mutex mutex;            /* guards the variables below, and nofree and
+                                  ofree in each group */
+  std::condition_variable cv;  /* notified whenever they change */
+  std::deque<owblock> queue;   /* buffers waiting to be written */
+  int busy;                    /* 1 while a buffer is being written */
+  int stop;                    /* 1 if the thread should exit */
+  std::atomic<int> err{0};     /* 1 after any write error */
+};
+
+/* owmain is the body of the writer thread.  It writes the buffers queued by
+   oblock, in order, and returns each to its group's list of spare buffers. */
+static void owmain(struct owriter *w) {
+  std::unique_lock<std::mutex> lock(w->mutex);
+  struct owblock b;
+
+  for (;;) {
+    while (w->queue.empty() && !w->stop) w->cv.wait(lock);
+    if (w->queue.empty()) break;
+    b = w->queue.front();
+    w->queue.pop_front();
+    w->busy = 1;
+    lock.unlock();
+    (void)wfdb_fwrite(b.buf, 1, b.n, b.og->fp);
+    if (wfdb_ferror(b.og->fp)) w->err = 1;
+    lock.lock();
+    b.og->ofree[b.og->nofree++] = b.buf;
+    w->busy = 0;
+    w->cv.notify_all();
+  }
+}
+
+/* oblock writes the full buffer of output signal group g, or passes it to the
+   writer thread if g has spare buffers, or passes its samples to czput if g's
+   file is compressed, and makes g's buffer empty. */
+static int oblock(struct ogdata *g) {
+  long n = (g->bsize > 0) ? g->bsize : obsize.load();
+
+  if (g->cz) return (czput(g));
+  if (g->nobuf == 0) return (wfdb_fwrite((g->bp = g->buf), 1, n, g->fp));
+  std::unique_lock<std::mutex> lock(owr->mutex);
+  owr->queue.push_back({g, g->buf, n});
+  owr->cv.notify_all();
+  while (g->nofree == 0) owr->cv.wait(lock);
+  g->bp = g->buf = g->ofree[--g->nofree];
+  g->be = g->buf + n;
+  return (0);
+}
+
+/* owait waits until the writer thread (if any) has written all of the buffers
+   that have been passed to it. */
+static void owait(void) {
+  if (owr == NULL) return;
+  std::unique_lock<std::mutex> lock(owr->mutex);
+  while (!owr->queue.empty() || owr->busy) owr->cv.wait(lock);
+}
+
+/* owstop waits for the writer thread (if any) to finish, and releases it. */
+static void owstop(void) {
+  if (owr == NULL) return;
+  {
+    std::lock_guard<std::mutex> lock(owr->mutex);
+    owr->stop = 1;
+    owr->cv.notify_all();
+  }
+  owr->thread.join();
+  delete owr;
+  owr = NULL;
+}
+
+/* oerror returns non-zero if an error has occurred while writing the signal
+   file of output group g.  (While the writer thread may be using the file,
+   its error status is not examined directly.) */
+static int oerror(struct ogdata *g) {
+  if (g->nobuf) return (owr->err);
+  return (wfdb_ferror(g->fp));
+}
+
+/* Read-ahead
+
+If read-ahead has been selected using setiprefetch, each input signal group
+that is read from a local file (one that is not mapped into memory) is given a
+reader thread (see irmain) and a set of spare buffers when it is opened.  The
+reader thread reads successive blocks of the file into the spare buffers, while
+iblock, which is called by r8 whenever the group's buffer is empty, takes the
+next block that has been read, waiting only if there is none, and returns the
+group's previous buffer to the reader.  Before isgsetframe moves the file
+pointer, irpause stops the reader and discards the blocks that it has read;
+the next call to iblock restarts it. */
+
+struct irblock {
+  char *buf; /* data read */
+  long n;    /* number of bytes in buf */
+};
+
+struct ireader {
+  std::thread thread;
+  std::mutex mutex;           /* guards the variables below */
+  std::condition_variable cv; /* notified whenever they change */
+  WFDB_FILE *fp;              /* file to be read */
+  long size;                  /* number of bytes to be read at a time */
+  std::deque<irblock> full;   /* blocks read but not yet used, in order */
+  int nfree;                  /* number of empty buffers */
+  char *free[IRMAXBUF];       /* empty buffers */
+  int busy;                   /* 1 while a block is being read */
+  int pause;                  /* 1 if no more blocks are to be read */
+  int eof;                    /* 1 after a short read */
+  int stop;                   /* 1 if the thread should exit */
+};
+
+/* irmain is the body of a reader thread.  It fills empty buffers with
+   successive blocks of the file, until it is paused, stopped, or reaches the
+   end of the file. */
+static void irmain(struct ireader *r) {
+  std::unique_lock<std::mutex> lock(r->mutex);
+  struct irblock b;
+
+  for (;;) {
+    while ((r->nfree == 0 || r->pause || r->eof) && !r->stop) r->cv.wait(lock);
+    if (r->stop) break;
+    b.buf = r->free[--r->nfree];
+    r->busy = 1;
+    lock.unlock();
+    b.n = wfdb_fread(b.buf, 1, r->size, r->fp);
+    lock.lock();
+    if (b.n < r->size) r->eof = 1;
+    r->full.push_back(b);
+    r->busy = 0;
+    r->cv.notify_all();
+  }
+}
+
+/* iblock refills the buffer of input signal group g with the next block of its
+   signal file, either by decoding it (if the file is compressed), by reading
+   it (at g->rpos, if set, or otherwise at the file position), or by taking it
+   from g's reader thread, and sets g->stat to the number of bytes obtained. */
+static int iblock(struct igdata *g) {
+  struct ireader *r = g->ir;
+  struct irblock b;
+  long n = (g->bsize > 0) ? g->bsize : ibsize.load();
+
+  if (g->cz) return (czblock(g));
+  if (r == NULL && g->rpos >= 0) {
+    if ((n = wfdb_pread(g->fp, g->buf, n, g->rpos)) < 0) n = 0;
+    g->rpos += n;
+  } else if (r == NULL)
+    n = wfdb_fread(g->buf, 1, n, g->fp);
+  else {
+    std::unique_lock<std::mutex> lock(r->mutex);
+
+    r->pause = 0;
+    r->cv.notify_all();
+    while (r->full.empty() && !r->eof) r->cv.wait(lock);
+    if (r->full.empty())
+      n = 0; /* end of file */
+    else {
+      b = r->full.front();
+      r->full.pop_front();
+      r->free[r->nfree++] = g->buf;
+      g->buf = b.buf;
+      n = b.n;
+      r->cv.notify_all();
+    }
+  }
+  g->be = (g->bp = g->buf) + n;
+  return (g->stat = n);
+}
+
+/* irstart starts a reader thread for input signal group ig, with n - 1 spare
+   buffers.  If this cannot be done, the group is read without read-ahead. */
+static void irstart(struct igdata *ig, int n) {
+  struct ireader *r;
+
+  if ((r = new (std::nothrow) struct ireader()) == NULL) return;
+  r->fp = ig->fp;
+  r->size = ig->bsize;
+  for (; r->nfree < n - 1; r->nfree++) SALLOC(r->free[r->nfree], 1, ig->buflen);
+  try {
+    r->thread = std::thread(irmain, r);
+  } catch (...) { /* no thread is available */
+    for (; r->nfree > 0; r->nfree--) SFREE(r->free[r->nfree - 1]);
+    delete r;
+    return;
+  }
+  ig->ir = r;
+  (void)wfdb_fadvise(ig->fp, 0L, 0L);
+}
+
+/* irpause stops the reader thread of input signal group ig from reading, waits
+   until it is idle, and discards the blocks that it has read, so that the file
+   pointer may be moved.  Reading resumes at the next call to iblock. */
+static void irpause(struct igdata *ig) {
+  struct ireader *r = ig->ir;
+  std::unique_lock<std::mutex> lock(r->mutex);
+
+  r->pause = 1;
+  while (r->busy) r->cv.wait(lock);
+  while (!r->full.empty()) {
+    r->free[r->nfree++] = r->full.front().buf;
+    r->full.pop_front();
+  }
+  r->eof = 0;
+}
+
+/* irstop stops the reader thread of input signal group ig (if any), and
+   releases it and its buffers (other than the one in use, ig->buf). */
+static void irstop(struct igdata *ig) {
+  struct ireader *r = ig->ir;
+
+  if (r == NULL) return;
+  {
+    std::lock_guard<std::mutex> lock(r->mutex);
+    r->stop = 1;
+    r->cv.notify_all();
+  }
+  r->thread.join();
+  while (!r->full.empty()) {
+    r->free[r->nfree++] = r->full.front().buf;
+    r->full.pop_front();
+  }
+  for (; r->nfree > 0; r->nfree--) SFREE(r->free[r->nfree - 1]);
+  delete r;
+  ig->ir = NULL;
+}
+
+/* Segment prefetch
+
+If it has been enabled using setsegprefetch, then whenever isigopen opens a
+segment of a multi-segment record, it starts a thread (see sfmain) that reads
+the header of the following segment and opens that segment's signal files,
+while the current segment is being read.  When isigopen is called at the end
+of the current segment to open the next one, it waits for the thread, if it
+has not finished already, and then uses the header that it read (see sftake)
+and the files that it opened (see sfopen), rather than reading and opening
+them itself.  The header is read only in this way;  it is parsed by readheader
+as usual.  A prefetch that is not used is discarded (see sfstop). */
+
+struct sfetch {
+  std::thread thread;
+  int seg;                        /* index of the segment in segarray */
+  std::string irec;               /* record name (see wfdb_setirec) */
+  std::string recname;            /* segment name */
+  long bsize;                     /* bytes of each file to be read first */
+  std::string text;               /* its header (empty if unreadable) */
+  std::vector<std::string> fname; /* names of its signal files */
+  std::vector<WFDB_FILE *> fp;    /* the files, if opened, or NULL */
+};
+
+/* sfmain is the body of a prefetch thread.  It reads the header of segment
+   f->recname, and opens the signal files named in it.  readheader cannot be
+   used here, since it fills in the state of the current record, so sfmain
+   finds the names of the signal files itself.  It splits the lines into fields
+   as readheader does (using hfield), and must follow readheader's rules for
+   the fields that it reads (comment lines, the record line and its signal
+   count, and the file name and format of each signal line), and be changed
+   whenever they are;  a file that it names differently from readheader is not
+   used by isigopen (see sfopen), but is opened in vain. */
+static void sfmain(struct sfetch *f) {
+  char buf[1024], *lp, *p, *q;
+  long n;
+  int nsig = -1;
+  size_t i, j;
+  std::string line;
+  WFDB_FILE *fp;
+
+  wfdb_setirec(f->irec.c_str());
+  if ((fp = wfdb_open("hea", f->recname.c_str(), WFDB_READ)) == NULL) return;
+  while ((n = wfdb_fread(buf, 1, sizeof(buf), fp)) > 0) f->text.append(buf, n);
+  (void)wfdb_fclose(fp);
+
+  /* Find the file name and format of each signal.  Skip comment lines, the
+     record line (giving up if it names a multi-segment record), and signals
+     without files;  consecutive signals in the same file need it only once. */
+  for (i = 0; nsig != 0 && i < f->text.size(); i = j + 1) {
+    if ((j = f->text.find('\n', i)) == std::string::npos) j = f->text.size();
+    line = f->text.substr(i, j - i);
+    if ((p = hfield(&line[0], hsep, &lp)) == NULL || *p == '#') continue;
+    q = hfield(NULL, hsep, &lp);
+    if (nsig < 0) { /* record line */
+      if (strchr(p, '/')) break;
+      nsig = q ? (int)strtol(q, NULL, 10) : 0;
+      continue;
+    }
+    nsig--;
+    if (strcmp(p, "~") == 0 || q == NULL || strtol(q, NULL, 10) == 0 ||
+        (!f->fname.empty() && f->fname.back() == p))
+      continue;
+    f->fname.push_back(p);
+    if ((fp = wfdb_open(p, (char *)NULL, WFDB_READ)) != NULL)
+      (void)wfdb_fadvise(fp, 0L, f->bsize);
+    f->fp.push_back(fp);
+  }
+}
+
+/* sfstop waits for the prefetch thread (if any) to finish, closes the files
+   that it opened but that were not used, and releases it. */
+static void sfstop(void) {
+  struct sfetch *f = segfetch;
+
+  if (f == NULL) return;
+  if (f->thread.joinable()) f->thread.join();
+  for (WFDB_FILE *fp : f->fp)
+    if (fp) (void)wfdb_fclose(fp);
+  delete f;
+  segfetch = NULL;
+}
+
+/* sfstart starts a prefetch thread for the segment that follows the current
+   one (segp), if prefetching is enabled and there is such a segment.  If no
+   thread is available, the segment is simply not prefetched. */
+static void sfstart(void) {
+  struct sfetch *f;
+  const char *irec = wfdb_getirec();
+
+  sfstop();
+  if (isegfetch <= 0 || !in_msrec || segp == NULL || segp >= segend ||
+      strcmp(segp[1].recname, "~") == 0 || strchr(segp[1].recname, '.') ||
+      (f = new (std::nothrow) struct sfetch) == NULL)
+    return;
+  f->seg = (int)(segp + 1 - segarray);
+  f->irec = irec ? irec : "";
+  f->recname = segp[1].recname;
+  f->bsize = ibsize;
+  try {
+    f->thread = std::thread(sfmain, f);
+  } catch (...) { /* no thread is available */
+    delete f;
+    return;
+  }
+  segfetch = f;
+}
+
+/* sftake waits for the prefetch thread (if any) to finish.  If it prefetched
+   record, which must be the current segment, sftake keeps the header that it
+   read as the copy of that segment's header used by readheader;  otherwise,
+   the prefetch is discarded. */
+static void sftake(const char *record) {
+  struct sfetch *f = segfetch;
+
+  if (f == NULL) return;
+  if (f->thread.joinable()) f->thread.join();
+  if (!in_msrec || segp == NULL || f->seg != segp - segarray ||
+      f->recname != record) {
+    sfstop();
+    return;
+  }
+  if (!f->text.empty() && (f->seg >= nsegtext || segtext[f->seg] == NULL) &&
+      segtextlen < SEGTEXTMAX) {
+    if (nsegtext < segments) {
+      SREALLOC(segtext, segments, sizeof(char *));
+      while (nsegtext < segments) segtext[nsegtext++] = NULL;
+    }
+    SSTRCPY(segtext[f->seg], f->text.c_str());
+    segtextlen += f->text.size();
+  }
+}
+
+/* sfopen returns the prefetched signal file named fname, if there is one,
+   or NULL otherwise;  the file is then no longer part of the prefetch. */
+static WFDB_FILE *sfopen(const char *fname) {
+  struct sfetch *f = segfetch;
+  WFDB_FILE *fp;
+  size_t i;
+
+  if (f == NULL || f->thread.joinable()) return (NULL);
+  for (i = 0; i < f->fname.size(); i++)
+    if (f->fname[i] == fname && (fp = f->fp[i])) {
+      f->fp[i] = NULL;
+      return (fp);
+    }
+  return (NULL);
+}
+
+/* segfind returns the segment of a multi-segment record that contains sample
+   number t (0 <= t < msnsamples). */
+static WFDB_Seginfo *segfind(WFDB_Time t) {
+  WFDB_Seginfo *lo = segarray, *hi = segend, *mid;
+
+  /* Find the last segment that begins at or before t.  Any segments of
+     length zero that begin at t precede it. */
+  while (lo < hi) {
+    mid = lo + (hi - lo + 1) / 2;
+    if (mid->samp0 <= t)
+      lo = mid;
+    else
+      hi = mid - 1;
+  }
+  return (lo);
+}
+
+static int isgsetframe(WFDB_Group g, WFDB_Time t) {
+  int i, trem = 0;
+  long nb, tt;
+  struct igdata *ig;
+  WFDB_Signal s;
+  unsigned int b, d = 1, n, nn, j;
+
+  /* Do nothing if there is no more than one input signal group and
+     the input pointer is correct already. */
+  if (nigroup < 2 && istime == t && gvc == ispfmax && igd[g]->start == 0)
+    return (0);
+
+  /* Find the first signal that belongs to group g. */
+  for (s = 0; s < nisig && g != isd[s]->info.group; s++)
+    ;
+  if (s == nisig) {
+    wfdb_error("isgsettime: incorrect signal group number %d\n", g);
+    return (-2);
+  }
+
+  /* Mark the contents of the deskewing buffer (if any) as invalid. */
+  dsbi = -1;
+
+  /* If the current record contains multiple segments, locate the segment
+     containing the desired sample. */
+  if (in_msrec) {
+    WFDB_Seginfo *tseg = segp;
+    WFDB_Group h;
+
+    if (t >= msnsamples) {
+      wfdb_error("isigsettime: improper seek on signal group %d\n", g);
+      return (-1);
+    }
+    if (t < tseg->samp0 || t >= tseg->samp0 + tseg->nsamp) tseg = segfind(t);
+    if (segp != tseg) {
+      segp = tseg;
+      if (isigopen(segp->recname, NULL, (int)nvsig) <= 0) {
+        wfdb_error("isigsettime: can't open segment %s\n", segp->recname);
+        return (-1);
+      }
+      /* Following isigopen(), nigroup may have changed and
+         group numbers may not make any sense anymore.  However,
+         isigsettime() will still call isgsettime() once for
+         each non-zero group (if the previous segment had
+         multiple groups) and then once for group zero.
+
+         Calling isgsetframe() multiple times for a non-zero
+         group is mostly harmless, but seeking on group 0 should
+         only be done once.  Thus, when we jump to a new
+         segment, implicitly seek on all non-zero groups
+         (regardless of g), but only seek on group 0 if g is 0.
+
+         (Note that isgsettime() is not and has never been fully
+         functional for multi-segment records, because it cannot
+         read signals from two different segments at once.) */
+      for (h = 1; h < nigroup; h++)
+        if (i = isgsetframe(h, t)) return (i);
+      if (g == 0)
+        return (isgsetframe(0, t));
+      else
+        return (0);
+    }
+    t -= segp->samp0;
+  }
+
+  ig = igd[g];
+  /* Determine the number of samples per frame for signals in the group. */
+  for (n = nn = 0; s + n < nisig && isd[s + n]->info.group == g; n++)
+    nn += isd[s + n]->info.spf;
+  /* Determine the number of bytes per sample interval in the file. */
+  switch (isd[s]->info.fmt) {
+    case 0:
+      if (t < nsamples) {
+        gvc = ispfmax;
+        if (s == 0) istime = (in_msrec) ? t + segp->samp0 : t;
+        isd[s]->info.nsamp = nsamples - t;
+        ig->stat = 1;
+        return (0);
+      } else {
+        if (s == 0) istime = (in_msrec) ? msnsamples : nsamples;
+        isd[s]->info.nsamp = 0L;
+        return (-1);
+      }
+    case 8:
+    case 80:
+    default:
+      b = nn;
+      break;
+    case 16:
+    case 61:
+    case 160:
+      if (nn > UINT_MAX / 2) {
+        wfdb_error("isigsettime: overflow in signal group %d\n", g);
+        return (-1);
+      }
+      b = 2 * nn;
+      break;
+    case 212:
+      if (nn > UINT_MAX / 3) {
+        wfdb_error("isigsettime: overflow in signal group %d\n", g);
+        return (-1);
+      }
+      /* Reset the input counter. */
+      ig->count = 0;
+      /* If the desired sample does not lie on a byte boundary, seek to
+         the previous sample and then read ahead. */
+      if ((nn & 1) && (t & 1)) {
+        if (in_msrec) t += segp->samp0; /* restore absolute time */
+        if (i = isgsetframe(g, t - 1)) return (i);
+        for (j = 0; j < nn; j++) (void)r212(ig);
+        istime++;
+        for (n = 0; s + n < nisig && isd[s + n]->info.group == g; n++)
+          isd[s + n]->info.nsamp = (WFDB_Time)0L;
+        return (0);
+      }
+      b = 3 * nn;
+      d = 2;
+      break;
+    case 310:
+      if (nn > UINT_MAX / 4) {
+        wfdb_error("isigsettime: overflow in signal group %d\n", g);
+        return (-1);
+      }
+      /* Reset the input counter. */
+      ig->count = 0;
+      /* If the desired sample does not lie on a byte boundary, seek to
+         the closest previous sample that does, then read ahead. */
       if ((nn % 3) && (trem = (t % 3))) {
         if (in_msrec) t += segp->samp0; /* restore absolute time */
         if (i = isgsetframe(g, t - trem)) return (i);
@@ -1833,216 +3652,1605 @@ static int isgsetframe(WFDB_Group g, WFDB_Time t) {
       }
       b = 4 * nn;
       break;
+    case CZFMT:
+      /* Decode the block that contains the desired frame. */
+      if (czseek(ig, t)) {
+        wfdb_error("isigsettime: improper seek on signal group %d\n", g);
+        return (-1);
+      }
+      gvc = ispfmax;
+      if (s == 0) istime = in_msrec ? t + segp->samp0 : t;
+      while (n-- != 0) isd[s + n]->info.nsamp = (WFDB_Time)0L;
+      return (0);
   }
 
-  if (t > (LONG_MAX / b) || ((long)(t * b)) / d > (LONG_MAX - ig->start)) {
-    wfdb_error("isigsettime: improper seek on signal group %d\n", g);
-    return (-1);
+  if (t > (LONG_MAX / b) || ((long)(t * b)) / d > (LONG_MAX - ig->start)) {
+    wfdb_error("isigsettime: improper seek on signal group %d\n", g);
+    return (-1);
+  }
+
+  /* For mapped files, simply point into the mapping. */
+  if (ig->fp->type == FileType::kMapped) {
+    tt = t * b;
+    nb = tt / d + ig->start;
+    if (nb > ig->fp->maplen) {
+      wfdb_error("isigsettime: improper seek on signal group %d\n", g);
+      return (-1);
+    }
+    ig->be = (char *)ig->fp->map + ig->fp->maplen;
+    ig->bp = (char *)ig->fp->map + nb;
+    nb = 0;
+  }
+  /* Seek to the beginning of the block which contains the desired sample.
+     For normal files, use fseek() to do so, unless the block is to be read by
+     offset (see iblock). */
+  else if (ig->seek) {
+    tt = t * b;
+    nb = tt / d + ig->start;
+    if ((i = ig->bsize) == 0) i = ibsize;
+    /* Seek to a position such that the next block read will contain the
+       desired sample. */
+    tt = nb / i;
+    if (ig->ir) { /* discard blocks read ahead, and read ahead from here */
+      irpause(ig);
+      (void)wfdb_fadvise(ig->fp, tt * i, (long)i * (ig->ir->nfree + 1));
+    }
+    if (ig->rpos >= 0) /* the next block is read by offset */
+      ig->rpos = (int64_t)tt * i;
+    else if (wfdb_fseek(ig->fp, tt * i, 0)) {
+      wfdb_error("isigsettime: improper seek on signal group %d\n", g);
+      return (-1);
+    }
+    nb %= i;
+  }
+  /* For special files, rewind if necessary and then read ahead. */
+  else {
+    WFDB_Time t0, t1;
+
+    /* Get the time of the earliest buffered sample ... */
+    t0 = istime - (ig->bp - ig->buf) / b;
+    /* ... and that of the earliest unread sample. */
+    t1 = t0 + (ig->be - ig->buf) / b;
+    /* There are three possibilities:  either the desired sample has been
+       read and has passed out of the buffer, requiring a rewind ... */
+    if (t < t0) {
+      if (wfdb_fseek(ig->fp, 0L, 0)) {
+        wfdb_error("isigsettime: improper seek on signal group %d\n", g);
+        return (-1);
+      }
+      tt = t * b;
+      nb = tt / d + ig->start;
+    }
+    /* ... or it is in the buffer already ... */
+    else if (t < t1) {
+      tt = (t - t0) * b;
+      ig->bp = ig->buf + tt / d;
+      return (0);
+    }
+    /* ... or it has not yet been read. */
+    else {
+      tt = (t - t1) * b;
+      nb = tt / d;
+    }
+    while (nb > ig->bsize && !wfdb_feof(ig->fp))
+      nb -= wfdb_fread(ig->buf, 1, ig->bsize, ig->fp);
+  }
+
+  /* Reset the block pointer to indicate nothing has been read in the
+     current block (unless the file is mapped, in which case the block
+     pointer has been set already). */
+  if (ig->fp->type != FileType::kMapped) ig->bp = ig->be;
+  ig->stat = 1;
+  /* Read any bytes in the current block that precede the desired sample. */
+  while (nb-- > 0 && ig->stat > 0) i = r8(ig);
+  if (ig->stat <= 0) return (-1);
+
+  /* Reset the getvec sample-within-frame counter. */
+  gvc = ispfmax;
+
+  /* Reset the time (if signal 0 belongs to the group) and disable checksum
+     testing (by setting the number of samples remaining to 0). */
+  if (s == 0) istime = in_msrec ? t + segp->samp0 : t;
+  while (n-- != 0) isd[s + n]->info.nsamp = (WFDB_Time)0L;
+  return (0);
+}
+
+/* VFILL provides the value returned by getskewedframe() for a missing or
+   invalid sample */
+#define VFILL ((gvmode & WFDB_GVPAD) ? is->samp : WFDB_INVALID_SAMPLE)
+
+/* Frame decoders
+
+   Since the format and layout of a signal group do not change while it is
+   open, isgselect chooses a decoder for each group (when the group is opened,
+   and again if the getvec mode changes) from a set of specialized versions
+   of isgframe.  Each of these reads one frame of a group's samples, with the
+   format, the number of signals (for groups with one sample per signal per
+   frame, and up to 16 signals), and the treatment of invalid samples fixed at
+   compile time, so that the inner loop contains no tests of these.
+   getskewedframe uses a group's decoder whenever the group's input buffer
+   contains at least a full frame, so that no end-of-file tests are needed
+   either;  otherwise, it falls back to the general code. */
+
+/* rsamp<F>(g) reads the next sample of format F from g->bp, which must not
+   reach g->be.  It returns exactly what the corresponding r*() function or
+   macro would (the first difference, in the case of format 8). */
+template <int F>
+static inline int rsamp(struct igdata *g);
+
+template <>
+inline int rsamp<8>(struct igdata *g) {
+  return (*(g->bp++));
+}
+
+template <>
+inline int rsamp<16>(struct igdata *g) {
+  const unsigned char *p = (const unsigned char *)g->bp;
+
+  g->bp += 2;
+  return ((short)(p[0] | p[1] << 8));
+}
+
+template <>
+inline int rsamp<61>(struct igdata *g) {
+  const unsigned char *p = (const unsigned char *)g->bp;
+
+  g->bp += 2;
+  return ((short)(p[0] << 8 | p[1]));
+}
+
+template <>
+inline int rsamp<80>(struct igdata *g) {
+  return ((*(g->bp++) & 0xff) - (1 << 7));
+}
+
+template <>
+inline int rsamp<160>(struct igdata *g) {
+  const unsigned char *p = (const unsigned char *)g->bp;
+
+  g->bp += 2;
+  return ((p[0] | p[1] << 8) - (1 << 15));
+}
+
+template <>
+inline int rsamp<212>(struct igdata *g) {
+  return (r212(g));
+}
+
+template <>
+inline int rsamp<310>(struct igdata *g) {
+  return (r310(g));
+}
+
+template <>
+inline int rsamp<311>(struct igdata *g) {
+  return (r311(g));
+}
+
+template <>
+inline int rsamp<24>(struct igdata *g) {
+  const unsigned char *p = (const unsigned char *)g->bp;
+
+  g->bp += 3;
+  return (((int)((unsigned)(p[0] | p[1] << 8 | p[2] << 16) << 8)) >> 8);
+}
+
+template <>
+inline int rsamp<32>(struct igdata *g) {
+  const unsigned char *p = (const unsigned char *)g->bp;
+
+  g->bp += 4;
+  return ((int)(p[0] | p[1] << 8 | p[2] << 16 | (unsigned)p[3] << 24));
+}
+
+/* sentinel(F) is the value that marks an invalid sample in a format F signal
+   file (0 for format 8, which has none), and fsize(F) is the largest number
+   of bytes read for any one sample. */
+static constexpr int sentinel(int f) {
+  return (f == 80 ? -(1 << 7) : f == 212 ? -(1 << 11)
+          : (f == 310 || f == 311) ? -(1 << 9) : f == 24 ? -(1 << 23)
+          : f == 32 ? INT_MIN : f == 8 ? 0 : -(1 << 15));
+}
+
+static constexpr unsigned fsize(int f) {
+  return (f == 8 || f == 80 ? 1 : f == 24 ? 3 : f == 32 ? 4 : 2);
+}
+
+/* isgframe<F, N, PAD> decodes a frame of group g into vector.  N is the
+   number of signals in the group if each has one sample per frame, or 0
+   otherwise;  PAD is true if invalid samples are to be replaced by the
+   previous valid samples (WFDB_GVPAD mode).  The return value is 0, or -4 if
+   a checksum error was detected. */
+template <int F, unsigned N, bool PAD>
+static int isgframe(struct igdata *g, WFDB_Sample *vector) {
+  struct isdata **isp = isd + g->sig0, *is;
+  unsigned i, c, n = N ? N : g->nsig, spf;
+  int stat = 0;
+  WFDB_Sample v;
+
+  for (i = 0; i < n; i++) {
+    is = isp[i];
+    spf = N ? 1 : is->info.spf;
+    for (c = 0; c < spf; c++) {
+      v = rsamp<F>(g);
+      if (F == 8)
+        *vector++ = v = is->samp += v;
+      else if (v == sentinel(F))
+        *vector++ = PAD ? is->samp : WFDB_INVALID_SAMPLE;
+      else
+        *vector++ = is->samp = v;
+      is->info.cksum -= v;
+    }
+    if (is->info.nsamp >= 0 && --is->info.nsamp == 0 &&
+        (is->info.cksum & 0xffff) && !in_msrec && !isedf) {
+      wfdb_error("getvec: checksum error in signal %d\n", g->sig0 + i);
+      stat = -4;
+    }
+  }
+  return (stat);
+}
+
+typedef int (*isgdecoder)(struct igdata *g, WFDB_Sample *vector);
+
+/* isgpick<F, PAD> returns the decoder for a group of n signals in format F,
+   given the total number of samples per frame, spf. */
+template <int F, bool PAD>
+static isgdecoder isgpick(unsigned n, unsigned spf) {
+  if (spf == n) switch (n) {
+      case 1:
+        return (isgframe<F, 1, PAD>);
+      case 2:
+        return (isgframe<F, 2, PAD>);
+      case 3:
+        return (isgframe<F, 3, PAD>);
+      case 4:
+        return (isgframe<F, 4, PAD>);
+      case 8:
+        return (isgframe<F, 8, PAD>);
+      case 12:
+        return (isgframe<F, 12, PAD>);
+      case 16:
+        return (isgframe<F, 16, PAD>);
+    }
+  return (isgframe<F, 0, PAD>);
+}
+
+template <bool PAD>
+static isgdecoder isgpick(int fmt, unsigned n, unsigned spf) {
+  switch (fmt) {
+    case 8:
+      return (isgpick<8, PAD>(n, spf));
+    case 16:
+      return (isgpick<16, PAD>(n, spf));
+    case 61:
+      return (isgpick<61, PAD>(n, spf));
+    case 80:
+      return (isgpick<80, PAD>(n, spf));
+    case 160:
+      return (isgpick<160, PAD>(n, spf));
+    case 212:
+      return (isgpick<212, PAD>(n, spf));
+    case 310:
+      return (isgpick<310, PAD>(n, spf));
+    case 311:
+      return (isgpick<311, PAD>(n, spf));
+    case 24:
+      return (isgpick<24, PAD>(n, spf));
+    case 32:
+      return (isgpick<32, PAD>(n, spf));
+    default:
+      return (NULL);
+  }
+}
+
+/* isgselect chooses the frame decoder for each open input signal group.
+   Null signals (format 0), and any group whose signals do not all have the
+   same format, are always read by the general code. */
+static void isgselect(void) {
+  WFDB_Group g;
+  WFDB_Signal s;
+  struct igdata *ig;
+
+  for (g = 0; g < nigroup; g++) {
+    ig = igd[g];
+    ig->decode = NULL;
+    if (ig->nsig == 0 || ig->sig0 + ig->nsig > nisig)
+      continue; /* layout not yet known (see isigopen) */
+    for (s = ig->sig0; s < ig->sig0 + ig->nsig; s++)
+      if (isd[s]->info.fmt != (ig->cz ? CZFMT : ig->fmt)) break;
+    if (s < ig->sig0 + ig->nsig) continue; /* mixed formats */
+    if (gvmode & WFDB_GVPAD)
+      ig->decode = isgpick<true>(ig->fmt, ig->nsig, ig->spf);
+    else
+      ig->decode = isgpick<false>(ig->fmt, ig->nsig, ig->spf);
+    ig->fbytes = fsize(ig->fmt) * ig->spf;
+  }
+}
+
+static int getskewedframe(WFDB_Sample *vector) {
+  int c, stat;
+  struct isdata *is;
+  struct igdata *ig;
+  WFDB_Group g;
+  WFDB_Sample v, *vecstart = vector;
+  WFDB_Signal s;
+
+  if ((stat = (int)nisig) == 0) return (nvsig > 0 ? -1 : 0);
+  if (istime == 0L) {
+    for (s = 0; s < nisig; s++) isd[s]->samp = isd[s]->info.initval;
+    for (g = nigroup; g;) {
+      /* Go through groups in reverse order since seeking on group 0
+         should always be done last. */
+      if (--g == 0 || igd[g]->start > 0L) (void)isgsetframe(g, 0L);
+    }
+  }
+
+  /* If the vector needs to be rearranged (variable-layout record),
+     then read samples into a temporary buffer. */
+  if (need_sigmap) vector = ovec;
+
+  for (g = 0; g < nigroup; g++) {
+    ig = igd[g];
+    /* Use the group's frame decoder if a full frame is in the buffer. */
+    if (ig->decode && ig->be - ig->bp >= (long)ig->fbytes) {
+      if ((*ig->decode)(ig, vector) < 0) stat = -4;
+      vector += ig->spf;
+      continue;
+    }
+    for (s = ig->sig0; s < ig->sig0 + ig->nsig; s++) {
+      is = isd[s];
+      for (c = 0; c < is->info.spf; c++, vector++) {
+        switch (is->info.fmt) {
+          case 0: /* null signal: return sample tagged as invalid */
+            *vector = v = VFILL;
+            if (is->info.nsamp == 0) ig->stat = -1;
+            break;
+          case 8: /* 8-bit first differences */
+          default:
+            *vector = v = is->samp += r8(ig);
+            break;
+          case 16: /* 16-bit amplitudes */
+            *vector = v = r16(ig);
+            if (v == -1 << 15)
+              *vector = VFILL;
+            else
+              is->samp = *vector;
+            break;
+          case 61: /* 16-bit amplitudes, bytes swapped */
+            *vector = v = r61(ig);
+            if (v == -1 << 15)
+              *vector = VFILL;
+            else
+              is->samp = *vector;
+            break;
+          case 80: /* 8-bit offset binary amplitudes */
+            *vector = v = r80(ig);
+            if (v == -1 << 7)
+              *vector = VFILL;
+            else
+              is->samp = *vector;
+            break;
+          case 160: /* 16-bit offset binary amplitudes */
+            *vector = v = r160(ig);
+            if (v == -1 << 15)
+              *vector = VFILL;
+            else
+              is->samp = *vector;
+            break;
+          case 212: /* 2 12-bit amplitudes bit-packed in 3 bytes */
+            *vector = v = r212(ig);
+            if (v == -1 << 11)
+              *vector = VFILL;
+            else
+              is->samp = *vector;
+            break;
+          case 310: /* 3 10-bit amplitudes bit-packed in 4 bytes */
+            *vector = v = r310(ig);
+            if (v == -1 << 9)
+              *vector = VFILL;
+            else
+              is->samp = *vector;
+            break;
+          case 311: /* 3 10-bit amplitudes bit-packed in 4 bytes */
+            *vector = v = r311(ig);
+            if (v == -1 << 9)
+              *vector = VFILL;
+            else
+              is->samp = *vector;
+            break;
+          case 24: /* 24-bit amplitudes */
+            *vector = v = r24(ig);
+            if (v == -1 << 23)
+              *vector = VFILL;
+            else
+              is->samp = *vector;
+            break;
+          case 32:    /* 32-bit amplitudes */
+          case CZFMT: /* compressed (decoded by czblock) */
+            *vector = v = r32(ig);
+            if (v == -1 << 31)
+              *vector = VFILL;
+            else
+              is->samp = *vector;
+            break;
+        }
+        if (ig->stat <= 0) {
+          /* End of file -- reset input counter. */
+          ig->count = 0;
+          if (is->info.nsamp > (WFDB_Time)0L) {
+            wfdb_error("getvec: unexpected EOF in signal %d\n", s);
+            stat = -3;
+          } else if (in_msrec && segp && segp < segend) {
+            segp++;
+            if (isigopen(segp->recname, NULL, (int)nvsig) <= 0) {
+              wfdb_error("getvec: error opening segment %s\n",
+                         segp->recname);
+              stat = -3;
+              return (stat); /* avoid looping if segment is bad */
+            } else {
+              istime = segp->samp0;
+              return (getskewedframe(vecstart));
+            }
+          } else
+            stat = -1;
+        }
+        is->info.cksum -= v;
+      }
+      if (is->info.nsamp >= 0 && --is->info.nsamp == 0 &&
+          (is->info.cksum & 0xffff) && !in_msrec && !isedf &&
+          is->info.fmt != 0) {
+        wfdb_error("getvec: checksum error in signal %d\n", s);
+        stat = -4;
+      }
+    }
+  }
+
+  if (need_sigmap)
+    sigmap(vecstart, ovec);
+  else if (framelen != tspf)
+    for (s = framelen; s < tspf; s++) vecstart[s] = WFDB_INVALID_SAMPLE;
+
+  return (stat);
+}
+
+/* Bulk input
+
+   getframes and getvecs (below) read many frames per call.  Whenever every
+   input signal group has one or more complete frames in its input buffer, and
+   no deskewing or signal mapping is needed, the frames are decoded directly
+   from the group buffers, one group at a time, by the functions in this
+   section;  the format dispatch, end-of-file tests, and checksum bookkeeping
+   are done once per block rather than once per sample.  All other frames (the
+   first frame after a seek, frames that straddle a buffer refill, and the
+   final frame of a signal whose checksum must be verified) are read by
+   getframe, so that getframes returns exactly the same samples as repeated
+   calls to getframe would. */
+
+#define BLKLEN 4096 /* maximum number of samples decoded per block */
+
+/* SEXT(V, N) sign-extends the N-bit value V. */
+#define SEXT(V, N) (((int)((unsigned)(V) << (32 - (N)))) >> (32 - (N)))
+
+/* Block decoders for the bit-packed formats
+
+   unpack212, unpack310, and unpack311 decode n complete 3-byte (format 212)
+   or 4-byte (formats 310 and 311) groups of samples from p into out.  They
+   produce exactly the same values as r212, r310, and r311, but without the
+   per-sample state machine.  If the compiler targets a processor with AVX2 or
+   SSE2 instructions, most groups are decoded several at a time using these
+   instructions;  the remaining groups (and all groups, if NOSIMD is defined)
+   are decoded by the portable code that follows. */
+
+#if !defined(NOSIMD) && !defined(__AVX2__) && defined(__SSE2__)
+/* ld32 returns the little-endian 32-bit word beginning at p. */
+static inline int ld32(const unsigned char *p) {
+  return ((int)(p[0] | p[1] << 8 | p[2] << 16 | (unsigned)p[3] << 24));
+}
+#endif
+
+static void unpack212(const unsigned char *p, WFDB_Sample *out, long n) {
+#if !defined(NOSIMD) && defined(__AVX2__)
+  /* Eight groups per iteration.  Each 128-bit lane is loaded with four
+     groups, which are then spread out one per 32-bit element;  since the
+     second lane is loaded from p + 12, 28 bytes (10 groups) must remain. */
+  const __m256i spread =
+      _mm256_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1, 0,
+                       1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+  const __m256i mask = _mm256_set1_epi32(0xf00);
+
+  for (; n >= 10; n -= 8, p += 24, out += 16) {
+    __m256i w = _mm256_inserti128_si256(
+        _mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)p)),
+        _mm_loadu_si128((const __m128i *)(p + 12)), 1);
+    __m256i e, o, lo, hi;
+
+    w = _mm256_shuffle_epi8(w, spread);
+    /* The first sample of each group is in bits 0-11, the second in bits
+       12-15 (high bits) and 16-23 (low bits). */
+    e = _mm256_srai_epi32(_mm256_slli_epi32(w, 20), 20);
+    o = _mm256_or_si256(_mm256_and_si256(_mm256_srli_epi32(w, 4), mask),
+                        _mm256_srli_epi32(w, 16));
+    o = _mm256_srai_epi32(_mm256_slli_epi32(o, 20), 20);
+    lo = _mm256_unpacklo_epi32(e, o);
+    hi = _mm256_unpackhi_epi32(e, o);
+    _mm256_storeu_si256((__m256i *)out,
+                        _mm256_permute2x128_si256(lo, hi, 0x20));
+    _mm256_storeu_si256((__m256i *)(out + 8),
+                        _mm256_permute2x128_si256(lo, hi, 0x31));
+  }
+#elif !defined(NOSIMD) && defined(__SSE2__)
+  /* Four groups per iteration, one per 32-bit element.  The last group is
+     loaded as a 32-bit word, so 13 bytes (5 groups) must remain. */
+  const __m128i mask = _mm_set1_epi32(0xf00), mask2 = _mm_set1_epi32(0xff);
+
+  for (; n >= 5; n -= 4, p += 12, out += 8) {
+    __m128i w = _mm_setr_epi32(ld32(p), ld32(p + 3), ld32(p + 6), ld32(p + 9));
+    __m128i e, o;
+
+    e = _mm_srai_epi32(_mm_slli_epi32(w, 20), 20);
+    o = _mm_or_si128(_mm_and_si128(_mm_srli_epi32(w, 4), mask),
+                     _mm_and_si128(_mm_srli_epi32(w, 16), mask2));
+    o = _mm_srai_epi32(_mm_slli_epi32(o, 20), 20);
+    _mm_storeu_si128((__m128i *)out, _mm_unpacklo_epi32(e, o));
+    _mm_storeu_si128((__m128i *)(out + 4), _mm_unpackhi_epi32(e, o));
+  }
+#endif
+  for (; n > 0; n--, p += 3, out += 2) {
+    out[0] = SEXT(p[0] | (p[1] & 0x0f) << 8, 12);
+    out[1] = SEXT((p[1] & 0xf0) << 4 | p[2], 12);
+  }
+}
+
+#if !defined(NOSIMD) && defined(__AVX2__)
+/* interleave3 stores the elements of a, b, and c in out in the order
+   a0, b0, c0, a1, b1, c1, ... a7, b7, c7. */
+static inline void interleave3(__m256i a, __m256i b, __m256i c,
+                               WFDB_Sample *out) {
+  const __m256i i0 = _mm256_setr_epi32(0, 0, 0, 1, 1, 1, 2, 2);
+  const __m256i i1 = _mm256_setr_epi32(2, 3, 3, 3, 4, 4, 4, 5);
+  const __m256i i2 = _mm256_setr_epi32(5, 5, 6, 6, 6, 7, 7, 7);
+
+  _mm256_storeu_si256(
+      (__m256i *)out,
+      _mm256_blend_epi32(
+          _mm256_blend_epi32(_mm256_permutevar8x32_epi32(a, i0),
+                             _mm256_permutevar8x32_epi32(b, i0), 0x92),
+          _mm256_permutevar8x32_epi32(c, i0), 0x24));
+  _mm256_storeu_si256(
+      (__m256i *)(out + 8),
+      _mm256_blend_epi32(
+          _mm256_blend_epi32(_mm256_permutevar8x32_epi32(a, i1),
+                             _mm256_permutevar8x32_epi32(b, i1), 0x24),
+          _mm256_permutevar8x32_epi32(c, i1), 0x49));
+  _mm256_storeu_si256(
+      (__m256i *)(out + 16),
+      _mm256_blend_epi32(
+          _mm256_blend_epi32(_mm256_permutevar8x32_epi32(a, i2),
+                             _mm256_permutevar8x32_epi32(b, i2), 0x49),
+          _mm256_permutevar8x32_epi32(c, i2), 0x92));
+}
+#elif !defined(NOSIMD) && defined(__SSE2__)
+/* interleave3 stores the elements of a, b, and c in out in the order
+   a0, b0, c0, a1, b1, c1, ... a3, b3, c3. */
+static inline void interleave3(__m128i a, __m128i b, __m128i c,
+                               WFDB_Sample *out) {
+  __m128i t0 = _mm_unpacklo_epi32(a, b); /* a0 b0 a1 b1 */
+  __m128i t1 = _mm_unpackhi_epi32(a, b); /* a2 b2 a3 b3 */
+  __m128i u0 = _mm_unpacklo_epi32(c, _mm_srli_si128(t0, 8)); /* c0 a1 c1 b1 */
+  __m128i u1 = _mm_unpackhi_epi32(c, t1);                    /* c2 a3 c3 b3 */
+
+  _mm_storeu_si128((__m128i *)out,
+                   _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(t0),
+                                                   _mm_castsi128_ps(u0),
+                                                   _MM_SHUFFLE(1, 0, 1, 0))));
+  _mm_storeu_si128((__m128i *)(out + 4),
+                   _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(u0),
+                                                   _mm_castsi128_ps(t1),
+                                                   _MM_SHUFFLE(1, 0, 2, 3))));
+  _mm_storeu_si128((__m128i *)(out + 8),
+                   _mm_shuffle_epi32(u1, _MM_SHUFFLE(2, 3, 1, 0)));
+}
+#endif
+
+static void unpack310(const unsigned char *p, WFDB_Sample *out, long n) {
+#if !defined(NOSIMD) && defined(__AVX2__)
+  const __m256i mask = _mm256_set1_epi32(0x1f);
+
+  for (; n >= 8; n -= 8, p += 32, out += 24) {
+    __m256i w = _mm256_loadu_si256((const __m256i *)p), c;
+
+    c = _mm256_or_si256(_mm256_and_si256(_mm256_srli_epi32(w, 11), mask),
+                        _mm256_slli_epi32(_mm256_srli_epi32(w, 27), 5));
+    interleave3(_mm256_srai_epi32(_mm256_slli_epi32(w, 21), 22),
+                _mm256_srai_epi32(_mm256_slli_epi32(w, 5), 22),
+                _mm256_srai_epi32(_mm256_slli_epi32(c, 22), 22), out);
+  }
+#elif !defined(NOSIMD) && defined(__SSE2__)
+  const __m128i mask = _mm_set1_epi32(0x1f);
+
+  for (; n >= 4; n -= 4, p += 16, out += 12) {
+    __m128i w = _mm_loadu_si128((const __m128i *)p), c;
+
+    c = _mm_or_si128(_mm_and_si128(_mm_srli_epi32(w, 11), mask),
+                     _mm_slli_epi32(_mm_srli_epi32(w, 27), 5));
+    interleave3(_mm_srai_epi32(_mm_slli_epi32(w, 21), 22),
+                _mm_srai_epi32(_mm_slli_epi32(w, 5), 22),
+                _mm_srai_epi32(_mm_slli_epi32(c, 22), 22), out);
+  }
+#endif
+  for (; n > 0; n--, p += 4, out += 3) {
+    out[0] = SEXT((p[0] | p[1] << 8) >> 1, 10);
+    out[1] = SEXT((p[2] | p[3] << 8) >> 1, 10);
+    out[2] = SEXT(p[1] >> 3 | (p[3] & 0xf8) << 2, 10);
+  }
+}
+
+static void unpack311(const unsigned char *p, WFDB_Sample *out, long n) {
+#if !defined(NOSIMD) && defined(__AVX2__)
+  for (; n >= 8; n -= 8, p += 32, out += 24) {
+    __m256i w = _mm256_loadu_si256((const __m256i *)p);
+
+    interleave3(_mm256_srai_epi32(_mm256_slli_epi32(w, 22), 22),
+                _mm256_srai_epi32(_mm256_slli_epi32(w, 12), 22),
+                _mm256_srai_epi32(_mm256_slli_epi32(w, 2), 22), out);
+  }
+#elif !defined(NOSIMD) && defined(__SSE2__)
+  for (; n >= 4; n -= 4, p += 16, out += 12) {
+    __m128i w = _mm_loadu_si128((const __m128i *)p);
+
+    interleave3(_mm_srai_epi32(_mm_slli_epi32(w, 22), 22),
+                _mm_srai_epi32(_mm_slli_epi32(w, 12), 22),
+                _mm_srai_epi32(_mm_slli_epi32(w, 2), 22), out);
+  }
+#endif
+  for (; n > 0; n--, p += 4, out += 3) {
+    out[0] = SEXT(p[0] | p[1] << 8, 10);
+    out[1] = SEXT(p[1] >> 2 | p[2] << 6, 10);
+    out[2] = SEXT(p[2] >> 4 | p[3] << 4, 10);
+  }
+}
+
+/* isgunit: return the length in bytes of the shortest run of frames from a
+   signal group (with format fmt and nn samples per frame) that begins and
+   ends on byte boundaries in the signal file, and set *nf to the number of
+   frames in the run.  The result is zero for null signals. */
+static unsigned isgunit(int fmt, unsigned nn, unsigned *nf) {
+  *nf = 1;
+  if (nn > UINT_MAX / 12) return (0); /* too large to be worth handling */
+  switch (fmt) {
+    case 0:
+      return (0);
+    case 8:
+    case 80:
+    default:
+      return (nn);
+    case 16:
+    case 61:
+    case 160:
+      return (2 * nn);
+    case 24:
+      return (3 * nn);
+    case 32:
+      return (4 * nn);
+    case 212:
+      if (nn & 1) *nf = 2;
+      return (3 * nn * *nf / 2);
+    case 310:
+    case 311:
+      if (nn % 3) *nf = 3;
+      return (4 * nn * *nf / 3);
+  }
+}
+
+/* isgframes: return the number of frames of a signal group that can be
+   decoded from its input buffer without refilling it. */
+static long isgframes(const struct igdata *ig) {
+  if (ig->ubytes == 0 || ig->count != 0 || ig->stat <= 0) return (0);
+  return ((ig->be - ig->bp) / ig->ubytes * ig->uframes);
+}
+
+/* isgunpack: decode the next m samples of a signal group, all of which must
+   be present in its input buffer, into out.  The samples are not checked for
+   validity, and format 8 samples are returned as first differences. */
+static void isgunpack(struct igdata *ig, WFDB_Sample *out, long m) {
+  const unsigned char *p;
+  long i = 0;
+
+  /* Finish any partially-read run of bit-packed samples. */
+  for (; ig->count != 0 && i < m; i++)
+    out[i] = (ig->fmt == 212)   ? r212(ig)
+             : (ig->fmt == 310) ? r310(ig)
+                                : r311(ig);
+
+  p = (const unsigned char *)ig->bp;
+  switch (ig->fmt) {
+    case 8:
+    default:
+      for (; i < m; i++) out[i] = (signed char)*p++;
+      break;
+    case 16:
+      for (; i < m; i++, p += 2) out[i] = (short)(p[0] | p[1] << 8);
+      break;
+    case 61:
+      for (; i < m; i++, p += 2) out[i] = (short)(p[0] << 8 | p[1]);
+      break;
+    case 80:
+      for (; i < m; i++) out[i] = *p++ - (1 << 7);
+      break;
+    case 160:
+      for (; i < m; i++, p += 2) out[i] = (p[0] | p[1] << 8) - (1 << 15);
+      break;
+    case 24:
+      for (; i < m; i++, p += 3)
+        out[i] = SEXT(p[0] | p[1] << 8 | p[2] << 16, 24);
+      break;
+    case 32:
+      for (; i < m; i++, p += 4)
+        out[i] = (int)(p[0] | p[1] << 8 | p[2] << 16 | (unsigned)p[3] << 24);
+      break;
+    case 212:
+      unpack212(p, out + i, (m - i) / 2);
+      p += 3 * ((m - i) / 2);
+      i += 2 * ((m - i) / 2);
+      break;
+    case 310:
+      unpack310(p, out + i, (m - i) / 3);
+      p += 4 * ((m - i) / 3);
+      i += 3 * ((m - i) / 3);
+      break;
+    case 311:
+      unpack311(p, out + i, (m - i) / 3);
+      p += 4 * ((m - i) / 3);
+      i += 3 * ((m - i) / 3);
+      break;
+  }
+  ig->bp = (char *)p;
+
+  /* Begin a new run of bit-packed samples if any remain to be read. */
+  for (; i < m; i++)
+    out[i] = (ig->fmt == 212)   ? r212(ig)
+             : (ig->fmt == 310) ? r310(ig)
+                                : r311(ig);
+}
+
+/* isggather: decode the samples in columns col[0], ..., col[ncol-1] (their
+   positions within the group's frames) of the next m frames of a signal group,
+   all of which must be present in its input buffer, into out, in which the
+   frames are ig->spf samples apart.  The other samples in out are not set.  As
+   for isgunpack, the group must not be part way through a run of bit-packed
+   samples, and m must be a multiple of ig->uframes, so that only the bytes
+   that hold the selected samples need be examined. */
+static void isggather(struct igdata *ig, WFDB_Sample *out, long m,
+                      const unsigned *col, unsigned ncol) {
+  const unsigned char *p = (const unsigned char *)ig->bp, *q;
+  unsigned i, spf = ig->spf;
+  long f, k;
+  WFDB_Sample *o;
+
+  for (i = 0; i < ncol; i++) {
+    o = out + col[i];
+    k = col[i]; /* index of the sample within the run */
+    switch (ig->fmt) {
+      case 8:
+      default:
+        for (f = 0, q = p + k; f < m; f++, q += spf, o += spf)
+          *o = (signed char)*q;
+        break;
+      case 16:
+        for (f = 0, q = p + 2 * k; f < m; f++, q += 2 * spf, o += spf)
+          *o = (short)(q[0] | q[1] << 8);
+        break;
+      case 61:
+        for (f = 0, q = p + 2 * k; f < m; f++, q += 2 * spf, o += spf)
+          *o = (short)(q[0] << 8 | q[1]);
+        break;
+      case 80:
+        for (f = 0, q = p + k; f < m; f++, q += spf, o += spf)
+          *o = *q - (1 << 7);
+        break;
+      case 160:
+        for (f = 0, q = p + 2 * k; f < m; f++, q += 2 * spf, o += spf)
+          *o = (q[0] | q[1] << 8) - (1 << 15);
+        break;
+      case 24:
+        for (f = 0, q = p + 3 * k; f < m; f++, q += 3 * spf, o += spf)
+          *o = SEXT(q[0] | q[1] << 8 | q[2] << 16, 24);
+        break;
+      case 32:
+        for (f = 0, q = p + 4 * k; f < m; f++, q += 4 * spf, o += spf)
+          *o = (int)(q[0] | q[1] << 8 | q[2] << 16 | (unsigned)q[3] << 24);
+        break;
+      case 212: /* decode only the needed half of each 3-byte unit */
+        for (f = 0; f < m; f++, k += spf, o += spf) {
+          q = p + 3 * (k >> 1);
+          *o = (k & 1) ? SEXT((q[1] & 0xf0) << 4 | q[2], 12)
+                       : SEXT(q[0] | (q[1] & 0x0f) << 8, 12);
+        }
+        break;
+      case 310: /* decode only the needed third of each 4-byte unit */
+        for (f = 0; f < m; f++, k += spf, o += spf) {
+          q = p + 4 * (k / 3);
+          switch (k % 3) {
+            case 0:
+              *o = SEXT((q[0] | q[1] << 8) >> 1, 10);
+              break;
+            case 1:
+              *o = SEXT((q[2] | q[3] << 8) >> 1, 10);
+              break;
+            default:
+              *o = SEXT(q[1] >> 3 | (q[3] & 0xf8) << 2, 10);
+              break;
+          }
+        }
+        break;
+      case 311:
+        for (f = 0; f < m; f++, k += spf, o += spf) {
+          q = p + 4 * (k / 3);
+          switch (k % 3) {
+            case 0:
+              *o = SEXT(q[0] | q[1] << 8, 10);
+              break;
+            case 1:
+              *o = SEXT(q[1] >> 2 | q[2] << 6, 10);
+              break;
+            default:
+              *o = SEXT(q[2] >> 4 | q[3] << 4, 10);
+              break;
+          }
+        }
+        break;
+    }
+  }
+  ig->bp += m / ig->uframes * ig->ubytes;
+}
+
+/* isgcols: list in cols the columns (positions within the frames of signal
+   group g) of the samples of those signals in sig that belong to the group,
+   each once. */
+static void isgcols(WFDB_Group g, const WFDB_Signal *sig, int nsig,
+                    std::vector<unsigned> &cols) {
+  int i, ii;
+  unsigned c, j;
+  WFDB_Signal s;
+
+  cols.clear();
+  for (i = 0; i < nsig; i++) {
+    if (isd[sig[i]]->info.group != g) continue;
+    for (ii = 0; ii < i && sig[ii] != sig[i]; ii++)
+      ;
+    if (ii < i) continue; /* requested previously */
+    for (j = 0, s = igd[g]->sig0; s < sig[i]; s++) j += isd[s]->info.spf;
+    for (c = 0; c < isd[s]->info.spf; c++) cols.push_back(j + c);
+  }
+}
+
+/* isconvert: convert m frames of signal is, unpacked into in (successive
+   frames of which are spf samples apart), into out (successive frames of which
+   are stride samples apart).  diff is nonzero for a format 8 signal, and
+   vinvalid is the value that marks an invalid sample otherwise. */
+static void isconvert(struct isdata *is, const WFDB_Sample *in, unsigned spf,
+                      long m, WFDB_Sample *out, long stride, int diff,
+                      WFDB_Sample vinvalid) {
+  long i;
+  unsigned c;
+  WFDB_Sample v;
+
+  for (i = 0; i < m; i++, in += spf, out += stride)
+    for (c = 0; c < is->info.spf; c++) {
+      if (diff)
+        out[c] = v = is->samp += in[c];
+      else if ((v = in[c]) == vinvalid)
+        out[c] = VFILL;
+      else
+        out[c] = is->samp = v;
+      is->info.cksum -= v;
+    }
+}
+
+/* iscount: account for m frames of signal is having been read. */
+static void iscount(struct isdata *is, long m) {
+  /* The caller guarantees that a positive nsamp remains positive. */
+  if (is->info.nsamp > 0)
+    is->info.nsamp -= m;
+  else if (is->info.nsamp == 0)
+    is->info.nsamp = -1;
+}
+
+/* isgconvert: convert m frames of a signal group, unpacked by isgunpack into
+   in, into samples in vector, in which the group's first sample in each frame
+   is at out and successive frames are stride samples apart.  out may equal in
+   if stride is the group's frame length.  Invalid samples and checksums are
+   handled as in getskewedframe. */
+static void isgconvert(struct igdata *ig, const WFDB_Sample *in, long m,
+                       WFDB_Sample *out, long stride) {
+  int diff = (ig->fmt == 8);
+  unsigned j;
+  WFDB_Signal s;
+
+  for (s = ig->sig0, j = 0; s < ig->sig0 + ig->nsig; s++) {
+    isconvert(isd[s], in + j, ig->spf, m, out + j, stride, diff,
+              sentinel(ig->fmt));
+    iscount(isd[s], m);
+    j += isd[s]->info.spf;
   }
+}
 
-  /* Seek to the beginning of the block which contains the desired sample.
-     For normal files, use fseek() to do so. */
-  if (ig->seek) {
-    tt = t * b;
-    nb = tt / d + ig->start;
-    if ((i = ig->bsize) == 0) i = ibsize;
-    /* Seek to a position such that the next block read will contain the
-       desired sample. */
-    tt = nb / i;
-    if (wfdb_fseek(ig->fp, tt * i, 0)) {
-      wfdb_error("isigsettime: improper seek on signal group %d\n", g);
-      return (-1);
+/* isgdecode: decode n frames of a signal group, all of which must be present
+   in its input buffer, into vector (an array of frames of stride samples
+   each).  Invalid samples and checksums are handled as in getskewedframe. */
+static void isgdecode(struct igdata *ig, WFDB_Sample *vector, long n,
+                      long stride) {
+  long m;
+
+  while (n > 0) {
+    /* Decode up to BLKLEN samples into blkbuf, then copy them into place. */
+    if ((m = BLKLEN / ig->spf) < 1) m = 1;
+    if (m > n) m = n;
+    if (blkbuflen < m * ig->spf) {
+      SREALLOC(blkbuf, m * ig->spf, sizeof(WFDB_Sample));
+      blkbuflen = m * ig->spf;
     }
-    nb %= i;
+    isgunpack(ig, blkbuf, m * ig->spf);
+    isgconvert(ig, blkbuf, m, vector + ig->fpos, stride);
+    vector += m * stride;
+    n -= m;
   }
-  /* For special files, rewind if necessary and then read ahead. */
-  else {
-    WFDB_Time t0, t1;
+}
 
-    /* Get the time of the earliest buffered sample ... */
-    t0 = istime - (ig->bp - ig->buf) / b;
-    /* ... and that of the earliest unread sample. */
-    t1 = t0 + (ig->be - ig->buf) / b;
-    /* There are three possibilities:  either the desired sample has been
-       read and has passed out of the buffer, requiring a rewind ... */
-    if (t < t0) {
-      if (wfdb_fseek(ig->fp, 0L, 0)) {
-        wfdb_error("isigsettime: improper seek on signal group %d\n", g);
-        return (-1);
-      }
-      tt = t * b;
-      nb = tt / d + ig->start;
+/* isgdeskew: decode n frames of a signal group, all of which must be present
+   in its input buffer, for dsframes.  These are the frames that follow those
+   already read into dsbuf, so that frame i of a signal with skew d is sample
+   i + skewmax - d of the deskewed signal;  it is stored in vector if that is
+   less than n.  The group's last skewmax + 1 frames are also stored in dsbuf,
+   undeskewed, where getframe and dsframes will look for them next. */
+static void isgdeskew(struct igdata *ig, WFDB_Sample *vector, long n) {
+  int diff = (ig->fmt == 8);
+  long d, i, m, k, r = n - 1 - skewmax;
+  unsigned j;
+  struct isdata *is;
+  WFDB_Signal s;
+
+  for (i = 0; i < n; i += m) {
+    if ((m = BLKLEN / ig->spf) < 1) m = 1;
+    if (m > n - i) m = n - i;
+    if (blkbuflen < m * ig->spf) {
+      SREALLOC(blkbuf, m * ig->spf, sizeof(WFDB_Sample));
+      blkbuflen = m * ig->spf;
     }
-    /* ... or it is in the buffer already ... */
-    else if (t < t1) {
-      tt = (t - t0) * b;
-      ig->bp = ig->buf + tt / d;
-      return (0);
+    isgunpack(ig, blkbuf, m * ig->spf);
+    for (s = ig->sig0, j = 0; s < ig->sig0 + ig->nsig; s++) {
+      is = isd[s];
+      d = vsd[s]->skew;
+      /* Frames i through i + k - 1 belong in vector, and the rest in dsbuf. */
+      if ((k = r + 1 + d - i) < 0) k = 0;
+      else if (k > m) k = m;
+      isconvert(is, blkbuf + j, ig->spf, k,
+                vector + (i + skewmax - d) * tspf + ig->fpos + j, tspf, diff,
+                sentinel(ig->fmt));
+      isconvert(is, blkbuf + j + k * ig->spf, ig->spf, m - k,
+                dsbuf + (i + k - r) * tspf + ig->fpos + j, tspf, diff,
+                sentinel(ig->fmt));
+      j += is->info.spf;
     }
-    /* ... or it has not yet been read. */
-    else {
-      tt = (t - t1) * b;
-      nb = tt / d;
+  }
+  for (s = ig->sig0, j = 0; s < ig->sig0 + ig->nsig; s++) {
+    is = isd[s];
+    d = vsd[s]->skew;
+    /* Copy the frames that went into vector but also belong in dsbuf. */
+    for (i = 0; i <= d; i++)
+      memcpy(dsbuf + i * tspf + ig->fpos + j,
+             vector + (n - 1 - d + i) * tspf + ig->fpos + j,
+             is->info.spf * sizeof(WFDB_Sample));
+    iscount(is, n);
+    j += is->info.spf;
+  }
+}
+
+/* dsframes: read n frames of a record with skewed signals into vector, in the
+   same way that n calls of getframe would, but decoding them in blocks as
+   fastframes does.  The deskewing is done by storing each signal's samples
+   directly where they belong in vector, so that no more than skewmax + 1
+   frames are copied in or out of dsbuf.  dsbuf must contain valid data, and n
+   must be greater than skewmax. */
+static void dsframes(WFDB_Sample *vector, long n) {
+  long d, i, k;
+  unsigned j;
+  WFDB_Group g;
+  WFDB_Signal s;
+
+  /* The oldest frame in dsbuf (at dsbi) is the one read for frame istime - 1,
+     so the first skewmax - d samples of a signal with skew d are there. */
+  for (s = 0, j = 0; s < nisig; s++) {
+    d = vsd[s]->skew;
+    for (i = 0; i < skewmax - d; i++) {
+      if ((k = dsbi + (i + 1 + d) * tspf) >= dsblen) k -= dsblen;
+      memcpy(vector + i * tspf + j, dsbuf + k + j,
+             isd[s]->info.spf * sizeof(WFDB_Sample));
     }
-    while (nb > ig->bsize && !wfdb_feof(ig->fp))
-      nb -= wfdb_fread(ig->buf, 1, ig->bsize, ig->fp);
+    j += isd[s]->info.spf;
   }
+  for (g = 0; g < nigroup; g++) isgdeskew(igd[g], vector, n);
+  dsbi = 0;
+}
 
-  /* Reset the block pointer to indicate nothing has been read in the
-     current block. */
-  ig->bp = ig->be;
-  ig->stat = 1;
-  /* Read any bytes in the current block that precede the desired sample. */
-  while (nb-- > 0 && ig->stat > 0) i = r8(ig);
-  if (ig->stat <= 0) return (-1);
+/* Parallel decoding
+
+If more than one decoding thread has been selected using setithreads,
+fastframes gives large blocks of frames of records with two or more input
+signal groups to pdecode, which decodes them in two steps, each of which is
+divided among the threads of a pool shared by all records.  First, each group
+is unpacked and converted separately (see pdgroup) into its own contiguous
+slice of pdbuf;  then the frames are assembled from the slices in runs of
+PDFRAMES (see pdmerge), so that no two threads write into the same part of the
+caller's array.  The worker threads take the indices of a job from prun as
+they become idle, and the calling thread takes its share along with them.
+Since only one job can run at a time, a second thread that calls prun while
+the pool is busy does its job by itself.  Any errors reported using wfdb_error
+during a job are collected in it (see perrors), and reported again by the
+calling thread once prun returns. */
+
+#define PDFRAMES 256 /* frames assembled per index by pdmerge */
+
+struct dpool {
+  std::mutex job;             /* held while a job is running */
+  std::mutex mutex;           /* guards the variables below */
+  std::condition_variable cv; /* notified whenever they change */
+  std::vector<std::thread> threads;
+  void (*f)(void *arg, long i); /* the job, to be done for each i < n */
+  void *arg;
+  long n;
+  std::atomic<long> next; /* next index to be taken */
+  size_t active;          /* number of workers still taking part in the job */
+  unsigned gen;           /* incremented when a new job is posted */
+  int stop;               /* 1 if the workers are to exit */
+  ~dpool() { pstop(); }
+  void pstop(void);
+};
+
+static struct dpool pool;
+
+/* pworker is the body of each of the pool's worker threads, which are started
+   when the pool's generation number is gen. */
+static void pworker(unsigned gen) {
+  std::unique_lock<std::mutex> lock(pool.mutex);
+  long i;
+
+  for (;;) {
+    while (pool.gen == gen && !pool.stop) pool.cv.wait(lock);
+    if (pool.stop) break;
+    gen = pool.gen;
+    lock.unlock();
+    while ((i = pool.next++) < pool.n) (*pool.f)(pool.arg, i);
+    lock.lock();
+    if (--pool.active == 0) pool.cv.notify_all();
+  }
+}
 
-  /* Reset the getvec sample-within-frame counter. */
-  gvc = ispfmax;
+/* pstop stops the worker threads, which must be idle. */
+void dpool::pstop(void) {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stop = 1;
+    cv.notify_all();
+  }
+  for (std::thread &t : threads) t.join();
+  threads.clear();
+  stop = 0;
+}
 
-  /* Reset the time (if signal 0 belongs to the group) and disable checksum
-     testing (by setting the number of samples remaining to 0). */
-  if (s == 0) istime = in_msrec ? t + segp->samp0 : t;
-  while (n-- != 0) isd[s + n]->info.nsamp = (WFDB_Time)0L;
-  return (0);
+/* prun calls f(arg, i) for each i < n, using the pool's worker threads if
+   they are not busy with another job, and returns when all calls are done. */
+static void prun(long n, void (*f)(void *arg, long i), void *arg) {
+  std::unique_lock<std::mutex> job(pool.job, std::try_to_lock);
+  long i;
+
+  if (!job.owns_lock() || pool.threads.empty()) {
+    for (i = 0; i < n; i++) (*f)(arg, i);
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(pool.mutex);
+    pool.f = f;
+    pool.arg = arg;
+    pool.n = n;
+    pool.next = 0;
+    pool.active = pool.threads.size();
+    pool.gen++;
+    pool.cv.notify_all();
+  }
+  while ((i = pool.next++) < n) (*f)(arg, i);
+  std::unique_lock<std::mutex> lock(pool.mutex);
+  while (pool.active > 0) pool.cv.wait(lock);
 }
 
-/* VFILL provides the value returned by getskewedframe() for a missing or
-   invalid sample */
-#define VFILL ((gvmode & WFDB_GVPAD) ? is->samp : WFDB_INVALID_SAMPLE)
+/* perrors holds the error messages produced by the threads that take part in
+   a job (see perrscope), until the calling thread reports them using preport
+   once prun has returned.  (wfdb_error keeps each message for wfdberror in the
+   thread that produced it, where the caller would not find it.) */
+struct perrors {
+  std::mutex mutex;              /* guards msgs */
+  std::vector<std::string> msgs; /* messages not yet reported */
+};
+
+/* A perrscope collects the error messages produced by the calling thread
+   until the end of the enclosing scope, and then adds them to a job's
+   perrors. */
+struct perrscope {
+  explicit perrscope(struct perrors *e) : errs(e) {
+    prev = wfdb_errcollect(&msgs);
+  }
+  ~perrscope() {
+    wfdb_errcollect(prev);
+    if (msgs.empty()) return;
+    std::lock_guard<std::mutex> lock(errs->mutex);
+    errs->msgs.insert(errs->msgs.end(), msgs.begin(), msgs.end());
+  }
+  perrscope(const perrscope &) = delete;
+  perrscope &operator=(const perrscope &) = delete;
+
+  struct perrors *errs;
+  std::vector<std::string> msgs, *prev;
+};
+
+/* preport reports the error messages collected during a job, in the calling
+   thread. */
+static void preport(struct perrors *e) {
+  for (const std::string &msg : e->msgs) wfdb_error(msg);
+  e->msgs.clear();
+}
 
-static int getskewedframe(WFDB_Sample *vector) {
-  int c, stat;
-  struct isdata *is;
-  struct igdata *ig;
+struct pdjob {
+  WfdbRecord *rec;      /* record being read */
+  WFDB_Sample *vector;  /* frames to be filled in */
+  long n;               /* number of frames */
+  struct perrors errs;  /* errors in pdgroup and pdmerge */
+};
+
+/* pdgroup unpacks and converts the frames of signal group g for pdecode. */
+static void pdgroup(void *arg, long g) {
+  struct pdjob *job = (struct pdjob *)arg;
+  WfdbRecordScope scope(job->rec);
+  perrscope errs(&job->errs);
+  struct igdata *ig = igd[g];
+  WFDB_Sample *slice = pdbuf + job->n * ig->fpos;
+
+  isgunpack(ig, slice, job->n * ig->spf);
+  isgconvert(ig, slice, job->n, slice, ig->spf);
+}
+
+/* pdmerge copies frames k * PDFRAMES and following from the slices made by
+   pdgroup into place for pdecode. */
+static void pdmerge(void *arg, long k) {
+  struct pdjob *job = (struct pdjob *)arg;
+  WfdbRecordScope scope(job->rec);
+  perrscope errs(&job->errs);
+  long f0 = k * PDFRAMES, f1 = f0 + PDFRAMES, i;
+  unsigned c, spf;
   WFDB_Group g;
-  WFDB_Sample v, *vecstart = vector;
-  WFDB_Signal s;
+  const WFDB_Sample *bp;
+  WFDB_Sample *vp;
 
-  if ((stat = (int)nisig) == 0) return (nvsig > 0 ? -1 : 0);
-  if (istime == 0L) {
-    for (s = 0; s < nisig; s++) isd[s]->samp = isd[s]->info.initval;
-    for (g = nigroup; g;) {
-      /* Go through groups in reverse order since seeking on group 0
-         should always be done last. */
-      if (--g == 0 || igd[g]->start > 0L) (void)isgsetframe(g, 0L);
-    }
+  if (f1 > job->n) f1 = job->n;
+  for (g = 0; g < nigroup; g++) {
+    spf = igd[g]->spf;
+    bp = pdbuf + job->n * igd[g]->fpos + f0 * spf;
+    vp = job->vector + f0 * tspf + igd[g]->fpos;
+    for (i = f0; i < f1; i++, bp += spf, vp += tspf)
+      for (c = 0; c < spf; c++) vp[c] = bp[c];
   }
+}
 
-  /* If the vector needs to be rearranged (variable-layout record),
-     then read samples into a temporary buffer. */
-  if (need_sigmap) vector = ovec;
+/* pdecode decodes n frames, all of which must be present in the input
+   buffers, into vector, as the calls of isgdecode in fastframes would. */
+static void pdecode(WFDB_Sample *vector, long n) {
+  struct pdjob job = {cur, vector, n};
 
-  for (s = 0; s < nisig; s++) {
-    is = isd[s];
-    ig = igd[is->info.group];
-    for (c = 0; c < is->info.spf; c++, vector++) {
-      switch (is->info.fmt) {
-        case 0: /* null signal: return sample tagged as invalid */
-          *vector = v = VFILL;
-          if (is->info.nsamp == 0) ig->stat = -1;
-          break;
-        case 8: /* 8-bit first differences */
-        default:
-          *vector = v = is->samp += r8(ig);
-          break;
-        case 16: /* 16-bit amplitudes */
-          *vector = v = r16(ig);
-          if (v == -1 << 15)
-            *vector = VFILL;
-          else
-            is->samp = *vector;
-          break;
-        case 61: /* 16-bit amplitudes, bytes swapped */
-          *vector = v = r61(ig);
-          if (v == -1 << 15)
-            *vector = VFILL;
-          else
-            is->samp = *vector;
-          break;
-        case 80: /* 8-bit offset binary amplitudes */
-          *vector = v = r80(ig);
-          if (v == -1 << 7)
-            *vector = VFILL;
-          else
-            is->samp = *vector;
-          break;
-        case 160: /* 16-bit offset binary amplitudes */
-          *vector = v = r160(ig);
-          if (v == -1 << 15)
-            *vector = VFILL;
-          else
-            is->samp = *vector;
-          break;
-        case 212: /* 2 12-bit amplitudes bit-packed in 3 bytes */
-          *vector = v = r212(ig);
-          if (v == -1 << 11)
-            *vector = VFILL;
-          else
-            is->samp = *vector;
-          break;
-        case 310: /* 3 10-bit amplitudes bit-packed in 4 bytes */
-          *vector = v = r310(ig);
-          if (v == -1 << 9)
-            *vector = VFILL;
-          else
-            is->samp = *vector;
-          break;
-        case 311: /* 3 10-bit amplitudes bit-packed in 4 bytes */
-          *vector = v = r311(ig);
-          if (v == -1 << 9)
-            *vector = VFILL;
-          else
-            is->samp = *vector;
-          break;
-        case 24: /* 24-bit amplitudes */
-          *vector = v = r24(ig);
-          if (v == -1 << 23)
-            *vector = VFILL;
-          else
-            is->samp = *vector;
-          break;
-        case 32: /* 32-bit amplitudes */
-          *vector = v = r32(ig);
-          if (v == -1 << 31)
-            *vector = VFILL;
-          else
-            is->samp = *vector;
-          break;
-      }
+  if (pdbuflen < n * tspf) {
+    SREALLOC(pdbuf, n * tspf, sizeof(WFDB_Sample));
+    pdbuflen = n * tspf;
+  }
+  prun(nigroup, pdgroup, &job);
+  preport(&job.errs);
+  prun((n + PDFRAMES - 1) / PDFRAMES, pdmerge, &job);
+  preport(&job.errs);
+}
+
+/* smframes: read n frames of a variable-layout record, all of which must be
+   present in the input buffers, into vector, in the same way that n calls of
+   getframe would.  The frames of the current segment are decoded a block at a
+   time into smbuf, and then mapped into vector (see smapply). */
+static void smframes(WFDB_Sample *vector, long n) {
+  long m;
+  WFDB_Group g;
+
+  if ((m = BLKLEN / framelen) < 1) m = 1;
+  if (smbuflen < m * framelen) {
+    SREALLOC(smbuf, m * framelen, sizeof(WFDB_Sample));
+    smbuflen = m * framelen;
+  }
+  for (; n > 0; n -= m, vector += m * tspf) {
+    if (m > n) m = n;
+    for (g = 0; g < nigroup; g++) isgdecode(igd[g], smbuf, m, framelen);
+    smapply(vector, smbuf, m);
+  }
+}
+
+/* fastframes: read up to n frames into vector if they can be decoded directly
+   from the input buffers, and return the number of frames read.  Records with
+   skewed signals are read by dsframes once getframe has filled dsbuf. */
+static long fastframes(WFDB_Sample *vector, long n) {
+  long k;
+  WFDB_Group g;
+  WFDB_Signal s;
+
+  if (istime == 0L || nigroup == 0 || (dsbuf && (dsbi < 0 || need_sigmap)) ||
+      (framelen != tspf && !need_sigmap))
+    return (0);
+  for (g = 0; g < nigroup && n > 0; g++)
+    if ((k = isgframes(igd[g])) < n) n = k;
+  /* Leave the final frame of each signal with a known length for getframe,
+     which verifies the checksum. */
+  for (s = 0; s < nisig && n > 0; s++)
+    if ((k = isd[s]->info.nsamp) > 0 && k - 1 < n) n = k - 1;
+  if (n <= 0 || (dsbuf && n <= skewmax)) return (0);
+
+  if (dsbuf)
+    dsframes(vector, n);
+  else if (need_sigmap)
+    smframes(vector, n);
+  else if (ithreads > 1 && nigroup > 1 && n * tspf >= BLKLEN)
+    pdecode(vector, n);
+  else
+    for (g = 0; g < nigroup; g++) isgdecode(igd[g], vector, n, tspf);
+  istime += n;
+  return (n);
+}
+
+/* isgraw: read the next sample of a signal group, refilling its input buffer
+   if necessary, and return it exactly as isgunpack would have.  The caller
+   must check ig->stat afterwards. */
+static int isgraw(struct igdata *ig) {
+  switch (ig->fmt) {
+    case 8:
+    default:
+      return (r8(ig));
+    case 16:
+      return (r16(ig));
+    case 61:
+      return (r61(ig));
+    case 80:
+      return (r80(ig));
+    case 160:
+      return (r160(ig));
+    case 212:
+      return (r212(ig));
+    case 310:
+      return (r310(ig));
+    case 311:
+      return (r311(ig));
+    case 24:
+      return (r24(ig));
+    case 32:
+      return (r32(ig));
+  }
+}
+
+/* isgrange: read n frames of signal group g, which has been positioned at
+   frame t0 by isgsetframe, into the arrays buf[i] for those signals sig[i]
+   that belong to the group, and return the number of frames read (less than
+   n only at the end of the signal file).  Signals that were not requested
+   are decoded only to the extent needed to skip over them. */
+static long isgrange(WFDB_Group g, WFDB_Time t0, long n, const WFDB_Signal *sig,
+                     int nsig, WFDB_Sample **buf) {
+  int diff = (igd[g]->fmt == 8), i, ii;
+  long f, k, m;
+  unsigned c, j, spf;
+  struct igdata *ig = igd[g];
+  struct isdata *is;
+  WFDB_Sample *out, *rp, v, vinvalid = sentinel(ig->fmt);
+  WFDB_Signal s;
+  std::vector<unsigned> cols;
+
+  /* A null signal has no file;  its samples are all invalid. */
+  if (ig->fmt == 0 && nsamples > 0 && n > nsamples - t0) n = nsamples - t0;
+  if (n < 0) n = 0;
+
+  /* If only some of the group's samples are requested, only those are decoded
+     from whole runs of buffered frames (see isggather). */
+  isgcols(g, sig, nsig, cols);
+
+  if ((m = BLKLEN / ig->spf) < 1) m = 1;
+  if (rngbuflen < m * ig->spf) {
+    SREALLOC(rngbuf, m * ig->spf, sizeof(WFDB_Sample));
+    rngbuflen = m * ig->spf;
+  }
+
+  for (k = 0; k < n; k += m) {
+    /* Obtain m frames of raw samples in rngbuf:  a block of frames, if they
+       are all in the input buffer, or otherwise a single frame. */
+    if (ig->fmt == 0)
+      m = 1;
+    else if ((m = isgframes(ig)) > 0) {
+      if (m > n - k) m = n - k;
+      if (m > rngbuflen / ig->spf) m = rngbuflen / ig->spf;
+      if (cols.size() < ig->spf && m >= (long)ig->uframes) {
+        m -= m % ig->uframes;
+        isggather(ig, rngbuf, m, cols.data(), cols.size());
+      } else
+        isgunpack(ig, rngbuf, m * ig->spf);
+    } else {
+      m = 1;
+      for (c = 0; c < ig->spf; c++) rngbuf[c] = isgraw(ig);
       if (ig->stat <= 0) {
-        /* End of file -- reset input counter. */
-        ig->count = 0;
-        if (is->info.nsamp > (WFDB_Time)0L) {
-          wfdb_error("getvec: unexpected EOF in signal %d\n", s);
-          stat = -3;
-        } else if (in_msrec && segp && segp < segend) {
-          segp++;
-          if (isigopen(segp->recname, NULL, (int)nvsig) <= 0) {
-            wfdb_error("getvec: error opening segment %s\n", segp->recname);
-            stat = -3;
-            return (stat); /* avoid looping if segment is bad */
-          } else {
-            istime = segp->samp0;
-            return (getskewedframe(vecstart));
-          }
-        } else
-          stat = -1;
+        ig->count = 0; /* End of file -- reset input counter. */
+        break;
       }
-      is->info.cksum -= v;
     }
-    if (is->info.nsamp >= 0 && --is->info.nsamp == 0 &&
-        (is->info.cksum & 0xffff) && !in_msrec && !isedf && is->info.fmt != 0) {
-      wfdb_error("getvec: checksum error in signal %d\n", s);
-      stat = -4;
+
+    /* Copy the requested columns into place. */
+    for (i = 0; i < nsig; i++) {
+      if (isd[s = sig[i]]->info.group != g) continue;
+      is = isd[s];
+      spf = is->info.spf;
+      out = buf[i] + k * spf;
+      for (ii = 0; ii < i && sig[ii] != s; ii++)
+        ;
+      if (ii < i) { /* requested previously */
+        memcpy(out, buf[ii] + k * spf, m * spf * sizeof(WFDB_Sample));
+        continue;
+      }
+      for (j = 0, s = ig->sig0; s < sig[i]; s++) j += isd[s]->info.spf;
+      for (f = 0, rp = rngbuf + j; f < m; f++, rp += ig->spf)
+        for (c = 0; c < spf; c++) {
+          if (ig->fmt == 0)
+            *out++ = VFILL;
+          else if (diff)
+            *out++ = is->samp += rp[c];
+          else if ((v = rp[c]) == vinvalid)
+            *out++ = VFILL;
+          else
+            *out++ = is->samp = v;
+        }
     }
   }
+  return (k);
+}
 
-  if (need_sigmap)
-    sigmap(vecstart, ovec);
-  else if (framelen != tspf)
-    for (s = framelen; s < tspf; s++) vecstart[s] = WFDB_INVALID_SAMPLE;
+/* Parallel range reading
+
+If more than one decoding thread has been selected using setithreads,
+getsignals gives long ranges of signal groups read from local files to
+isgprange.  Since the byte offset of any run of whole units (see isgunit) in
+the signal file is known, isgprange divides the units into chunks of about
+PRSAMPLES samples, each of which is read using wfdb_pread and decoded by
+prchunk, independently of the others, into its own part of the caller's arrays.
+Two details depend on preceding chunks:  format 8 samples are first
+differences, which prchunk sums beginning from zero, and (if invalid samples
+are to be replaced by the previous valid samples) any invalid samples at the
+beginning of a chunk.  Once all chunks have been decoded, isgprange determines
+the starting value for each chunk and prfix adds it in.  Any frames before the
+first whole unit of the range, or after the last one, are read by isgrange. */
+
+#define PRSAMPLES 16384 /* samples per chunk (see isgprange) */
+
+struct prjob {
+  WfdbRecord *rec;          /* record being read */
+  WFDB_Group g;             /* group being read */
+  WFDB_Time t0;             /* first frame to be read (a unit boundary) */
+  long n;                   /* number of frames to be read */
+  long cf;                  /* frames per chunk */
+  const WFDB_Signal *sig;   /* signals requested */
+  int nsig;                 /* number of signals requested */
+  WFDB_Sample **buf;        /* arrays for the samples of sig[i], at t0 */
+  std::vector<unsigned> cols; /* the group's columns in sig (see isgcols) */
+  std::vector<long> got;    /* frames decoded in each chunk */
+  std::vector<long> lead;   /* invalid samples at the start of each chunk,
+                               for each requested signal */
+  std::vector<WFDB_Sample> last; /* sum of first differences, or last valid
+                                    sample, in each chunk for each signal */
+  std::vector<WFDB_Sample> carry; /* value to be added or filled in by prfix */
+  struct perrors errs;      /* errors in prchunk and prfix */
+};
+
+/* prchunk decodes chunk k of a range for isgprange. */
+static void prchunk(void *arg, long k) {
+  struct prjob *job = (struct prjob *)arg;
+  WfdbRecordScope scope(job->rec);
+  perrscope errs(&job->errs);
+  struct igdata *ig = igd[job->g], tig;
+  static thread_local std::vector<char> bytes;
+  static thread_local std::vector<WFDB_Sample> raw;
+  int diff = (ig->fmt == 8), i, ii;
+  int pad = (gvmode & WFDB_GVPAD) != 0;
+  long f, m, nb, nl;
+  int64_t offset;
+  unsigned c, j, spf;
+  const char *p;
+  const WFDB_Sample *rp;
+  WFDB_Sample *out, v, samp, vinvalid = sentinel(ig->fmt);
+  WFDB_Signal s;
 
-  return (stat);
+  job->got[k] = 0;
+  if ((m = job->n - k * job->cf) > job->cf) m = job->cf;
+  nb = m / ig->uframes * ig->ubytes;
+  offset = ig->start + (job->t0 + k * job->cf) / ig->uframes * ig->ubytes;
+  try {
+    raw.resize((size_t)m * ig->spf);
+    if (ig->fp->type != FileType::kMapped) bytes.resize(nb);
+  } catch (...) {
+    return;
+  }
+  if (ig->fp->type == FileType::kMapped) {
+    if (offset > ig->fp->maplen) return;
+    if (nb > ig->fp->maplen - offset) nb = ig->fp->maplen - offset;
+    p = ig->fp->map + offset;
+  } else {
+    if ((nb = wfdb_pread(ig->fp, bytes.data(), nb, offset)) < 0) return;
+    p = bytes.data();
+  }
+  m = nb / ig->ubytes * ig->uframes;
+
+  /* Unpack the chunk using a copy of the group's state, positioned at p. */
+  tig = *ig;
+  tig.bp = (char *)p;
+  tig.be = (char *)p + nb;
+  tig.count = 0;
+  tig.ir = NULL;
+  if (job->cols.size() < ig->spf)
+    isggather(&tig, raw.data(), m, job->cols.data(), job->cols.size());
+  else
+    isgunpack(&tig, raw.data(), m * ig->spf);
+
+  for (i = 0; i < job->nsig; i++) {
+    if (isd[s = job->sig[i]]->info.group != job->g) continue;
+    for (ii = 0; ii < i && job->sig[ii] != s; ii++)
+      ;
+    if (ii < i) continue; /* requested previously;  see prfix */
+    spf = isd[s]->info.spf;
+    out = job->buf[i] + k * job->cf * spf;
+    for (j = 0, s = ig->sig0; s < job->sig[i]; s++) j += isd[s]->info.spf;
+    samp = 0;
+    nl = 0;
+    for (f = 0, rp = raw.data() + j; f < m; f++, rp += ig->spf)
+      for (c = 0; c < spf; c++) {
+        if (diff)
+          *out++ = samp += rp[c];
+        else if ((v = rp[c]) != vinvalid)
+          *out++ = samp = v;
+        else if (!pad)
+          *out++ = WFDB_INVALID_SAMPLE;
+        else {
+          if (nl == f * spf + c) nl++; /* no valid sample yet */
+          *out++ = samp;
+        }
+      }
+    job->lead[k * job->nsig + i] = nl;
+    job->last[k * job->nsig + i] = samp;
+  }
+  job->got[k] = m;
+}
+
+/* prfix completes chunk k of a range for isgprange, by adding the value of
+   the last sample preceding the chunk to format 8 samples, or substituting it
+   for any leading invalid samples, and by copying the samples of any signals
+   that were requested more than once. */
+static void prfix(void *arg, long k) {
+  struct prjob *job = (struct prjob *)arg;
+  WfdbRecordScope scope(job->rec);
+  perrscope errs(&job->errs);
+  int diff = (igd[job->g]->fmt == 8), i, ii;
+  long f, m = job->got[k], nl;
+  unsigned spf;
+  WFDB_Sample *out, v;
+  WFDB_Signal s;
+
+  for (i = 0; i < job->nsig; i++) {
+    if (isd[s = job->sig[i]]->info.group != job->g) continue;
+    spf = isd[s]->info.spf;
+    out = job->buf[i] + k * job->cf * spf;
+    for (ii = 0; ii < i && job->sig[ii] != s; ii++)
+      ;
+    if (ii < i) { /* requested previously */
+      memcpy(out, job->buf[ii] + k * job->cf * spf,
+             m * spf * sizeof(WFDB_Sample));
+      continue;
+    }
+    v = job->carry[k * job->nsig + i];
+    if (diff) {
+      if (v != 0)
+        for (f = 0; f < m * spf; f++) out[f] += v;
+    } else
+      for (f = 0, nl = job->lead[k * job->nsig + i]; f < nl; f++) out[f] = v;
+  }
+}
+
+/* isgprange: read n frames of signal group g, which has been positioned at
+   frame t0 by isgsetframe, as isgrange does, dividing the work among the
+   decoding threads.  The group must be positioned again by the caller
+   afterwards.  If the group or the range is not suitable, nothing is read,
+   and the result is -1.  Only groups that iblock reads by offset (see rpos),
+   and mapped groups, are suitable;  others, such as those read from the
+   standard input or another pipe, cannot be read using wfdb_pread. */
+static long isgprange(WFDB_Group g, WFDB_Time t0, long n,
+                      const WFDB_Signal *sig, int nsig, WFDB_Sample **buf) {
+  int i, ii;
+  long h, k, m, nc, nread;
+  struct igdata *ig = igd[g];
+  struct isdata *is;
+  struct prjob job;
+  std::vector<WFDB_Sample *> tbuf;
+
+  if (ithreads < 2 || ig->ubytes == 0 || ig->fp == NULL || !ig->seek ||
+      ig->cz || (ig->rpos < 0 && ig->fp->type != FileType::kMapped))
+    return (-1);
+  /* Determine the number of frames that precede the first whole unit, and
+     the length of the chunks. */
+  h = (long)((ig->uframes - t0 % ig->uframes) % ig->uframes);
+  if ((job.cf = PRSAMPLES / ig->spf / ig->uframes * ig->uframes) <
+      (long)ig->uframes)
+    job.cf = ig->uframes;
+  if ((n - h) / job.cf < 2) return (-1);
+  m = (n - h) / ig->uframes * ig->uframes;
+  nc = (m + job.cf - 1) / job.cf;
+
+  try {
+    tbuf.resize(nsig);
+    job.got.resize(nc);
+    job.lead.resize((size_t)nc * nsig);
+    job.last.resize((size_t)nc * nsig);
+    job.carry.resize((size_t)nc * nsig);
+    isgcols(g, sig, nsig, job.cols);
+  } catch (...) {
+    return (-1);
+  }
+
+  /* Read the frames that precede the first whole unit. */
+  if (h > 0 && (nread = isgrange(g, t0, h, sig, nsig, buf)) < h)
+    return (nread);
+
+  /* Decode the chunks, then find the value of the sample that precedes each
+     chunk, for each requested signal, and complete the chunks. */
+  for (i = 0; i < nsig; i++)
+    if (isd[sig[i]]->info.group == g)
+      tbuf[i] = buf[i] + h * isd[sig[i]]->info.spf;
+  job.rec = cur;
+  job.g = g;
+  job.t0 = t0 + h;
+  job.n = m;
+  job.sig = sig;
+  job.nsig = nsig;
+  job.buf = tbuf.data();
+  prun(nc, prchunk, &job);
+  preport(&job.errs);
+  for (k = 0; k < nc && job.got[k] == job.cf; k++)
+    ;
+  if (k < nc) nc = k + 1; /* the range ends in chunk k */
+  for (i = 0; i < nsig; i++) {
+    if (isd[sig[i]]->info.group != g) continue;
+    for (ii = 0; ii < i && sig[ii] != sig[i]; ii++)
+      ;
+    if (ii < i) continue; /* requested previously */
+    is = isd[sig[i]];
+    for (k = 0; k < nc; k++) {
+      job.carry[k * nsig + i] = is->samp;
+      if (ig->fmt == 8)
+        is->samp += job.last[k * nsig + i];
+      else if (job.lead[k * nsig + i] < job.got[k] * is->info.spf)
+        is->samp = job.last[k * nsig + i];
+    }
+  }
+  prun(nc, prfix, &job);
+  preport(&job.errs);
+  for (k = m = 0; k < nc; k++) m += job.got[k];
+
+  /* Read any frames that follow the last whole unit that was read. */
+  if (m < n - h) {
+    for (i = 0; i < nsig; i++)
+      if (isd[sig[i]]->info.group == g) tbuf[i] += m * isd[sig[i]]->info.spf;
+    if (isgsetframe(g, t0 + h + m) < 0) return (h + m);
+    return (h + m + isgrange(g, t0 + h + m, n - h - m, sig, nsig, tbuf.data()));
+  }
+  return (n);
 }
 
 /* meansamp: calculate the mean of n sample values.  The result is
@@ -2050,12 +5258,52 @@ static int getskewedframe(WFDB_Sample *vector) {
    up. */
 static WFDB_Sample meansamp(const WFDB_Sample *s, int n) {
   /* If a WFDB_Time is large enough to hold the sum of the sample
-     values, then simply add them up and divide by n. */
+     values, then simply add them up and divide by n.  Long runs of
+     samples are added in 64-bit lanes, four or eight samples at a
+     time, and checked for invalid samples only at the end. */
   if (WFDB_SAMPLE_MAX <= WFDB_TIME_MAX / INT_MAX) {
     WFDB_Time sum = n / 2;
-    int i;
-
-    for (i = 0; i < n; i++) {
+    int i = 0;
+
+#if !defined(NOSIMD) && defined(__AVX2__)
+    if (n >= 8) {
+      const __m256i invalid = _mm256_set1_epi32(WFDB_INVALID_SAMPLE);
+      __m256i a = _mm256_setzero_si256(), e = _mm256_setzero_si256(), w;
+      long long t[2];
+
+      for (; i + 8 <= n; i += 8) {
+        w = _mm256_loadu_si256((const __m256i *)(s + i));
+        e = _mm256_or_si256(e, _mm256_cmpeq_epi32(w, invalid));
+        a = _mm256_add_epi64(
+            a, _mm256_cvtepi32_epi64(_mm256_castsi256_si128(w)));
+        a = _mm256_add_epi64(
+            a, _mm256_cvtepi32_epi64(_mm256_extracti128_si256(w, 1)));
+      }
+      if (!_mm256_testz_si256(e, e)) return (WFDB_INVALID_SAMPLE);
+      _mm_storeu_si128((__m128i *)t,
+                       _mm_add_epi64(_mm256_castsi256_si128(a),
+                                     _mm256_extracti128_si256(a, 1)));
+      sum += t[0] + t[1];
+    }
+#elif !defined(NOSIMD) && defined(__SSE2__)
+    if (n >= 4) {
+      const __m128i invalid = _mm_set1_epi32(WFDB_INVALID_SAMPLE);
+      __m128i a = _mm_setzero_si128(), e = _mm_setzero_si128(), w, m;
+      long long t[2];
+
+      for (; i + 4 <= n; i += 4) {
+        w = _mm_loadu_si128((const __m128i *)(s + i));
+        e = _mm_or_si128(e, _mm_cmpeq_epi32(w, invalid));
+        m = _mm_srai_epi32(w, 31); /* sign extension */
+        a = _mm_add_epi64(a, _mm_unpacklo_epi32(w, m));
+        a = _mm_add_epi64(a, _mm_unpackhi_epi32(w, m));
+      }
+      if (_mm_movemask_epi8(e)) return (WFDB_INVALID_SAMPLE);
+      _mm_storeu_si128((__m128i *)t, a);
+      sum += t[0] + t[1];
+    }
+#endif
+    for (s += i; i < n; i++) {
       if (*s == WFDB_INVALID_SAMPLE) return (WFDB_INVALID_SAMPLE);
       sum += *s++;
     }
@@ -2095,14 +5343,13 @@ static WFDB_Sample meansamp(const WFDB_Sample *s, int n) {
 static int rgetvec(WFDB_Sample *vector) {
   WFDB_Sample *tp;
   WFDB_Signal s;
-  static int stat;
 
   if (ispfmax < 2) /* all signals at the same frequency */
     return (getframe(vector));
 
   if ((gvmode & WFDB_HIGHRES) != WFDB_HIGHRES) {
     /* return one sample per frame, decimating by averaging if necessary */
-    stat = getframe(tvector);
+    rgvfstat = getframe(tvector);
     for (s = 0, tp = tvector; s < nvsig; s++) {
       int sf = vsd[s]->info.spf;
       *vector++ = meansamp(tp, sf);
@@ -2111,7 +5358,7 @@ static int rgetvec(WFDB_Sample *vector) {
   } else { /* return ispfmax samples per frame, using
               zero-order interpolation if necessary */
     if (gvc >= ispfmax) {
-      stat = getframe(tvector);
+      rgvfstat = getframe(tvector);
       gvc = 0;
     }
     for (s = 0, tp = tvector; s < nvsig; s++) {
@@ -2131,25 +5378,36 @@ static int rgetvec(WFDB_Sample *vector) {
     }
     gvc++;
   }
-  return (stat);
+  return (rgvfstat);
 }
 
 /* WFDB library functions. */
 
 int isigopen(char *record, WFDB_Siginfo *siarray, int nsig) {
-  int navail, nn, spflimit;
+  int navail, ncz, nn, spflimit;
   int first_segment = 0;
+  struct stat st;
   struct hsdata *hs;
   struct isdata *is;
   struct igdata *ig;
-  WFDB_Signal s, si, sj;
+  WFDB_Signal k, s, si, sj;
   WFDB_Group g;
 
-  /* Close previously opened input signals unless otherwise requested. */
+  /* Close previously opened input signals unless otherwise requested.  Any
+     call other than a switch to the current segment of a multi-segment
+     record (by isgsetframe, with segp->recname) opens a new record.  In
+     that case in_msrec is cleared first, so that isigclose frees all that
+     belongs to the previous record (including the sample() cache and any
+     segment being prefetched).  The durations of the previous record are
+     forgotten as well, so that readheader compares durations only among
+     records opened together (using '+'). */
   if (*record == '+')
     record++;
-  else
+  else {
+    if (in_msrec && (segp == NULL || record != segp->recname)) in_msrec = 0;
     isigclose();
+    if (!in_msrec) nsamples = msnsamples = (WFDB_Time)0L;
+  }
 
   /* Remove trailing .hea, if any, from record name. */
   wfdb_striphea(record);
@@ -2157,6 +5415,9 @@ int isigopen(char *record, WFDB_Siginfo *siarray, int nsig) {
   /* Save the current record name. */
   if (!in_msrec) wfdb_setirec(record);
 
+  /* If this segment has been prefetched, use the header that was read. */
+  sftake(record);
+
   /* Read the header and determine how many signals are available. */
   if ((navail = readheader(record)) <= 0) {
     if (navail == 0 && segments) { /* this is a multi-segment record */
@@ -2199,8 +5460,9 @@ int isigopen(char *record, WFDB_Siginfo *siarray, int nsig) {
   if (nn > nigroup + nsig) nn = nigroup + nsig;
   if (allocigroup(nn) != nn) return (-1); /* failed, allocigroup emits error */
 
-  /* Set default buffer size (if not set already by setibsize). */
-  if (ibsize <= 0) ibsize = BUFSIZ;
+  /* Set the default buffer size, etc. (unless set already by setibsize,
+     etc.). */
+  sdefaults();
 
   /* Open the signal files.  One signal group is handled per iteration.  In
      this loop, si counts through the entries that have been read from hsd,
@@ -2225,22 +5487,72 @@ int isigopen(char *record, WFDB_Siginfo *siarray, int nsig) {
       if ((ig->bsize = hs->info.bsize) == 0) ig->bsize = ibsize;
       ig->seek = 1;
     }
-    SALLOC(ig->buf, 1, ig->bsize);
+    if (ig->buf == NULL || ig->buflen < ig->bsize) {
+      SALLOC(ig->buf, 1, ig->bsize);
+      ig->buflen = ig->bsize;
+    }
 
     /* Check that the signal file is readable. */
     if (hs->info.fmt == 0)
       ig->fp = NULL; /* Don't open a file for a null signal. */
     else {
-      ig->fp = wfdb_open(hs->info.fname, (char *)NULL, WFDB_READ);
+      if ((ig->fp = sfopen(hs->info.fname)) == NULL)
+        ig->fp = wfdb_open(hs->info.fname, (char *)NULL, WFDB_READ);
       /* Skip this group if the signal file can't be opened. */
       if (ig->fp == NULL) {
         SFREE(ig->buf);
+        ig->buflen = 0;
         continue;
       }
     }
 
+    /* If the signal file is compressed, read its index.  All of the signals
+       in the group must be in the compressed format, whichever of them comes
+       first (as readheader also requires). */
+    for (k = si, ncz = nn = 0; k < sj; k++)
+      if (hsd[k]->info.fmt == CZFMT) {
+        ncz++;
+        nn += hsd[k]->info.spf;
+      }
+    if (ncz > 0 && (ncz < sj - si || czopen(ig, nn) < 0)) {
+      wfdb_error("isigopen: can't read compressed signal file %s\n",
+                 hs->info.fname);
+      if (ig->fp) (void)wfdb_fclose(ig->fp);
+      ig->fp = NULL;
+      SFREE(ig->buf);
+      ig->buflen = 0;
+      continue;
+    }
+
     /* All tests passed -- fill in remaining data for this group. */
     ig->be = ig->bp = ig->buf + ig->bsize;
+
+    /* If mapping has been enabled (see setimmap), and if possible, map the
+       signal file into memory.  The entire file then serves as the input
+       buffer, and the file position is left at its end so that an attempt
+       to refill the buffer reports end-of-file.  Files with a fixed block
+       size are read as before. */
+    if (immap && ig->fp && ig->seek && hs->info.bsize == 0 &&
+        ig->cz == NULL && wfdb_fmap(ig->fp) == 0) {
+      ig->bp = (char *)ig->fp->map + hs->start;
+      ig->be = (char *)ig->fp->map + ig->fp->maplen;
+      if (ig->bp > ig->be) ig->bp = ig->be;
+      (void)wfdb_fseek(ig->fp, 0L, SEEK_END);
+    }
+    /* Otherwise, if read-ahead has been selected, start reading ahead in
+       local files that permit seeks. */
+    else if (inbuf > 1 && ig->fp && ig->seek && ig->cz == NULL &&
+             ig->fp->type == FileType::kLocal)
+      irstart(ig, inbuf);
+    /* Read other local files that permit seeks by offset, so that
+       isgsetframe need not move the file position.  Only regular files
+       qualify:  the standard input (which wfdb_open returns for "-") and
+       other special files may be pipes, which pread cannot read. */
+    ig->rpos = (ig->fp && ig->seek && ig->ir == NULL && ig->cz == NULL &&
+                ig->fp->type == FileType::kLocal && ig->fp->fp != stdin &&
+                fstat(fileno(ig->fp->fp), &st) == 0 && S_ISREG(st.st_mode))
+                   ? 0
+                   : -1;
     ig->start = hs->start;
     ig->stat = 1;
     while (si < sj && s < nsig) {
@@ -2297,6 +5609,25 @@ int isigopen(char *record, WFDB_Siginfo *siarray, int nsig) {
   /* Determine the total number of samples per frame. */
   for (si = framelen = 0; si < nisig; si++) framelen += isd[si]->info.spf;
 
+  /* Record the position of each signal group within a frame, and the size
+     of the shortest run of frames that occupies a whole number of bytes in
+     its signal file, for use by getframes. */
+  for (g = 0; g < nigroup; g++) igd[g]->nsig = igd[g]->spf = 0;
+  for (si = nn = 0; si < nisig; nn += isd[si++]->info.spf) {
+    ig = igd[isd[si]->info.group];
+    if (ig->nsig++ == 0) {
+      ig->fmt = ig->cz ? 32 : isd[si]->info.fmt; /* see czblock */
+      ig->sig0 = si;
+      ig->fpos = nn;
+    }
+    ig->spf += isd[si]->info.spf;
+  }
+  for (g = 0; g < nigroup; g++) {
+    ig = igd[g];
+    ig->ubytes = isgunit(ig->fmt, ig->spf, &ig->uframes);
+  }
+  isgselect(); /* Choose a frame decoder for each group. */
+
   /* Allocate workspace for getvec, isgsettime, and tnextvec. */
   if (tspf > tuvlen) {
     SALLOC(tvector, tspf, sizeof(WFDB_Sample));
@@ -2317,6 +5648,9 @@ int isigopen(char *record, WFDB_Siginfo *siarray, int nsig) {
     dsblen = tspf * (skewmax + 1);
     SALLOC(dsbuf, dsblen, sizeof(WFDB_Sample));
   }
+
+  /* Start opening the next segment, if any, in the background. */
+  if (in_msrec) sfstart();
   return (s);
 }
 
@@ -2333,7 +5667,7 @@ static int openosig(const char *func, WFDB_Siginfo *si_out,
   if (allocogroup(nogroup + si_in[nsig - 1].group + 1) < 0) return (-3);
 
   /* Initialize local variables. */
-  if (obsize <= 0) obsize = BUFSIZ;
+  sdefaults();
 
   /* Set the group number adjustment.  This quantity is added to the group
      numbers of signals which are opened below;  it accounts for any output
@@ -2362,11 +5696,28 @@ static int openosig(const char *func, WFDB_Siginfo *si_out,
 
       og = ogd[os->info.group];
       og->bsize = os->info.bsize;
-      obuflen = og->bsize ? og->bsize : obsize;
+      obuflen = og->bsize ? og->bsize : obsize.load();
       /* This is the first signal in a new group; allocate buffer. */
       SALLOC(og->buf, 1, obuflen);
       og->bp = og->buf;
       og->be = og->buf + obuflen;
+      /* If output is to be asynchronous, allocate spare buffers, and start
+         the writer thread if necessary (see oblock). */
+      og->nobuf = og->nofree = 0;
+      if (onbuf > 1 && owr == NULL &&
+          (owr = new (std::nothrow) struct owriter()) != NULL) {
+        try {
+          owr->thread = std::thread(owmain, owr);
+        } catch (...) { /* no thread is available: write synchronously */
+          delete owr;
+          owr = NULL;
+        }
+      }
+      if (owr && os->info.fmt != CZFMT)
+        while (og->nobuf < onbuf - 1) {
+          SALLOC(og->ofree[og->nobuf], 1, obuflen);
+          og->nofree = ++og->nobuf;
+        }
       if (os->info.fmt == 0) {
         /* If the signal file name was NULL or "~", don't create a
            signal file. */
@@ -2387,6 +5738,17 @@ static int openosig(const char *func, WFDB_Siginfo *si_out,
           return (-3);
         }
       }
+      /* A compressed file is written in blocks of its own (see czput). */
+      if (os->info.fmt == CZFMT) {
+        if ((og->cz = new (std::nothrow) struct czdata()) == NULL) {
+          wfdb_error("%s: insufficient memory\n", func);
+          osigclose();
+          return (-3);
+        }
+        og->cz->bframes = CZFRAMES;
+        og->cz->pos = -1;
+        og->bsize = 0;
+      }
       nogroup++;
     } else {
       /* This signal belongs to the same group as the previous signal. */
@@ -2396,6 +5758,7 @@ static int openosig(const char *func, WFDB_Siginfo *si_out,
         return (-2);
       }
     }
+    if (og->cz) og->cz->nn += os->info.spf;
   }
   return (s);
 }
@@ -2438,7 +5801,7 @@ int osigfopen(const WFDB_Siginfo *siarray, unsigned int nsig) {
   /* Do nothing further if there are no signals to open. */
   if (siarray == NULL || nsig == 0) return (stat);
 
-  if (obsize <= 0) obsize = BUFSIZ;
+  sdefaults();
 
   /* Prescan siarray to check the signal specifications and to determine
      the number of signal groups. */
@@ -2528,6 +5891,7 @@ void setgvmode(int mode) {
   }
 
   gvmode = mode & (WFDB_HIGHRES | WFDB_GVPAD);
+  isgselect(); /* The frame decoders depend on WFDB_GVPAD. */
 
   if ((mode & WFDB_HIGHRES) == WFDB_HIGHRES) {
     if (spfmax == 0) spfmax = 1;
@@ -2542,11 +5906,6 @@ int getgvmode() { return (gvmode); }
 /* An application can specify the input sampling frequency it prefers by
    calling setifreq after opening the input record. */
 
-static long mticks, nticks, mnticks;
-static int rgvstat;
-static WFDB_Time rgvtime, gvtime;
-static WFDB_Sample *gv0, *gv1;
-
 int setifreq(WFDB_Frequency f) {
   WFDB_Frequency error, g = sfreq;
 
@@ -2560,6 +5919,8 @@ int setifreq(WFDB_Frequency f) {
       SREALLOC(gv0, nvsig, sizeof(WFDB_Sample));
       SREALLOC(gv1, nvsig, sizeof(WFDB_Sample));
     }
+    SFREE(rstab);
+    SFREE(rshist);
     setafreq(ifreq = f);
     /* The 0.005 below is the maximum tolerable error in the resampling
        frequency (in Hz).  The code in the while loop implements Euclid's
@@ -2578,6 +5939,10 @@ int setifreq(WFDB_Frequency f) {
     /* Raw and resampled intervals begin simultaneously once every mnticks
        subintervals; we say an epoch begins at these times. */
     mnticks = mticks * nticks;
+    if (rsmode == WFDB_RESAMPLE_SINC && ifreq != sfreq) {
+      rsinit(); /* the input is read on demand by rsgetvec */
+      return (0);
+    }
     /* gvtime is the number of subintervals from the beginning of the
        current epoch to the next sample to be returned by getvec(). */
     gvtime = 0;
@@ -2594,8 +5959,174 @@ int setifreq(WFDB_Frequency f) {
   }
 }
 
-WFDB_Frequency getifreq() {
-  return (ifreq > (WFDB_Frequency)0 ? ifreq : sfreq);
+WFDB_Frequency getifreq() {
+  return (ifreq > (WFDB_Frequency)0 ? ifreq : sfreq);
+}
+
+/* setifreqmode selects the method used by getvec to resample the input
+   signals after setifreq:  WFDB_RESAMPLE_LINEAR (the default) or
+   WFDB_RESAMPLE_SINC.  The new method takes effect at the next call to
+   setifreq.  The previous method is returned. */
+int setifreqmode(int mode) {
+  int prev = rsmode;
+
+  if (mode != WFDB_RESAMPLE_LINEAR && mode != WFDB_RESAMPLE_SINC) {
+    wfdb_error("setifreqmode: illegal mode %d\n", mode);
+    return (-1);
+  }
+  rsmode = mode;
+  return (prev);
+}
+
+/* Polyphase resampling
+
+In WFDB_RESAMPLE_SINC mode, each output sample is the inner product of rstaps
+consecutive input samples with one of rsnph precomputed sets of coefficients
+(phases), selected according to the position of the output sample between
+its two nearest input samples.  The coefficients are samples of a windowed
+(Blackman) sinc function, with its cutoff frequency at RSCUTOFF times the
+lower of the input and output Nyquist frequencies, extending over RSZEROS
+zero crossings on each side;  the coefficients of each phase are normalized
+to unity gain at DC.  Only the most recent rstaps input samples of each
+signal are kept, so that records of any length can be resampled in constant
+memory.  The history of each signal is stored twice, end to end, so that the
+rstaps samples ending with the newest one are always contiguous.  Invalid
+input samples are recorded as NaNs, so that output samples that depend on
+them are also invalid. */
+
+#define RSCUTOFF 0.9   /* cutoff frequency, relative to the Nyquist frequency */
+#define RSZEROS 16     /* zero crossings on each side of the filter kernel */
+#define RSMAXPH 256    /* maximum number of phases */
+#define RSMAXHALF 8192 /* maximum half-length of the filter */
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+/* rsreset empties the input history, so that the next output sample will be
+   aligned with the next input sample. */
+static void rsreset(void) {
+  rshi = 0;
+  rsphase = 0L;
+  rsbase = (WFDB_Time)0;
+  rsn = rslast = (WFDB_Time)-1;
+}
+
+/* rsinit computes the filter coefficients for the current input and output
+   sampling frequencies, and allocates the input history. */
+static void rsinit(void) {
+  double d, fc, sum, *t;
+  int h, i, p;
+
+  fc = 0.5 * RSCUTOFF * ((ifreq < sfreq) ? ifreq / sfreq : 1.0);
+  if ((h = (int)ceil(RSZEROS / (2.0 * fc))) > RSMAXHALF) h = RSMAXHALF;
+  rstaps = 2 * h;
+  rsnph = (nticks < RSMAXPH) ? (int)nticks : RSMAXPH;
+  SREALLOC(rstab, rsnph * rstaps, sizeof(double));
+  SREALLOC(rshist, 2 * rstaps * (nvsig > 0 ? nvsig : 1), sizeof(double));
+  for (p = 0; p < rsnph; p++) {
+    t = rstab + p * rstaps;
+    for (i = 0, sum = 0.0; i < rstaps; i++) {
+      /* d is the distance from the output sample to input sample i of the
+         window, in input sampling intervals. */
+      d = h - 1 - i + (double)p / rsnph;
+      t[i] = (d == 0.0) ? 2.0 * fc : sin(2.0 * M_PI * fc * d) / (M_PI * d);
+      t[i] *= 0.42 + 0.5 * cos(M_PI * d / h) + 0.08 * cos(2.0 * M_PI * d / h);
+      sum += t[i];
+    }
+    for (i = 0; i < rstaps; i++) t[i] /= sum;
+  }
+  rsreset();
+}
+
+/* rspush appends a vector of input samples to the history. */
+static void rspush(const WFDB_Sample *v) {
+  double *hp, x;
+  int s;
+
+  for (s = 0; s < nvsig; s++) {
+    hp = rshist + 2 * rstaps * s;
+    x = (v[s] == WFDB_INVALID_SAMPLE) ? NAN : (double)v[s];
+    hp[rshi] = hp[rshi + rstaps] = x;
+  }
+  if (++rshi == rstaps) rshi = 0;
+  rsn++;
+}
+
+/* rsdot returns the inner product of h[0..n-1] and x[0..n-1]. */
+static double rsdot(const double *h, const double *x, int n) {
+  int i = 0;
+  double sum = 0.0;
+
+#if !defined(NOSIMD) && defined(__AVX2__)
+  __m256d a0 = _mm256_setzero_pd(), a1 = _mm256_setzero_pd();
+  __m128d q;
+
+  for (; i + 8 <= n; i += 8) {
+    a0 = _mm256_add_pd(
+        a0, _mm256_mul_pd(_mm256_loadu_pd(h + i), _mm256_loadu_pd(x + i)));
+    a1 = _mm256_add_pd(a1, _mm256_mul_pd(_mm256_loadu_pd(h + i + 4),
+                                         _mm256_loadu_pd(x + i + 4)));
+  }
+  a0 = _mm256_add_pd(a0, a1);
+  q = _mm_add_pd(_mm256_castpd256_pd128(a0), _mm256_extractf128_pd(a0, 1));
+  sum = _mm_cvtsd_f64(_mm_add_sd(q, _mm_unpackhi_pd(q, q)));
+#elif !defined(NOSIMD) && defined(__SSE2__)
+  __m128d a0 = _mm_setzero_pd(), a1 = _mm_setzero_pd();
+
+  for (; i + 4 <= n; i += 4) {
+    a0 = _mm_add_pd(a0, _mm_mul_pd(_mm_loadu_pd(h + i), _mm_loadu_pd(x + i)));
+    a1 = _mm_add_pd(
+        a1, _mm_mul_pd(_mm_loadu_pd(h + i + 2), _mm_loadu_pd(x + i + 2)));
+  }
+  a0 = _mm_add_pd(a0, a1);
+  sum = _mm_cvtsd_f64(_mm_add_sd(a0, _mm_unpackhi_pd(a0, a0)));
+#endif
+  for (; i < n; i++) sum += h[i] * x[i];
+  return (sum);
+}
+
+/* rsgetvec is getvec for WFDB_RESAMPLE_SINC mode. */
+static int rsgetvec(WFDB_Sample *vector) {
+  double x;
+  int h = rstaps / 2, p, s;
+
+  /* Before the first input sample, the history is filled with copies of it.
+     The last input sample read successfully is kept in gv0. */
+  if (rsn < 0) {
+    if ((rgvstat = rgetvec(gv0)) < 0 && rgvstat != -4) return (rgvstat);
+    for (rsn = -h; rsn < 0;) rspush(gv0);
+    rslast = 0;
+  }
+
+  /* Read input samples until the filter window is full;  beyond the end of
+     the record, it is filled with copies of the last input sample. */
+  while (rsn < rsbase + h) {
+    if (rslast == rsn &&
+        ((rgvstat = rgetvec(gv1)) >= 0 || rgvstat == -4)) {
+      memcpy(gv0, gv1, nvsig * sizeof(WFDB_Sample));
+      rslast++;
+    }
+    rspush(gv0);
+  }
+  if (rsbase > rslast) return (-1); /* end of record */
+
+  p = (int)(rsphase * rsnph / nticks);
+  for (s = 0; s < nvsig; s++) {
+    x = rsdot(rstab + p * rstaps, rshist + 2 * rstaps * s + rshi, rstaps);
+    if (isnan(x))
+      vector[s] = WFDB_INVALID_SAMPLE;
+    else if (x >= INT_MAX)
+      vector[s] = INT_MAX;
+    else if (x <= INT_MIN + 1)
+      vector[s] = INT_MIN + 1;
+    else
+      vector[s] = (WFDB_Sample)floor(x + 0.5);
+  }
+  rsphase += mticks;
+  rsbase += rsphase / nticks;
+  rsphase %= nticks;
+  return (nvsig);
 }
 
 int getvec(WFDB_Sample *vector) {
@@ -2603,6 +6134,8 @@ int getvec(WFDB_Sample *vector) {
 
   if (ifreq == 0.0 || ifreq == sfreq) /* no resampling necessary */
     return (rgetvec(vector));
+  if (rstab) /* windowed-sinc resampling */
+    return (rsgetvec(vector));
 
   /* Resample the input. */
   if (rgvtime > mnticks) {
@@ -2652,6 +6185,273 @@ int getframe(WFDB_Sample *vector) {
   return (stat);
 }
 
+/* getframes reads up to nframes input frames into vector, which must have
+   room for nframes * (total samples per frame) samples, and returns the number
+   of frames read.  The result is less than nframes only if the end of the
+   record is reached or an error occurs;  if no frames could be read, the
+   result is the (negative) value that getframe would have returned. */
+long getframes(WFDB_Sample *vector, long nframes) {
+  int stat = 0;
+  long n, nread = 0;
+
+  while (nread < nframes) {
+    if ((n = fastframes(vector, nframes - nread)) > 0) {
+      nread += n;
+      vector += n * tspf;
+      continue;
+    }
+    if ((stat = getframe(vector)) < 0 && stat != -4) break;
+    nread++;
+    vector += tspf;
+    if (stat < 0) break; /* checksum error -- the frame itself is usable */
+  }
+  return ((nread > 0 || stat >= 0) ? nread : stat);
+}
+
+/* lowresframes: store in vector the n sample vectors that rgetvec would
+   obtain, in WFDB_LOWRES mode, from the n frames in frame. */
+static void lowresframes(WFDB_Sample *vector, const WFDB_Sample *frame,
+                         long n) {
+  long f;
+  const WFDB_Sample *tp = frame;
+  WFDB_Signal s;
+
+  for (f = 0; f < n; f++)
+    for (s = 0; s < nvsig; tp += vsd[s++]->info.spf)
+      *vector++ = meansamp(tp, vsd[s]->info.spf);
+}
+
+/* getvecs reads up to nvecs sample vectors, as getvec would, into vector,
+   which must have room for nvecs * (number of input signals) samples, and
+   returns the number of vectors read (or a negative error code as for
+   getframes). */
+long getvecs(WFDB_Sample *vector, long nvecs) {
+  int stat = 0;
+  long k, m, n = 0;
+
+  /* If getvec would simply call getframe, read whole blocks of frames. */
+  if (ispfmax < 2 && (ifreq == 0.0 || ifreq == sfreq))
+    return (getframes(vector, nvecs));
+
+  /* If getvec would average the samples of each frame, read blocks of frames
+     into vecbuf, and store their means in vector.  (vecbuf is not rngbuf,
+     since typedframes reads vectors into rngbuf using getvecs.) */
+  if ((ifreq == 0.0 || ifreq == sfreq) &&
+      (gvmode & WFDB_HIGHRES) != WFDB_HIGHRES) {
+    if ((m = BLKLEN / tspf) < 1) m = 1;
+    if (vecbuflen < m * tspf) {
+      SREALLOC(vecbuf, m * tspf, sizeof(WFDB_Sample));
+      vecbuflen = m * tspf;
+    }
+    for (; n < nvecs; n += k, vector += k * nvsig) {
+      if ((k = getframes(vecbuf, nvecs - n < m ? nvecs - n : m)) <= 0)
+        return (n > 0 ? n : k);
+      lowresframes(vector, vecbuf, k);
+    }
+    return (n);
+  }
+
+  for (; n < nvecs; n++, vector += nvsig)
+    if ((stat = getvec(vector)) < 0 && stat != -4) break;
+  return ((n > 0 || stat >= 0) ? n : stat);
+}
+
+/* getsignals reads frames t0 through t1 - 1 of the input signals specified
+   by sig[0], ..., sig[nsig - 1], storing the samples of signal sig[i] in
+   buf[i], which must have room for (t1 - t0) * spf samples (where spf is the
+   number of samples per frame of signal sig[i]).  It returns the number of
+   frames read, which is less than t1 - t0 only if the end of the record is
+   reached, or a negative value in case of error.  Afterwards, the next frame
+   to be read by getframe is frame t0 + (the number of frames read).  (If
+   getvec is resampling the input signals, use isigsettime before calling it
+   again.)
+
+   In a single-segment record without skewed signals, getsignals reads each
+   signal group that contains any of the requested signals separately;  the
+   other groups are not read at all.  Long ranges of local signal files are
+   decoded in parallel if setithreads has selected more than one thread. */
+long getsignals(WFDB_Time t0, WFDB_Time t1, const WFDB_Signal *sig, int nsig,
+                WFDB_Sample **buf) {
+  int i, stat = 0;
+  long f, k, m, n, nread;
+  unsigned c, j;
+  WFDB_Group g;
+  WFDB_Signal s;
+
+  if (t0 < 0L || t1 < t0 || t1 - t0 > LONG_MAX) {
+    wfdb_error("getsignals: improper range [%" WFDB_Pd_TIME ", %" WFDB_Pd_TIME
+               ")\n", t0, t1);
+    return (-1);
+  }
+  for (i = 0; i < nsig; i++)
+    if (sig[i] < 0 || sig[i] >= nvsig) {
+      wfdb_error("getsignals: illegal signal number %d\n", sig[i]);
+      return (-2);
+    }
+  n = (long)(t1 - t0);
+  if (n == 0 || nsig == 0) return (0);
+
+  /* Multi-segment and skewed records are read frame by frame, using getframes,
+     and the requested signals are copied out of the frames. */
+  if (in_msrec || need_sigmap || dsbuf) {
+    for (g = 1; g < nigroup; g++)
+      if ((stat = isgsetframe(g, t0)) < 0) return (stat);
+    if ((stat = isgsetframe(0, t0)) < 0) return (stat);
+    if ((m = BLKLEN / tspf) < 1) m = 1;
+    if (rngbuflen < m * tspf) {
+      SREALLOC(rngbuf, m * tspf, sizeof(WFDB_Sample));
+      rngbuflen = m * tspf;
+    }
+    for (nread = 0; nread < n; nread += k) {
+      if ((k = getframes(rngbuf, n - nread < m ? n - nread : m)) <= 0) {
+        if (nread == 0) return (k);
+        break;
+      }
+      for (i = 0; i < nsig; i++) {
+        for (j = 0, s = 0; s < sig[i]; s++) j += vsd[s]->info.spf;
+        c = vsd[s]->info.spf;
+        for (f = 0; f < k; f++)
+          memcpy(buf[i] + (nread + f) * c, rngbuf + f * tspf + j,
+                 c * sizeof(WFDB_Sample));
+      }
+    }
+    return (nread);
+  }
+
+  /* Otherwise, read only the groups that contain requested signals, then
+     leave all groups positioned at the end of the range.  A group that
+     isgrange has read sequentially to that point is not repositioned, so that
+     a group read from a pipe needs no seek.  Seek on group 0 last, since doing
+     so updates istime. */
+  std::vector<long> at(nigroup, -1L); /* frames read sequentially */
+  nread = n;
+  for (g = nigroup; g-- > 0;) {
+    for (i = 0; i < nsig && isd[sig[i]]->info.group != g; i++)
+      ;
+    if (i == nsig) continue;
+    if ((stat = isgsetframe(g, t0)) < 0) return (stat);
+    /* As in getskewedframe, format 8 differences are summed beginning from
+       the initial values at frame 0. */
+    if (t0 == 0L)
+      for (i = 0; i < nsig; i++)
+        if (isd[s = sig[i]]->info.group == g)
+          isd[s]->samp = isd[s]->info.initval;
+    if ((k = isgprange(g, t0, n, sig, nsig, buf)) < 0 &&
+        (k = isgrange(g, t0, n, sig, nsig, buf)) >= 0 && igd[g]->fmt != 0)
+      at[g] = k;
+    if (k < nread) nread = k;
+  }
+  for (g = nigroup; g-- > 0;)
+    if (at[g] != nread) (void)isgsetframe(g, t0 + nread);
+  istime = t0 + nread;
+  return (nread);
+}
+
+/* getstreams reads up to nframes input frames, beginning with the next one
+   that getframe would read, and stores the samples of each input signal s
+   separately, at its own sampling frequency, in buf[s], which must have room
+   for nframes * spf samples (where spf is the number of samples per frame of
+   signal s).  It returns the number of frames read, as getsignals does.
+   Unlike getvec, it neither averages nor repeats samples of signals that are
+   sampled at different frequencies. */
+long getstreams(WFDB_Sample **buf, long nframes) {
+  std::vector<WFDB_Signal> sig(nvsig);
+  WFDB_Signal s;
+
+  for (s = 0; s < nvsig; s++) sig[s] = s;
+  return (getsignals(istime, istime + nframes, sig.data(), nvsig, buf));
+}
+
+/* getsigview obtains a read-only view of frames t0 through t1 - 1 of input
+   signal group g, all of whose signals must be in format 16, without decoding
+   them.  It sets *data to point to the first sample of frame t0.  The frames
+   follow one another, each containing the spf samples of the group (where spf
+   is the total number of samples per frame of its signals) in the order in
+   which they appear in the signal file.  If valid is not NULL, it must have
+   room for ((t1 - t0) * spf + 7) / 8 bytes;  bit i % 8 of valid[i / 8] is set
+   to 1 if sample i of the view is valid, or to 0 if it is the value that marks
+   an invalid sample (-32768).  Skew is not corrected.  getsigview returns the
+   number of frames in the view, which is less than t1 - t0 only if the end of
+   the record or of the signal file is reached, or -1 if the group cannot be
+   viewed (if it is not in format 16, or belongs to a multi-segment record, or
+   its file does not permit seeks), or -2 if its file cannot be read.  The view
+   remains valid until getsigview is called again or the input signals are
+   closed, and getsigview does not change the frames read next by getframe and
+   the like.
+
+   If the signal file is mapped into memory (see setimmap), and the host stores
+   16-bit integers least significant byte first, the view points directly into
+   the mapping;  otherwise, the frames are read (using wfdb_pread) into a buffer
+   belonging to the current record. */
+long getsigview(WFDB_Group g, WFDB_Time t0, WFDB_Time t1, const int16_t **data,
+                unsigned char *valid) {
+  static const uint16_t one = 1;
+  int le = *(const unsigned char *)&one; /* 1 if the host is little-endian */
+  long i, n, nb, ns;
+  int64_t offset;
+  const unsigned char *p = NULL;
+  unsigned char *q, c;
+  struct igdata *ig;
+  struct stat st;
+  WFDB_Signal s;
+
+  if (g < 0 || g >= nigroup || in_msrec || t0 < 0 || t1 < t0) return (-1);
+  ig = igd[g];
+  if (ig->fp == NULL || ig->nsig == 0) return (-1);
+  for (s = ig->sig0; s < ig->sig0 + ig->nsig; s++)
+    if (isd[s]->info.fmt != 16) return (-1);
+  nb = 2L * ig->spf; /* bytes per frame */
+  if (t0 > (INT64_MAX - ig->start) / nb) return (-1);
+  offset = ig->start + t0 * nb;
+  n = (t1 - t0 < LONG_MAX / nb) ? t1 - t0 : LONG_MAX / nb;
+
+  if (ig->fp->type == FileType::kMapped) {
+    if (offset > ig->fp->maplen) offset = ig->fp->maplen;
+    if (n > (ig->fp->maplen - offset) / nb) n = (ig->fp->maplen - offset) / nb;
+    p = (const unsigned char *)ig->fp->map + offset;
+  } else if (!ig->seek)
+    return (-1);
+  /* Otherwise, view no more than the frames that remain, so that the buffer is
+     no larger than needed (or possible) if t1 is far past the end. */
+  else if (nsamples > 0) {
+    if (n > nsamples - t0) n = (t0 < nsamples) ? nsamples - t0 : 0;
+  } else if (ig->fp->type == FileType::kLocal &&
+             fstat(fileno(ig->fp->fp), &st) == 0 && S_ISREG(st.st_mode) &&
+             n > (st.st_size - offset) / nb)
+    n = (offset < st.st_size) ? (st.st_size - offset) / nb : 0;
+
+  if (p && le && (uintptr_t)p % alignof(int16_t) == 0)
+    *data = (const int16_t *)p;
+  else {
+    if (n > LONG_MAX / ig->spf) return (-1);
+    if (viewbuflen < n * ig->spf) {
+      SREALLOC(viewbuf, n * ig->spf, sizeof(int16_t));
+      viewbuflen = n * ig->spf;
+    }
+    if (p)
+      memcpy(viewbuf, p, n * nb);
+    else if ((i = wfdb_pread(ig->fp, viewbuf, n * nb, offset)) < 0)
+      return (-2);
+    else
+      n = i / nb;
+    if (!le) /* swap the bytes of each sample */
+      for (i = 0, q = (unsigned char *)viewbuf; i < n * ig->spf; i++, q += 2) {
+        c = q[0];
+        q[0] = q[1];
+        q[1] = c;
+      }
+    *data = viewbuf;
+  }
+
+  if (valid) {
+    ns = n * ig->spf;
+    memset(valid, 0, (ns + 7) / 8);
+    for (i = 0; i < ns; i++)
+      if ((*data)[i] != -1 << 15) valid[i >> 3] |= 1 << (i & 7);
+  }
+  return (n);
+}
+
 int putvec(const WFDB_Sample *vector) {
   int c, dif, stat = (int)nosig;
   struct osdata *os;
@@ -2668,32 +6468,8 @@ int putvec(const WFDB_Sample *vector) {
       os->info.initval = os->samp = *vector;
     for (c = 0; c < os->info.spf; c++, vector++) {
       /* Replace invalid samples with lowest possible value for format */
-      if ((samp = *vector) == WFDB_INVALID_SAMPLE) switch (os->info.fmt) {
-          case 0:
-          case 8:
-          case 16:
-          case 61:
-          case 160:
-          default:
-            samp = -1 << 15;
-            break;
-          case 80:
-            samp = -1 << 7;
-            break;
-          case 212:
-            samp = -1 << 11;
-            break;
-          case 310:
-          case 311:
-            samp = -1 << 9;
-            break;
-          case 24:
-            samp = -1 << 23;
-            break;
-          case 32:
-            samp = -1 << 31;
-            break;
-        }
+      if ((samp = *vector) == WFDB_INVALID_SAMPLE)
+        samp = oinvalid(os->info.fmt);
       switch (os->info.fmt) {
         case 0: /* null signal (do not write) */
           os->samp = samp;
@@ -2743,12 +6519,13 @@ int putvec(const WFDB_Sample *vector) {
           w24(samp, og);
           os->samp = samp;
           break;
-        case 32: /* 32-bit amplitudes */
+        case 32:    /* 32-bit amplitudes */
+        case CZFMT: /* compressed (encoded by czput) */
           w32(samp, og);
           os->samp = samp;
           break;
       }
-      if (wfdb_ferror(og->fp)) {
+      if (oerror(og)) {
         wfdb_error("putvec: write error in signal %d\n", s);
         stat = -1;
       } else
@@ -2759,6 +6536,95 @@ int putvec(const WFDB_Sample *vector) {
   return (stat);
 }
 
+/* putvecs writes n frames from vector (which contains n times as many samples
+as the vector passed to putvec) to the output signals, with the same effect as
+n calls to putvec.  The samples for each signal group are collected in pvbuf,
+in the order in which they are to be written, and then packed into the group's
+output buffer by opack.  putvecs returns n, or 0 if any format 8 signal changed
+too rapidly to be written exactly (as for putvec), or -1 if a write error
+occurred. */
+long putvecs(const WFDB_Sample *vector, long n) {
+  const WFDB_Sample *vp;
+  struct osdata *os;
+  struct ogdata *og;
+  WFDB_Signal s, s0, s1;
+  WFDB_Sample samp, *bp;
+  long f, f0, m, stat = n;
+  int c, dif, fmt, diff, clipped = 0;
+  unsigned flen, glen, goff;
+
+  if (n <= 0L || nosig == 0) return (0L);
+  for (s = 0, flen = 0; s < nosig; s++) flen += osd[s]->info.spf;
+
+  /* Write the signals of each group (s0 through s1-1), in turn. */
+  for (s0 = 0, goff = 0; s0 < nosig; s0 = s1, goff += glen) {
+    og = ogd[osd[s0]->info.group];
+    fmt = osd[s0]->info.fmt;
+    for (s1 = s0, glen = 0;
+         s1 < nosig && osd[s1]->info.group == osd[s0]->info.group; s1++)
+      glen += osd[s1]->info.spf;
+    switch (fmt) {
+      case 0:
+      case 16:
+      case 61:
+      case 80:
+      case 160:
+      case 212:
+      case 310:
+      case 311:
+      case 24:
+      case 32:
+      case CZFMT:
+        diff = 0;
+        break;
+      case 8:
+      default:
+        diff = 1; /* first differences are written */
+        break;
+    }
+    if ((m = BLKLEN / glen) < 1) m = 1;
+    if (pvbuflen < m * glen) {
+      SREALLOC(pvbuf, m * glen, sizeof(WFDB_Sample));
+      pvbuflen = m * glen;
+    }
+    for (f0 = 0L; f0 < n; f0 += m) {
+      if (m > n - f0) m = n - f0;
+      for (f = f0, bp = pvbuf; f < f0 + m; f++) {
+        vp = vector + f * flen + goff;
+        for (s = s0; s < s1; s++) {
+          os = osd[s];
+          if (os->info.nsamp++ == (WFDB_Time)0L)
+            os->info.initval = os->samp = *vp;
+          for (c = 0; c < os->info.spf; c++, vp++) {
+            if ((samp = *vp) == WFDB_INVALID_SAMPLE) samp = oinvalid(fmt);
+            if (diff) {
+              /* Handle large slew rates sensibly. */
+              if ((dif = samp - os->samp) < -128) {
+                dif = -128;
+                clipped = 1;
+              } else if (dif > 127) {
+                dif = 127;
+                clipped = 1;
+              }
+              os->samp += dif;
+              *bp++ = dif;
+            } else
+              *bp++ = os->samp = samp;
+            os->info.cksum += os->samp;
+          }
+        }
+      }
+      opack(og, fmt, pvbuf, bp - pvbuf);
+      if (og->fp && oerror(og)) {
+        wfdb_error("putvecs: write error in signal %d\n", s0);
+        stat = -1L;
+      }
+    }
+  }
+  ostime += n;
+  return ((stat > 0L && clipped) ? 0L : stat);
+}
+
 int isigsettime(WFDB_Time t) {
   WFDB_Group g;
   WFDB_Time curtime;
@@ -2820,10 +6686,14 @@ int isgsettime(WFDB_Group g, WFDB_Time t) {
       }
     }
     if (ifreq > (WFDB_Frequency)0 && ifreq != sfreq) {
-      gvtime = 0;
-      rgvstat = rgetvec(gv0);
-      rgvstat = rgetvec(gv1);
-      rgvtime = nticks;
+      if (rstab)
+        rsreset();
+      else {
+        gvtime = 0;
+        rgvstat = rgetvec(gv0);
+        rgvstat = rgetvec(gv1);
+        rgvtime = nticks;
+      }
     }
   }
 
@@ -2895,6 +6765,149 @@ int setibsize(int n) {
   return (ibsize = n);
 }
 
+/* setimmap(0) disables, and setimmap(1) enables, memory mapping of local
+signal files opened by subsequent calls to isigopen.  setimmap(-1) restores
+the default, which is given by the value of the environment variable WFDBMMAP
+(if set) or otherwise is not to map signal files.  A mapped signal file is read
+as it was when it was opened, even if it grows later, so mapping should not be
+enabled for files that are still being written.  The previous setting is
+returned. */
+int setimmap(int mode) {
+  if (mode < 0) {
+    char *p;
+
+    if (p = getenv("WFDBMMAP"))
+      mode = strtol(p, NULL, 10);
+    else
+      mode = 0;
+  }
+  return (immap.exchange(mode != 0));
+}
+
+/* setoasync(n) selects asynchronous output, using n buffers (at most OWMAXBUF)
+for each output signal group, for output signals opened subsequently in any
+record;  while one buffer is being filled by putvec, the others are written to
+the signal file by a separate thread.  setoasync(0) or setoasync(1) selects
+synchronous output (with one buffer per group), and setoasync(-1) restores the
+default, which is given by the value of the environment variable WFDBOASYNC (if
+set) or otherwise is synchronous output.  The previous setting is returned. */
+int setoasync(int n) {
+  if (n < 0) {
+    char *p;
+
+    if ((p = getenv("WFDBOASYNC")) == NULL || (n = strtol(p, NULL, 10)) < 0)
+      n = 0;
+  }
+  if (n > OWMAXBUF) n = OWMAXBUF;
+  return (onbuf.exchange(n));
+}
+
+/* setiprefetch(n) selects read-ahead, using n buffers (at most IRMAXBUF) for
+each input signal group, for input signals opened subsequently in any record;
+while the samples in one buffer are being read by getvec, etc., the following
+blocks of the signal file are read into the others by a separate thread.  Read-
+ahead applies only to local signal files that permit seeks, and that are not
+mapped into memory (see setimmap).  setiprefetch(0) or setiprefetch(1) disables
+read-ahead, and setiprefetch(-1) restores the default, which is given by the
+value of the environment variable WFDBPREFETCH (if set) or otherwise is not to
+read ahead.  The previous setting is returned. */
+int setiprefetch(int n) {
+  if (n < 0) {
+    char *p;
+
+    if ((p = getenv("WFDBPREFETCH")) == NULL || (n = strtol(p, NULL, 10)) < 0)
+      n = 0;
+  }
+  if (n > IRMAXBUF) n = IRMAXBUF;
+  return (inbuf.exchange(n));
+}
+
+/* setsegprefetch(1) selects prefetching of the segments of multi-segment
+records opened subsequently:  while each segment is being read, the header of
+the next segment is read and its signal files are opened by a separate thread,
+so that reading continues without delay at the boundary between them.
+setsegprefetch(0) disables prefetching, and setsegprefetch(-1) restores the
+default, which is given by the value of the environment variable
+WFDBSEGPREFETCH (if set) or otherwise is not to prefetch segments.  Any
+prefetch already started for the current record is finished first (and is
+used, as usual, when the record reaches that segment).  The previous setting
+is returned. */
+int setsegprefetch(int on) {
+  if (segfetch && segfetch->thread.joinable()) segfetch->thread.join();
+  if (on < 0) {
+    char *p;
+
+    if ((p = getenv("WFDBSEGPREFETCH")) == NULL ||
+        (on = strtol(p, NULL, 10)) < 0)
+      on = 0;
+  }
+  return (isegfetch.exchange(on != 0));
+}
+
+/* setithreads(n) selects the number of threads (at most IDMAXTHR, including
+the calling thread) used by getframes, getvecs, and getsignals to decode input
+signals, in all records.  With more than one thread, the signal groups of a
+record that has two or more of them are decoded concurrently, a block of frames
+at a time, and getsignals divides long ranges of local signal files into chunks
+that are decoded concurrently.
+setithreads(1) decodes all signals in the calling thread, and setithreads(-1)
+restores the default, which is given by the value of the environment variable
+WFDBITHREADS (if set) or is otherwise 1.  setithreads must not be called while
+another thread is reading signals.  The previous setting is returned. */
+int setithreads(int n) {
+  int prev = ithreads;
+  std::lock_guard<std::mutex> job(pool.job);
+
+  if (n < 0) {
+    char *p;
+
+    if ((p = getenv("WFDBITHREADS")) == NULL || (n = strtol(p, NULL, 10)) < 1)
+      n = 1;
+  }
+  if (n < 1) n = 1;
+  if (n > IDMAXTHR) n = IDMAXTHR;
+  ithreads = n;
+  pool.pstop();
+  try {
+    while (pool.threads.size() < (size_t)n - 1)
+      pool.threads.emplace_back(pworker, pool.gen);
+  } catch (...) {
+    /* Continue with as many worker threads as could be started. */
+  }
+  return (prev);
+}
+
+/* sdefaults gives each of the settings above that has not been made by the
+   application its default value (see setimmap, etc.).  It is invoked by
+   isigopen, openosig, osigfopen, and sample, and does its work only once, even
+   if several threads invoke it at the same time. */
+static void sdefaults(void) {
+  std::call_once(sdefault_once, [] {
+    if (ibsize <= 0) ibsize = BUFSIZ;
+    if (obsize <= 0) obsize = BUFSIZ;
+    if (immap < 0) (void)setimmap(-1);
+    if (nsbmax < 0) (void)setsampcache(-1);
+    if (onbuf < 0) (void)setoasync(-1);
+    if (inbuf < 0) (void)setiprefetch(-1);
+    if (ithreads < 0) (void)setithreads(-1);
+    if (isegfetch < 0) (void)setsegprefetch(-1);
+  });
+}
+
+/* sethcache(file) enables the header cache (see hcacheget), which is shared by
+all record handles, and sethcache(NULL) disables it.  If file is not empty, the
+cache is loaded from the named cache file, if it exists (and the file is
+rewritten without any copies that have been replaced), and copies of headers
+that are subsequently read are appended to it.  Initially, the cache is enabled
+if the environment variable WFDBHCACHE is set, using its value as the name of
+the cache file.  sethcache returns 0, or -1 if file exists but could not be
+loaded (in which case the cache is enabled without a cache file). */
+int sethcache(const char *file) {
+  std::lock_guard<std::mutex> lock(hcmutex);
+
+  return (hcacheset(file));
+}
+
 int setobsize(int n) {
   if (nosig) {
     wfdb_error("setobsize: can't change buffer size after osig[f]open\n");
@@ -3153,6 +7166,7 @@ int wfdbputprolog(const char *buf, long int size, WFDB_Signal s) {
   long int n;
   WFDB_Group g = osd[s]->info.group;
 
+  owait();
   n = wfdb_fwrite(buf, 1, size, ogd[g]->fp);
   wfdbsetstart(s, n);
   if (n != size)
@@ -3205,8 +7219,7 @@ first one.  On subsequent calls, return a pointer to the next info string.
 Return NULL if there are no more info strings. */
 
 char *getinfo(char *record) {
-  static char buf[256], *p;
-  static int i;
+  char buf[256], *p;
   WFDB_FILE *ifile;
 
   if (record) wfdb_freeinfo();
@@ -3222,7 +7235,7 @@ char *getinfo(char *record) {
       ninfo = 0;
     }
 
-    i = 0;
+    pinfoi = 0;
     nimax = 16; /* initial allotment of info string pointers */
     SALLOC(pinfo, nimax, sizeof(char *));
 
@@ -3274,8 +7287,8 @@ char *getinfo(char *record) {
       wfdb_fclose(ifile);
     }
   }
-  if (i < ninfo)
-    return pinfo[i++];
+  if (pinfoi < ninfo)
+    return pinfo[pinfoi++];
   else
     return (NULL);
 }
@@ -3312,9 +7325,10 @@ int setsampfreq(WFDB_Frequency freq) {
   return (-1);
 }
 
-static char date_string[37];
-static char time_string[62];
-static WFDB_Date pdays = -1;
+static thread_local char date_string[37];
+static thread_local char time_string[62];
+static thread_local WFDB_Date pdays = -1; /* days since bdate for the date
+                                             in date_string (see ftimstr) */
 
 #ifndef __STDC__
 #ifndef _WINDOWS
@@ -3644,6 +7658,292 @@ WFDB_Sample physadu(WFDB_Signal s, double v) {
     return ((int)(v - 0.5) + b);
 }
 
+/* Block conversions between ADC units and physical units
+
+The functions below convert n samples at a time, yielding exactly the same
+results as aduphys and physadu, except that invalid samples
+(WFDB_INVALID_SAMPLE) become NaNs in physical units, and vice versa.  The
+kernels, physk and aduk, take tables of baselines (b) and gains (g) with p
+entries each, where p is a multiple of 4;  sample i is converted using entry
+i % p of each table.  This allows a single pass over a block of interleaved
+frames, as well as over the samples of a single signal. */
+
+#if !defined(NOSIMD) && defined(__AVX2__)
+static inline void storepd(double *x, __m256d v) { _mm256_storeu_pd(x, v); }
+static inline void storepd(float *x, __m256d v) {
+  _mm_storeu_ps(x, _mm256_cvtpd_ps(v));
+}
+static inline __m256d loadpd(const double *x) { return (_mm256_loadu_pd(x)); }
+static inline __m256d loadpd(const float *x) {
+  return (_mm256_cvtps_pd(_mm_loadu_ps(x)));
+}
+#elif !defined(NOSIMD) && defined(__SSE2__)
+static inline void storepd(double *x, __m128d v) { _mm_storeu_pd(x, v); }
+static inline void storepd(float *x, __m128d v) {
+  _mm_storel_pi((__m64 *)x, _mm_cvtpd_ps(v));
+}
+static inline __m128d loadpd(const double *x) { return (_mm_loadu_pd(x)); }
+static inline __m128d loadpd(const float *x) {
+  return (_mm_cvtps_pd(_mm_castpd_ps(_mm_load_sd((const double *)x))));
+}
+#endif
+
+template <typename T>
+static void physk(const WFDB_Sample *a, T *x, long n, const double *b,
+                  const double *g, long p) {
+  long i = 0, k = 0;
+
+#if !defined(NOSIMD) && defined(__AVX2__)
+  const __m128i invalid = _mm_set1_epi32(WFDB_INVALID_SAMPLE);
+  const __m256d nan = _mm256_set1_pd(NAN);
+
+  for (; i + 4 <= n; i += 4, a += 4, x += 4) {
+    __m128i w = _mm_loadu_si128((const __m128i *)a);
+    __m256d m = _mm256_castsi256_pd(
+        _mm256_cvtepi32_epi64(_mm_cmpeq_epi32(w, invalid)));
+    __m256d v = _mm256_div_pd(
+        _mm256_sub_pd(_mm256_cvtepi32_pd(w), _mm256_loadu_pd(b + k)),
+        _mm256_loadu_pd(g + k));
+
+    storepd(x, _mm256_blendv_pd(v, nan, m));
+    if ((k += 4) == p) k = 0;
+  }
+#elif !defined(NOSIMD) && defined(__SSE2__)
+  const __m128i invalid = _mm_set1_epi32(WFDB_INVALID_SAMPLE);
+  const __m128d nan = _mm_set1_pd(NAN);
+
+  for (; i + 2 <= n; i += 2, a += 2, x += 2) {
+    __m128i w = _mm_loadl_epi64((const __m128i *)a);
+    __m128i e = _mm_cmpeq_epi32(w, invalid);
+    __m128d m = _mm_castsi128_pd(_mm_unpacklo_epi32(e, e));
+    __m128d v = _mm_div_pd(_mm_sub_pd(_mm_cvtepi32_pd(w), _mm_loadu_pd(b + k)),
+                           _mm_loadu_pd(g + k));
+
+    storepd(x, _mm_or_pd(_mm_and_pd(m, nan), _mm_andnot_pd(m, v)));
+    if ((k += 2) == p) k = 0;
+  }
+#endif
+  for (; i < n; i++, a++, x++) {
+    *x = (*a == WFDB_INVALID_SAMPLE) ? (T)NAN : (T)((*a - b[k]) / g[k]);
+    if (++k == p) k = 0;
+  }
+}
+
+template <typename T>
+static void aduk(const T *x, WFDB_Sample *a, long n, const double *b,
+                 const double *g, long p) {
+  long i = 0, k = 0;
+  double v;
+
+#if !defined(NOSIMD) && defined(__AVX2__)
+  const __m256d sign = _mm256_set1_pd(-0.0), half = _mm256_set1_pd(0.5);
+  const __m128i invalid = _mm_set1_epi32(WFDB_INVALID_SAMPLE);
+  const __m256i pick = _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6);
+
+  for (; i + 4 <= n; i += 4, a += 4, x += 4) {
+    __m256d t = _mm256_mul_pd(loadpd(x), _mm256_loadu_pd(g + k));
+    __m256d r = _mm256_or_pd(half, _mm256_and_pd(sign, t));
+    __m128i m = _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(
+        _mm256_castpd_si256(_mm256_cmp_pd(t, t, _CMP_UNORD_Q)), pick));
+    __m128i w = _mm_add_epi32(_mm256_cvttpd_epi32(_mm256_add_pd(t, r)),
+                              _mm256_cvttpd_epi32(_mm256_loadu_pd(b + k)));
+
+    _mm_storeu_si128((__m128i *)a,
+                     _mm_or_si128(_mm_and_si128(m, invalid),
+                                  _mm_andnot_si128(m, w)));
+    if ((k += 4) == p) k = 0;
+  }
+#elif !defined(NOSIMD) && defined(__SSE2__)
+  const __m128d sign = _mm_set1_pd(-0.0), half = _mm_set1_pd(0.5);
+  const __m128i invalid = _mm_set1_epi32(WFDB_INVALID_SAMPLE);
+
+  for (; i + 2 <= n; i += 2, a += 2, x += 2) {
+    __m128d t = _mm_mul_pd(loadpd(x), _mm_loadu_pd(g + k));
+    __m128d r = _mm_or_pd(half, _mm_and_pd(sign, t));
+    __m128i m = _mm_castpd_si128(_mm_cmpunord_pd(t, t));
+    __m128i w = _mm_add_epi32(_mm_cvttpd_epi32(_mm_add_pd(t, r)),
+                              _mm_cvttpd_epi32(_mm_loadu_pd(b + k)));
+
+    m = _mm_shuffle_epi32(m, _MM_SHUFFLE(3, 3, 2, 0));
+    _mm_storel_epi64((__m128i *)a,
+                     _mm_or_si128(_mm_and_si128(m, invalid),
+                                  _mm_andnot_si128(m, w)));
+    if ((k += 2) == p) k = 0;
+  }
+#endif
+  for (; i < n; i++, a++, x++) {
+    if (isnan(v = *x * g[k]))
+      *a = WFDB_INVALID_SAMPLE;
+    else if (v >= 0)
+      *a = (int)(v + 0.5) + (int)b[k];
+    else
+      *a = (int)(v - 0.5) + (int)b[k];
+    if (++k == p) k = 0;
+  }
+}
+
+/* calpattern fills in p entries of the baseline and gain tables for physk
+   and aduk, using the calibration of signal s repeated as needed. */
+static void calpattern(WFDB_Signal s, double *b, double *g, int p) {
+  int i;
+  double bs = 0.0, gs = WFDB_DEFGAIN;
+
+  if (0 <= s && s < nvsig) {
+    bs = vsd[s]->info.baseline;
+    if ((gs = vsd[s]->info.gain) == 0.) gs = WFDB_DEFGAIN;
+  }
+  for (i = 0; i < p; i++) b[i] = bs, g[i] = gs;
+}
+
+/* aduphysv converts n samples of signal s, a[0], ..., a[n-1], into physical
+   units, storing the results in x[0], ..., x[n-1].  aduphysvf does the same,
+   but produces floats. */
+void aduphysv(WFDB_Signal s, const WFDB_Sample *a, double *x, long n) {
+  double b[4], g[4];
+
+  calpattern(s, b, g, 4);
+  physk(a, x, n, b, g, 4);
+}
+
+void aduphysvf(WFDB_Signal s, const WFDB_Sample *a, float *x, long n) {
+  double b[4], g[4];
+
+  calpattern(s, b, g, 4);
+  physk(a, x, n, b, g, 4);
+}
+
+/* physaduv and physaduvf convert n samples of signal s, x[0], ..., x[n-1],
+   from physical units into ADC units, storing the results in a[0], ...,
+   a[n-1]. */
+void physaduv(WFDB_Signal s, const double *x, WFDB_Sample *a, long n) {
+  double b[4], g[4];
+
+  calpattern(s, b, g, 4);
+  aduk(x, a, n, b, g, 4);
+}
+
+void physaduvf(WFDB_Signal s, const float *x, WFDB_Sample *a, long n) {
+  double b[4], g[4];
+
+  calpattern(s, b, g, 4);
+  aduk(x, a, n, b, g, 4);
+}
+
+/* getphysframes reads up to nframes frames, as getframes would, but stores
+   them in physical units in vector (which must have room for nframes times
+   the frame size of doubles).  Frames are read in blocks into a small
+   workspace and converted from there, so that no array of WFDB_Samples as
+   large as vector is needed.  getphysframesf does the same, but produces
+   floats.  The return value is as for getframes. */
+template <typename T>
+static long physframes(T *vector, long nframes) {
+  int p = 4 * tspf;
+  long m, n = 0, nread = 0;
+  double *b, *g;
+  WFDB_Signal s;
+  unsigned j;
+
+  if ((m = BLKLEN / tspf) < 1) m = 1;
+  if (rngbuflen < m * tspf) {
+    SREALLOC(rngbuf, m * tspf, sizeof(WFDB_Sample));
+    rngbuflen = m * tspf;
+  }
+  SUALLOC(b, p, sizeof(double));
+  SUALLOC(g, p, sizeof(double));
+  for (j = 0, s = 0; s < nvsig; j += vsd[s++]->info.spf)
+    calpattern(s, b + j, g + j, vsd[s]->info.spf);
+  for (j = tspf; j < (unsigned)p; j++) b[j] = b[j - tspf], g[j] = g[j - tspf];
+
+  while (nread < nframes) {
+    if ((n = getframes(rngbuf, nframes - nread < m ? nframes - nread : m)) <= 0)
+      break;
+    physk(rngbuf, vector + nread * tspf, n * tspf, b, g, p);
+    nread += n;
+    if (n < m && nread < nframes) break;
+  }
+  SFREE(b);
+  SFREE(g);
+  return ((nread > 0 || n >= 0) ? nread : n);
+}
+
+long getphysframes(double *vector, long nframes) {
+  return (physframes(vector, nframes));
+}
+
+long getphysframesf(float *vector, long nframes) {
+  return (physframes(vector, nframes));
+}
+
+/* tsamp stores sample v in *out, converted to a 16-bit integer or a float.
+   An invalid sample becomes -32768 or NaN;  so does a sample that does not
+   fit into a 16-bit integer, which is also counted in *bad. */
+static inline void tsamp(WFDB_Sample v, int16_t *out, long *bad) {
+  if (v < INT16_MIN || v > INT16_MAX) {
+    *out = INT16_MIN;
+    (*bad)++;
+  } else
+    *out = v; /* WFDB_INVALID_SAMPLE is INT16_MIN */
+}
+
+static inline void tsamp(WFDB_Sample v, float *out, long *bad) {
+  *out = (v == WFDB_INVALID_SAMPLE) ? NAN : (float)v;
+}
+
+/* getframes16 reads up to nframes frames, as getframes would, but stores the
+   samples in vector as 16-bit integers (with WFDB_INVALID_SAMPLE marking
+   invalid samples, as usual), so that a caller's copy of a record in memory
+   needs half as much space.  Any sample that does not fit into 16 bits is
+   stored as an invalid sample, and the number of such samples is reported
+   using wfdb_error.  getframesf does the same, but produces floats, with
+   invalid samples stored as NaN.  Like getphysframes, both read blocks of
+   frames into a small workspace and convert them from there.  getvecs16 and
+   getvecsf read sample vectors, as getvecs would (resampling the input
+   signals if so requested), in the same ways.  The return value is as for
+   getframes or getvecs.
+
+   Only the output is narrowed:  decoding, deskewing, resampling and the
+   sample cache all still use WFDB_Samples, so these functions don't reduce
+   the memory that the library itself uses for an open record. */
+template <typename T>
+static long typedframes(const char *func, T *vector, long n, int vecs) {
+  unsigned len = vecs ? nvsig : tspf; /* samples per frame or vector */
+  long bad = 0L, i, k = 0L, m, nread = 0L;
+
+  if ((m = BLKLEN / len) < 1) m = 1;
+  if (rngbuflen < m * len) {
+    SREALLOC(rngbuf, m * len, sizeof(WFDB_Sample));
+    rngbuflen = m * len;
+  }
+  while (nread < n) {
+    if (n - nread < m) m = n - nread;
+    if ((k = vecs ? getvecs(rngbuf, m) : getframes(rngbuf, m)) <= 0) break;
+    for (i = 0; i < k * len; i++) tsamp(rngbuf[i], vector + i, &bad);
+    vector += k * len;
+    nread += k;
+    if (k < m) break;
+  }
+  if (bad)
+    wfdb_error("%s: %ld sample%s out of range for 16 bits\n", func, bad,
+               bad > 1 ? "s" : "");
+  return ((nread > 0 || k >= 0) ? nread : k);
+}
+
+long getframes16(int16_t *vector, long nframes) {
+  return (typedframes("getframes16", vector, nframes, 0));
+}
+
+long getframesf(float *vector, long nframes) {
+  return (typedframes("getframesf", vector, nframes, 0));
+}
+
+long getvecs16(int16_t *vector, long nvecs) {
+  return (typedframes("getvecs16", vector, nvecs, 1));
+}
+
+long getvecsf(float *vector, long nvecs) {
+  return (typedframes("getvecsf", vector, nvecs, 1));
+}
+
 /* sample(s, t) provides buffered random access to the input signals.  The
 arguments are the signal number (s) and the sample number (t); the returned
 value is the sample from signal s at time t.  On return, the global variable
@@ -3651,19 +7951,29 @@ sample_vflag is true (non-zero) if the requested sample is not beyond the end
 of the record, false (zero) otherwise.  The caller must open the input signals
 and must set the global variable nisig to the number of input signals before
 invoking sample().  Once this has been done, the caller may request samples in
-any order. */
+any order.  For a sample beyond the end of the record, sample() returns the last
+sample of signal s, or WFDB_INVALID_SAMPLE if the record is empty, or if its
+length is not given by its header and the sample is far beyond the end. */
 
-#define BUFLN 4096 /* must be a power of 2, see sample() */
+#define SBLEN 1024    /* vectors per cached block;  must be a power of 2 */
+#define DEFSBCOUNT 16 /* default number of cached blocks */
 
 WFDB_Sample sample(WFDB_Signal s, WFDB_Time t) {
-  static WFDB_Sample v;
-  static WFDB_Time tt;
-  int nsig = (nvsig > nisig) ? nvsig : nisig;
-
-  /* Allocate the sample buffer on the first call. */
+  WFDB_Sample v;
+  WFDB_Time t0, te;
+  int i, j, nsig = (nvsig > nisig) ? nvsig : nisig;
+  long n;
+  struct sblock *sb;
+
+  /* Allocate the block table on the first call, and again if setsampcache
+     has changed the number of blocks since then. */
+  if (sbuf && nsblock != nsbmax) sbfree();
   if (sbuf == NULL) {
-    SALLOC(sbuf, nsig, BUFLN * sizeof(WFDB_Sample));
-    tt = (WFDB_Time)-1L;
+    sdefaults();
+    nsblock = nsbmax;
+    SUALLOC(sbuf, nsblock, sizeof(struct sblock));
+    for (i = 0; i < nsblock; i++) sbuf[i].t0 = (WFDB_Time)-1L;
+    sbtime = (WFDB_Time)-1L;
   }
 
   /* If the caller requested a sample from an unavailable signal, return
@@ -3679,33 +7989,66 @@ WFDB_Sample sample(WFDB_Signal s, WFDB_Time t) {
      absolute value of the sample number matters. */
   if (t < 0L) t = 0L;
 
-  /* If the caller has requested a sample that is no longer in the buffer,
-     or if the caller has requested a sample that is further ahead than the
-     length of the buffer, we need to reset the signal file pointer(s).
-     If we do this, we must be sure that the buffer is refilled so that
-     any subsequent requests for samples between t - BUFLN+1 and t will
-     receive correct responses. */
-  if (t <= tt - BUFLN || t > tt + BUFLN) {
-    tt = t - BUFLN;
-    if (tt < 0L) tt = -1L;
-    if (isigsettime(tt + 1) < 0) {
-      sample_vflag = 0;
-      return (WFDB_INVALID_SAMPLE);
-    }
-  }
-  /* If the requested sample is not yet in the buffer, read and buffer
-     more samples.  If we reach the end of the record, clear sample_vflag
-     and return the last valid value. */
-  while (t > tt)
-    if (getvec(sbuf + nsig * ((++tt) & (BUFLN - 1))) < 0) {
-      --tt;
-      sample_vflag = 0;
-      return (*(sbuf + nsig * (tt & (BUFLN - 1)) + s));
-    }
-
-  /* The requested sample is in the buffer.  Set sample_vflag and
+  /* If the length of the record (te, in samples as returned by getvec) is
+     known, the last valid value for a sample beyond its end is the last
+     sample of the record. */
+  te = (in_msrec ? msnsamples : nsamples) *
+       (((gvmode & WFDB_HIGHRES) == WFDB_HIGHRES) ? spfmax : 1);
+  if (ifreq > 0.0 && ifreq != sfreq) te = (WFDB_Time)(te * ifreq / sfreq);
+  if (te > 0L && t >= te) {
+    v = sample(s, te - 1);
+    sample_vflag = 0;
+    return (v);
+  }
+
+  /* Look for the block containing the requested sample.  If it is not in
+     the cache, it replaces the least recently used block. */
+  t0 = t & ~(WFDB_Time)(SBLEN - 1);
+  for (i = j = 0; i < nsblock; i++) {
+    if (sbuf[i].t0 == t0) break;
+    if (sbuf[i].used < sbuf[j].used) j = i;
+  }
+  if (i < nsblock) {
+    sb = &sbuf[i];
+    sbhits++;
+  } else {
+    sb = &sbuf[j];
+    sbmisses++;
+    sb->t0 = (WFDB_Time)-1L;
+    if (sb->v == NULL) SUALLOC(sb->v, SBLEN * nsig, sizeof(WFDB_Sample));
+
+    /* Unless the block follows the one read most recently (and the input
+       signals have not been read by anyone else since then), the signal
+       file pointer(s) must be reset. */
+    if (sbtime != t0 || sbistime != istime) {
+      sbtime = (WFDB_Time)-1L;
+      if (isigsettime(t0) < 0) {
+        sample_vflag = 0;
+        return (WFDB_INVALID_SAMPLE);
+      }
+    }
+    for (n = 0; n < SBLEN && getvec(sb->v + n * nsig) >= 0; n++)
+      ;
+    sb->t0 = t0;
+    sb->n = n;
+    if (n == SBLEN) {
+      sbtime = t0 + n;
+      sbistime = istime;
+    } else
+      sbtime = (WFDB_Time)-1L;
+  }
+  sb->used = ++sbclock;
+
+  /* If the requested sample is beyond the end of the record, clear
+     sample_vflag and return the last valid value (if any). */
+  if (t - t0 >= sb->n) {
+    sample_vflag = 0;
+    return (sb->n > 0 ? sb->v[(sb->n - 1) * nsig + s] : WFDB_INVALID_SAMPLE);
+  }
+
+  /* The requested sample is in the block.  Set sample_vflag and
      return the requested sample. */
-  if ((v = *(sbuf + nsig * (t & (BUFLN - 1)) + s)) == WFDB_INVALID_SAMPLE)
+  if ((v = sb->v[(t - t0) * nsig + s]) == WFDB_INVALID_SAMPLE)
     sample_vflag = -1;
   else
     sample_vflag = 1;
@@ -3714,16 +8057,135 @@ WFDB_Sample sample(WFDB_Signal s, WFDB_Time t) {
 
 int sample_valid() { return (sample_vflag); }
 
+/* setsampcache sets the number of blocks of SBLEN sample vectors that sample()
+may keep in memory for each record (at least 1);  requests for samples in any
+of these blocks are satisfied without reading the input signals again.
+setsampcache(-1) restores the default, which is given by the value of the
+environment variable WFDBSAMPCACHE (if set) or otherwise is DEFSBCOUNT.  The
+current record's cache is emptied, as is that of any other record (see
+wfdbsetrecord) when sample() is next called for it, if the number of blocks
+has changed.  The previous setting is returned. */
+int setsampcache(int nblocks) {
+  if (nblocks < 0) {
+    char *p;
+
+    if ((p = getenv("WFDBSAMPCACHE")) == NULL ||
+        (nblocks = strtol(p, NULL, 10)) < 1)
+      nblocks = DEFSBCOUNT;
+  }
+  if (nblocks < 1) nblocks = 1;
+  sbfree();
+  return (nsbmax.exchange(nblocks));
+}
+
+/* getsampcache stores the numbers of requests that sample() has satisfied
+   from its cache (hits) and by reading the input signals (misses) since the
+   current record was opened. */
+void getsampcache(long *hits, long *misses) {
+  if (hits) *hits = sbhits;
+  if (misses) *misses = sbmisses;
+}
+
+/* Record handles.  Each WfdbRecord has its own set of open input and output
+signals, annotators, and info strings, so that a program can read several
+records at once, using one thread per record if desired.  A thread selects a
+record handle using wfdbsetrecord, after which all WFDB library functions
+invoked by that thread operate on the selected record.  Threads that never
+select a handle share the default record, as in earlier versions of the
+library.  A record handle may be used by only one thread at a time.
+
+The annotation mnemonic and description tables are not part of a record handle.
+They are shared by all handles, like the settings made by setibsize, setimmap,
+etc.  A change made by setannstr or setanndesc, or by reading the table at the
+beginning of an input annotation file, is therefore seen by every handle, and
+is written into the tables of the output annotation files of every handle.
+
+The isigopen_r, getvec_r, etc., functions below select the specified handle
+for the duration of a single call.  Any other WFDB library function can be
+used in the same way, via WfdbRecordScope (see signal.hh). */
+
+WfdbRecord *wfdbnewrecord() {
+  WfdbRecord *r = new (std::nothrow) WfdbRecord();
+
+  if (r == NULL || (r->ann = wfdb_newannstate()) == NULL) {
+    delete r;
+    wfdb_error("wfdbnewrecord: can't allocate record handle\n");
+    return (NULL);
+  }
+  return (r);
+}
+
+void wfdbfreerecord(WfdbRecord *r) {
+  if (r == NULL || r == &default_record) return;
+  {
+    WfdbRecordScope scope(r);
+
+    wfdb_anclose();
+    wfdb_oinfoclose();
+    wfdb_sigclose();
+    wfdb_sampquit();
+    wfdb_freeinfo();
+  }
+  if (cur == r) (void)wfdbsetrecord(NULL);
+  wfdb_freeannstate(r->ann);
+  delete r;
+}
+
+WfdbRecord *wfdbsetrecord(WfdbRecord *r) {
+  WfdbRecord *prev = cur;
+
+  if (r == NULL) r = &default_record;
+  if (r != cur) {
+    cur = r;
+    (void)wfdb_setannstate(r->ann);
+    pdays = -1; /* date_string (see ftimstr) belongs to the previous record */
+  }
+  return (prev);
+}
+
+int isigopen_r(WfdbRecord *r, char *record, WFDB_Siginfo *siarray, int nsig) {
+  WfdbRecordScope scope(r);
+
+  return (isigopen(record, siarray, nsig));
+}
+
+int getvec_r(WfdbRecord *r, WFDB_Sample *vector) {
+  WfdbRecordScope scope(r);
+
+  return (getvec(vector));
+}
+
+int isigsettime_r(WfdbRecord *r, WFDB_Time t) {
+  WfdbRecordScope scope(r);
+
+  return (isigsettime(t));
+}
+
+WFDB_Sample sample_r(WfdbRecord *r, WFDB_Signal s, WFDB_Time t) {
+  WfdbRecordScope scope(r);
+
+  return (sample(s, t));
+}
+
 /* Private functions (for use by other WFDB library functions only). */
 
-void wfdb_sampquit() {
+void wfdb_sampquit() { sbfree(); }
+
+/* sbfree releases the blocks cached by sample(). */
+static void sbfree(void) {
+  int i;
+
   if (sbuf) {
+    for (i = 0; i < nsblock; i++) SFREE(sbuf[i].v);
     SFREE(sbuf);
-    sample_vflag = 0;
   }
+  nsblock = 0;
+  sbhits = sbmisses = 0L;
+  sample_vflag = 0;
 }
 
 void wfdb_sigclose() {
+  in_msrec = 0; /* free all input signal structures */
   isigclose();
   osigclose();
   btime = bdate = nsamples = msbtime = msbdate = msnsamples = (WFDB_Time)0;
@@ -3746,12 +8208,28 @@ void wfdb_sigclose() {
     }
   }
   SFREE(segarray_L);
+  segtextfree();
+  SFREE(hcap);
+  hcapsize = 0L;
+  hcaplen = -1L;
   SFREE(gv0);
   SFREE(gv1);
+  SFREE(rstab);
+  SFREE(rshist);
   SFREE(tvector);
   SFREE(uvector);
   SFREE(vvector);
   tuvlen = 0;
+  SFREE(blkbuf);
+  blkbuflen = 0;
+  SFREE(rngbuf);
+  rngbuflen = 0;
+  SFREE(pdbuf);
+  pdbuflen = 0;
+  SFREE(viewbuf);
+  viewbuflen = 0;
+  SFREE(vecbuf);
+  vecbuflen = 0;
 
   sigmap_cleanup();
 }
@@ -3764,6 +8242,7 @@ void wfdb_osflush() {
 
   if (!osd || !ogd) return;
 
+  owait();
   for (s = 0; s < nosig; s++) {
     if ((os = osd[s]) && (og = ogd[os->info.group]) && og->nrewind == 0) {
       if (!og->force_flush && og->seek == 0) {
@@ -3793,9 +8272,15 @@ void wfdb_osflush() {
     }
   }
 
+  owait(); /* f212, etc., may have filled a buffer */
   for (g = 0; g < nogroup; g++) {
     og = ogd[g];
-    if (og->bsize == 0 && og->bp != og->buf) {
+    /* The blocks of a compressed file are written only when complete, except
+       for the last, which is written with the index when the file is
+       closed. */
+    if (og->cz) {
+      if (og->force_flush && og->fp) (void)czclose(og);
+    } else if (og->bsize == 0 && og->bp != og->buf) {
       (void)wfdb_fwrite(og->buf, 1, og->bp - og->buf, og->fp);
       og->bp = og->buf;
     }
@@ -3834,3 +8319,120 @@ int wfdb_oinfoclose() {
   outinfo = NULL;
   return (stat);
 }
+
+/* Undefine the names of fields of the current record (see cur). */
+#undef maxhsig
+#undef hheader
+#undef hsd
+#undef ffreq
+#undef ifreq
+#undef sfreq
+#undef cfreq
+#undef spfmax
+#undef btime
+#undef bdate
+#undef nsamples
+#undef bcount
+#undef prolog_bytes
+#undef segments
+#undef in_msrec
+#undef msbtime
+#undef msbdate
+#undef msnsamples
+#undef segarray
+#undef segp
+#undef segend
+#undef segtext
+#undef nsegtext
+#undef segtextlen
+#undef segfetch
+#undef htext
+#undef hcap
+#undef hcaplen
+#undef hcapsize
+#undef segarray_L
+#undef maxisig
+#undef maxigroup
+#undef nisig
+#undef nigroup
+#undef ispfmax
+#undef isd
+#undef igd
+#undef tvector
+#undef uvector
+#undef vvector
+#undef tuvlen
+#undef blkbuf
+#undef blkbuflen
+#undef rngbuf
+#undef rngbuflen
+#undef pdbuf
+#undef pdbuflen
+#undef viewbuf
+#undef viewbuflen
+#undef vecbuf
+#undef vecbuflen
+#undef istime
+#undef skewmax
+#undef dsbuf
+#undef dsbi
+#undef dsblen
+#undef framelen
+#undef gvmode
+#undef gvc
+#undef rgvfstat
+#undef isedf
+#undef sbuf
+#undef nsblock
+#undef sbclock
+#undef sbtime
+#undef sbistime
+#undef sbhits
+#undef sbmisses
+#undef sample_vflag
+#undef mticks
+#undef nticks
+#undef mnticks
+#undef rgvstat
+#undef rgvtime
+#undef gvtime
+#undef gv0
+#undef gv1
+#undef rsmode
+#undef rstaps
+#undef rsnph
+#undef rstab
+#undef rshist
+#undef rshi
+#undef rsphase
+#undef rsbase
+#undef rsn
+#undef rslast
+#undef need_sigmap
+#undef maxvsig
+#undef nvsig
+#undef tspf
+#undef vspfmax
+#undef vsd
+#undef ovec
+#undef smi
+#undef smruns
+#undef nsmruns
+#undef smbuf
+#undef smbuflen
+#undef maxosig
+#undef maxogroup
+#undef nosig
+#undef nogroup
+#undef oheader
+#undef outinfo
+#undef osd
+#undef ogd
+#undef ostime
+#undef pvbuf
+#undef pvbuflen
+#undef owr
+#undef pinfo
+#undef nimax
+#undef ninfo
+#undef pinfoi
@@ -1,6 +1,8 @@
 #ifndef WFDB_LIB_SIGNAL_H_
 #define WFDB_LIB_SIGNAL_H_
 
+#include <stdint.h>
+
 #include "wfdb.hh"
 
 void wfdb_sampquit();
@@ -18,9 +20,18 @@ void setgvmode(int mode);
 int getgvmode();
 int setifreq(WFDB_Frequency freq);
 WFDB_Frequency getifreq();
+int setifreqmode(int mode);
 int getvec(WFDB_Sample *vector);
 int getframe(WFDB_Sample *vector);
+long getframes(WFDB_Sample *vector, long nframes);
+long getvecs(WFDB_Sample *vector, long nvecs);
+long getsignals(WFDB_Time t0, WFDB_Time t1, const WFDB_Signal *sig, int nsig,
+                WFDB_Sample **buf);
+long getsigview(WFDB_Group g, WFDB_Time t0, WFDB_Time t1, const int16_t **data,
+                unsigned char *valid);
+long getstreams(WFDB_Sample **buf, long nframes);
 int putvec(const WFDB_Sample *vector);
+long putvecs(const WFDB_Sample *vector, long nframes);
 int isigsettime(WFDB_Time t);
 int isgsettime(WFDB_Group g, WFDB_Time t);
 WFDB_Time tnextvec(WFDB_Signal s, WFDB_Time t);
@@ -33,8 +44,20 @@ int adumuv(WFDB_Signal s, WFDB_Sample a);
 WFDB_Sample muvadu(WFDB_Signal s, int microvolts);
 double aduphys(WFDB_Signal s, WFDB_Sample a);
 WFDB_Sample physadu(WFDB_Signal s, double v);
+void aduphysv(WFDB_Signal s, const WFDB_Sample *a, double *x, long n);
+void aduphysvf(WFDB_Signal s, const WFDB_Sample *a, float *x, long n);
+void physaduv(WFDB_Signal s, const double *x, WFDB_Sample *a, long n);
+void physaduvf(WFDB_Signal s, const float *x, WFDB_Sample *a, long n);
+long getphysframes(double *vector, long nframes);
+long getphysframesf(float *vector, long nframes);
+long getframes16(int16_t *vector, long nframes);
+long getframesf(float *vector, long nframes);
+long getvecs16(int16_t *vector, long nvecs);
+long getvecsf(float *vector, long nvecs);
 WFDB_Sample sample(WFDB_Signal s, WFDB_Time t);
 int sample_valid();
+int setsampcache(int nblocks);
+void getsampcache(long *hits, long *misses);
 char *getinfo(char *record);
 int putinfo(const char *info);
 int setinfo(char *record);
@@ -58,6 +81,35 @@ double getbasecount();
 void setbasecount(double count);
 int setbasetime(char *time_string);
 int setibsize(int input_buffer_size);
+int setimmap(int mode);
+int sethcache(const char *file);
+int setoasync(int nbuffers);
+int setiprefetch(int nbuffers);
+int setsegprefetch(int on);
+int setithreads(int nthreads);
 int setobsize(int output_buffer_size);
 
+// Record handles (see signal.c)
+struct WfdbRecord;
+WfdbRecord *wfdbnewrecord();
+void wfdbfreerecord(WfdbRecord *r);
+WfdbRecord *wfdbsetrecord(WfdbRecord *r);
+int isigopen_r(WfdbRecord *r, char *record, WFDB_Siginfo *siarray, int nsig);
+int getvec_r(WfdbRecord *r, WFDB_Sample *vector);
+int isigsettime_r(WfdbRecord *r, WFDB_Time t);
+WFDB_Sample sample_r(WfdbRecord *r, WFDB_Signal s, WFDB_Time t);
+
+// Selects a record handle for the calling thread until the end of the
+// enclosing scope, then restores the previous selection.
+class WfdbRecordScope {
+ public:
+  explicit WfdbRecordScope(WfdbRecord *r) : prev_(wfdbsetrecord(r)) {}
+  ~WfdbRecordScope() { wfdbsetrecord(prev_); }
+  WfdbRecordScope(const WfdbRecordScope &) = delete;
+  WfdbRecordScope &operator=(const WfdbRecordScope &) = delete;
+
+ private:
+  WfdbRecord *prev_;
+};
+
 #endif  // WFDB_LIB_SIGNAL_H_
@@ -2,14 +2,18 @@
 
 #include <iostream>
 #include <string>
+#include <vector>
 
 #include "absl/strings/str_format.h"
 
-// Error tracking state
-static std::string error_message =
+// Error tracking state (per thread, so that wfdberror reports the most recent
+// error in the calling thread)
+static thread_local std::string error_message =
     absl::StrFormat("WFDB library version %d.%d.%d (%s).\n", WFDB_MAJOR,
                     WFDB_MINOR, WFDB_RELEASE, WFDB_BUILD_DATE);
 static bool print_error = true;
+// Error messages to be collected rather than printed (see wfdb_errcollect)
+static thread_local std::vector<std::string> *error_collector = nullptr;
 
 /* Handles error messages, normally by printing them on the standard error
 output. It can be silenced by invoking wfdbquiet(), or re-enabled by invoking
@@ -18,7 +22,9 @@ wfdbverbose().
 void wfdb_error(std::string_view msg) {
   error_message = msg;
 
-  if (print_error) {
+  if (error_collector) {
+    error_collector->emplace_back(msg);
+  } else if (print_error) {
     std::cerr << error_message << std::flush;
   }
 }
@@ -37,6 +43,20 @@ std::string wfdberror() {
   return error_message;
 }
 
+/* wfdb_errcollect makes wfdb_error append the messages produced by the calling
+thread to *errors instead of printing them, until it is called with a null
+pointer. This permits a thread to hand the errors it encounters on behalf of
+another to that thread, which can then report them using wfdb_error itself, so
+that they are printed (or not) as it has requested and wfdberror finds them.
+The previous collector is returned, so that it can be restored.
+*/
+std::vector<std::string> *wfdb_errcollect(std::vector<std::string> *errors) {
+  std::vector<std::string> *prev = error_collector;
+
+  error_collector = errors;
+  return prev;
+}
+
 /* wfdbquiet can be used to suppress error messages from the WFDB library. */
 void wfdbquiet() { print_error = false; }
 
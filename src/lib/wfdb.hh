@@ -7,6 +7,7 @@ WFDB library type, constant, structure, and function interface definitions
 #define WFDB_LIB_WFDB_H_
 
 #include <string>
+#include <vector>
 
 #ifndef WFDB_BUILD_DATE
 #define WFDB_BUILD_DATE __DATE__
@@ -120,6 +121,13 @@ typedef long long WFDB_Time;
    can be redefined and the WFDB library can be recompiled. */
 #define WFDB_INVALID_SAMPLE (-32768)
 
+/* Resampling methods used by getvec after setifreq (see setifreqmode).
+   WFDB_RESAMPLE_LINEAR interpolates linearly between adjacent samples;
+   WFDB_RESAMPLE_SINC applies a windowed-sinc lowpass filter, which avoids
+   aliasing when the sampling frequency is reduced. */
+#define WFDB_RESAMPLE_LINEAR 0
+#define WFDB_RESAMPLE_SINC 1
+
 /* Array sizes
    Many older applications use the values of WFDB_MAXANN, WFDB_MAXSIG, and
    WFDB_MAXSPF to determine array sizes, but (since WFDB library version 10.2)
@@ -154,10 +162,11 @@ the legal values for the format field in a WFDB_siginfo structure.
  311    3 10-bit amplitudes bit-packed in 4 bytes
   24	24-bit 2's complement amplitudes, low byte first
   32	32-bit 2's complement amplitudes, low byte first
+1000	32-bit amplitudes, losslessly compressed in indexed blocks
 */
 #define WFDB_FMT_LIST \
-  { 0, 8, 16, 61, 80, 160, 212, 310, 311, 24, 32 }
-#define WFDB_NFMTS 11 /* number of items in WFDB_FMT_LIST */
+  { 0, 8, 16, 61, 80, 160, 212, 310, 311, 24, 32, 1000 }
+#define WFDB_NFMTS 12 /* number of items in WFDB_FMT_LIST */
 
 /* Default signal specifications */
 #define WFDB_DEFFREQ 250.0 /* default sampling frequency (Hz) */
@@ -281,6 +290,10 @@ std::string wfdberror();
 void wfdbquiet();
 // Enables WFDB library error messages
 void wfdbverbose();
+// Collects the error messages produced by the calling thread in *errors,
+// instead of printing them, until it is called with a null pointer; returns
+// the previous collector, if any
+std::vector<std::string> *wfdb_errcollect(std::vector<std::string> *errors);
 
 #endif  // WFDB_LIB_WFDB_H_
 
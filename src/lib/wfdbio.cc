@@ -6,12 +6,22 @@ Low-level I/O functions for the WFDB library
 
 #include "wfdbio.hh"
 
+#include <errno.h>
+#include <limits.h>
 #include <stdarg.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
 
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 #include <fstream>
+#include <mutex>
 #include <vector>
 
 #include "absl/status/statusor.h"
@@ -283,9 +293,14 @@ int wfdb_fprintf(WFDB_FILE *wp, const char *format, ...) {
                    : wfdb_asprintf(S, "%s.%.3s", RECORD, TYPE))
 #endif
 
-static char
+static thread_local char
     irec[WFDB_MAXRNL + 1]; /* current record name, set by wfdb_setirec */
 
+/* wfdb_open_mutex serializes calls to wfdb_open, which reads and may modify
+   the WFDB path and wfdb_filename, so that several threads can open files for
+   different records at once (see wfdbnewrecord in signal.c). */
+static std::mutex wfdb_open_mutex;
+
 /* wfdb_open is used by other WFDB library functions to open a database file
 for reading or writing.  wfdb_open accepts two string arguments and an integer
 argument.  The first string specifies the file type ("hea", "atr", etc.),
@@ -348,6 +363,7 @@ WFDB_FILE *wfdb_open(const char *s, const char *record, int mode) {
   WfdbPathComponent *c0;
   int bufsize, len, ireclen;
   WFDB_FILE *ifile;
+  std::lock_guard<std::mutex> lock(wfdb_open_mutex);
 
   /* If the type (s) is empty, replace it with an empty string so that
      strcmp(s, ...) will not segfault. */
@@ -609,6 +625,7 @@ to set the search order in any way you wish, as in this example.
 #define nf_fgets(s, size, nf) (NULL)
 #define nf_fread(ptr, size, nmemb, nf) (0)
 #define nf_fseek(nf, offset, whence) (-1)
+#define nf_pread(nf, startb, len, rbuf) (-1L)
 #define nf_ftell(nf) (-1)
 #define nf_ferror(nf) (0)
 #define nf_clearerr(nf) ((void)0)
@@ -624,17 +641,19 @@ to set the search order in any way you wish, as in this example.
 void wfdb_clearerr(WFDB_FILE *wp) {
   if (wp->type == FileType::kNet)
     nf_clearerr(wp->netfp);
-  else
+  else if (wp->type != FileType::kMapped)
     clearerr(wp->fp);
 }
 
 int wfdb_feof(WFDB_FILE *wp) {
   if (wp->type == FileType::kNet) return (nf_feof(wp->netfp));
+  if (wp->type == FileType::kMapped) return (wp->mappos >= wp->maplen);
   return (feof(wp->fp));
 }
 
 int wfdb_ferror(WFDB_FILE *wp) {
   if (wp->type == FileType::kNet) return (nf_ferror(wp->netfp));
+  if (wp->type == FileType::kMapped) return (0);
   return (ferror(wp->fp));
 }
 
@@ -644,56 +663,184 @@ int wfdb_fflush(WFDB_FILE *wp) {
     return (fflush(NULL));
   } else if (wp->type == FileType::kNet)
     return (nf_fflush(wp->netfp));
+  else if (wp->type == FileType::kMapped)
+    return (0);
   else
     return (fflush(wp->fp));
 }
 
 char *wfdb_fgets(char *s, int size, WFDB_FILE *wp) {
   if (wp->type == FileType::kNet) return (nf_fgets(s, size, wp->netfp));
+  if (wp->type == FileType::kMapped) {
+    int i = 0;
+
+    if (size < 1 || wp->mappos >= wp->maplen) return (NULL);
+    while (i < size - 1 && wp->mappos < wp->maplen)
+      if ((s[i++] = wp->map[wp->mappos++]) == '\n') break;
+    s[i] = '\0';
+    return (s);
+  }
   return (fgets(s, size, wp->fp));
 }
 
 size_t wfdb_fread(void *ptr, size_t size, size_t nmemb, WFDB_FILE *wp) {
   if (wp->type == FileType::kNet)
     return (nf_fread(ptr, size, nmemb, wp->netfp));
+  if (wp->type == FileType::kMapped) {
+    size_t n = 0;
+
+    if (size > 0 && wp->mappos < wp->maplen) {
+      if ((n = (wp->maplen - wp->mappos) / size) > nmemb) n = nmemb;
+      memcpy(ptr, wp->map + wp->mappos, n * size);
+      wp->mappos += n * size;
+    }
+    return (n);
+  }
   return (fread(ptr, size, nmemb, wp->fp));
 }
 
 int wfdb_fseek(WFDB_FILE *wp, long int offset, int whence) {
   if (wp->type == FileType::kNet) return (nf_fseek(wp->netfp, offset, whence));
+  if (wp->type == FileType::kMapped) {
+    if (whence == SEEK_CUR)
+      offset += wp->mappos;
+    else if (whence == SEEK_END)
+      offset += wp->maplen;
+    if (offset < 0) return (-1);
+    wp->mappos = offset;
+    return (0);
+  }
   return (fseek(wp->fp, offset, whence));
 }
 
 long wfdb_ftell(WFDB_FILE *wp) {
   if (wp->type == FileType::kNet) return (nf_ftell(wp->netfp));
+  if (wp->type == FileType::kMapped) return (wp->mappos);
   return (ftell(wp->fp));
 }
 
 size_t wfdb_fwrite(const void *ptr, size_t size, size_t nmemb, WFDB_FILE *wp) {
   if (wp->type == FileType::kNet)
     return (nf_fwrite(ptr, size, nmemb, wp->netfp));
+  if (wp->type == FileType::kMapped) return (0); /* mappings are read-only */
   return (fwrite(ptr, size, nmemb, wp->fp));
 }
 
 int wfdb_getc(WFDB_FILE *wp) {
   if (wp->type == FileType::kNet) return (nf_fgetc(wp->netfp));
+  if (wp->type == FileType::kMapped)
+    return (wp->mappos < wp->maplen ? (unsigned char)wp->map[wp->mappos++]
+                                    : EOF);
   return (getc(wp->fp));
 }
 
 int wfdb_putc(int c, WFDB_FILE *wp) {
   if (wp->type == FileType::kNet) return (nf_putc(c, wp->netfp));
+  if (wp->type == FileType::kMapped) return (EOF); /* mappings are read-only */
   return (putc(c, wp->fp));
 }
 
 int wfdb_fclose(WFDB_FILE *wp) {
   int status;
 
+#if defined(_POSIX_MAPPED_FILES) && _POSIX_MAPPED_FILES > 0
+  if (wp->type == FileType::kMapped) munmap((void *)wp->map, wp->maplen);
+#endif
   status = (wp->type == FileType::kNet) ? nf_fclose(wp->netfp) : fclose(wp->fp);
 
   if (wp->fp != stdin) SFREE(wp);
   return (status);
 }
 
+/* wfdb_fmap maps a local file, opened for reading, into memory.  Once this
+   has been done, the wfdb_f* functions above read from the mapping rather than
+   through the C standard I/O library, and callers may also read the mapped
+   data directly via wp->map (as getvec does).  Only regular files are
+   mapped. */
+int wfdb_fmap(WFDB_FILE *wp) {
+#if defined(_POSIX_MAPPED_FILES) && _POSIX_MAPPED_FILES > 0
+  struct stat st;
+  void *map;
+  long pos;
+  int fd;
+
+  if (wp == NULL || wp->type != FileType::kLocal || (fd = fileno(wp->fp)) < 0 ||
+      fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size <= 0 ||
+      st.st_size > LONG_MAX || (pos = ftell(wp->fp)) < 0)
+    return (-1);
+  map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  if (map == MAP_FAILED) return (-1);
+  wp->map = (const char *)map;
+  wp->maplen = (long)st.st_size;
+  wp->mappos = pos;
+  wp->type = FileType::kMapped;
+  return (0);
+#else
+  return (-1);
+#endif
+}
+
+/* wfdb_fadvise advises the system that a local file, opened for reading, will
+   be read sequentially beginning at the given offset, and (if len > 0) that
+   the len bytes that follow will be needed soon.  This is only a hint;  the
+   function returns 0 if it was given, or -1 otherwise. */
+int wfdb_fadvise(WFDB_FILE *wp, long offset, long len) {
+#if defined(POSIX_FADV_SEQUENTIAL)
+  int fd;
+
+  if (wp == NULL || wp->type != FileType::kLocal || (fd = fileno(wp->fp)) < 0 ||
+      posix_fadvise(fd, offset, 0, POSIX_FADV_SEQUENTIAL) != 0)
+    return (-1);
+  if (len > 0) (void)posix_fadvise(fd, offset, len, POSIX_FADV_WILLNEED);
+  return (0);
+#else
+  return (-1);
+#endif
+}
+
+/* wfdb_pread reads up to n bytes from wp, beginning at the given offset,
+   without using or changing the file position used by wfdb_fread, etc., so
+   that several threads may read from the same file at once.  Local files are
+   read using pread, mapped files are read from memory, and remote files are
+   read using range requests (see nf_pread).  The result is the number of bytes
+   read, which is less than n only at the end of the file or in case of an
+   error, or -1 if nothing could be read. */
+long wfdb_pread(WFDB_FILE *wp, void *ptr, size_t n, int64_t offset) {
+  long nr = 0;
+
+  if (offset < 0) return (-1);
+  if (wp->type == FileType::kNet) {
+    if (offset > LONG_MAX) return (-1);
+    if (n > LONG_MAX) n = LONG_MAX;
+    return (nf_pread(wp->netfp, (long)offset, (long)n, (char *)ptr));
+  }
+  if (wp->type == FileType::kMapped) {
+    if (offset < wp->maplen) {
+      if (n > (size_t)(wp->maplen - offset)) n = wp->maplen - offset;
+      memcpy(ptr, wp->map + offset, n);
+      nr = n;
+    }
+    return (nr);
+  }
+  if (wp->type == FileType::kLocal) {
+    int fd = fileno(wp->fp);
+    ssize_t k;
+
+    if (fd < 0) return (-1);
+    while (n > 0) {
+      if ((k = pread(fd, (char *)ptr + nr, n, (off_t)(offset + nr))) < 0) {
+        if (errno == EINTR) continue;
+        return (nr > 0 ? nr : -1);
+      }
+      if (k == 0) break;
+      nr += k;
+      n -= k;
+    }
+    return (nr);
+  }
+  return (-1);
+}
+
 absl::StatusOr<WFDB_FILE> wfdb_fopen(const std::string &fname,
                                      std::ios::openmode mode) {
   // char *p = fname;
@@ -10,6 +10,7 @@ symbols reserved to the library begin with the characters "wfdb_".
 #ifndef WFDB_LIB_IO_H_
 #define WFDB_LIB_IO_H_
 
+#include <stdint.h>
 #include <sys/stat.h>
 
 #include <fstream>
@@ -54,14 +55,18 @@ struct WfdbConfig {
 };
 
 enum class FileType {
-  kLocal, /* a local file, read via C standard I/O */
-  kNet    /* a remote file, read via libwww */
+  kLocal,  /* a local file, read via C standard I/O */
+  kNet,    /* a remote file, read via libwww */
+  kMapped  /* a local file, read from memory via mmap (see wfdb_fmap) */
 };
 
 struct WFDB_FILE {
   std::fstream fp;
   struct Netfile *netfp;
   FileType type;
+  const char *map; /* contents of the file, if type is kMapped */
+  long maplen;     /* length of map, in bytes */
+  long mappos;     /* offset in map of the next byte to be read */
 };
 
 // An element of the WFDB Path, specifying where to search for database files
@@ -161,5 +166,18 @@ int wfdb_putc(int c, WFDB_FILE *fp);
 int wfdb_fclose(WFDB_FILE *fp);
 // Emulates fopen, but returns a WFDB_FILE pointer
 WFDB_FILE *wfdb_fopen(char *fname, const char *mode);
+// Maps a local file opened for reading into memory, so that subsequent reads
+// are served from the mapping.  Returns 0 on success, or -1 if the file
+// cannot be mapped (in which case it remains usable as before).
+int wfdb_fmap(WFDB_FILE *fp);
+// Advises the system that a local file opened for reading will be read
+// sequentially from offset, and that the next len bytes (if len > 0) will be
+// needed soon.  Returns 0 if the advice was given, or -1 otherwise.
+int wfdb_fadvise(WFDB_FILE *fp, long offset, long len);
+// Reads up to n bytes, beginning at the given offset, from a file opened for
+// reading, without using or changing its current position, so that several
+// threads may read from one file at once.  Returns the number of bytes read
+// (less than n only at the end of the file), or -1 in case of error.
+long wfdb_pread(WFDB_FILE *fp, void *ptr, size_t n, int64_t offset);
 
 #endif  // WFDB_LIB_IO_H_